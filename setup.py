@@ -5,7 +5,8 @@ import sys
 ext_modules = [
     Pybind11Extension(
         "crucible_engine",
-        ["src/bindings.cpp", "src/matching_engine.cpp"],
+        ["src/bindings.cpp", "src/matching_engine.cpp", "src/journal.cpp", "src/snapshot.cpp",
+         "src/fix_parser.cpp", "src/fix_encoder.cpp", "src/fix_gateway.cpp", "src/io_uring.cpp"],
         include_dirs=["src"],
         cxx_std=17,
         extra_compile_args=[
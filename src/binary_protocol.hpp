@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-layout binary order entry. Every message is one of the packed structs
+// below, little-endian on the wire, starting with a BinaryHeader whose length
+// is the size of the whole struct. A receiver checks the length against the
+// type and then reads the struct in place; there is nothing to parse.
+//
+// Prices are fixed point with kBinaryPriceScale units per currency unit.
+// Symbols are ASCII, padded with spaces or NULs to eight bytes. Orders are
+// named by the client's 64-bit client_order_id, unique within its session.
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "the binary order entry structs are laid out for little-endian hosts"
+#endif
+
+namespace crucible
+{
+
+    constexpr std::uint8_t kBinaryVersion = 1;
+    constexpr std::int64_t kBinaryPriceScale = 10000;
+
+    enum class BinaryType : char
+    {
+        // Client to exchange
+        Logon = 'L',
+        Logout = 'O',
+        NewOrder = 'N',
+        Cancel = 'C',
+        Replace = 'R',
+        // Exchange to client
+        LogonReply = 'l',
+        Ack = 'A',
+        Fill = 'F',
+        Reject = 'J',
+    };
+
+    enum class BinaryAckState : char
+    {
+        New = 'N',
+        Replaced = 'R',
+        Canceled = 'C',
+    };
+
+    enum class BinaryRejectReason : std::uint8_t
+    {
+        UnknownSymbol = 1,
+        BadValue = 2,       // Side, type, quantity or price out of range
+        DuplicateOrder = 3,
+        NotFound = 4,       // Cancel or replace of an order the session does not have resting
+    };
+
+#pragma pack(push, 1)
+
+    struct BinaryHeader
+    {
+        std::uint16_t length; // Bytes in the whole message, this header included
+        BinaryType type;
+        std::uint8_t version;
+    };
+
+    struct BinaryLogon
+    {
+        BinaryHeader header;
+        char comp_id[16]; // Padded like symbols
+    };
+
+    struct BinaryLogonReply
+    {
+        BinaryHeader header;
+        std::uint8_t accepted; // 0 = refused, the session is then closed
+        std::uint8_t reserved[3];
+    };
+
+    struct BinaryLogout
+    {
+        BinaryHeader header;
+    };
+
+    struct BinaryNewOrder
+    {
+        BinaryHeader header;
+        std::uint64_t client_order_id;
+        char symbol[8];
+        std::int64_t price; // Ignored for market orders
+        std::uint32_t qty;
+        char side;       // '1' = buy, '2' = sell
+        char order_type; // '1' = market, '2' = limit
+        std::uint8_t reserved[2];
+    };
+
+    struct BinaryCancel
+    {
+        BinaryHeader header;
+        std::uint64_t client_order_id;
+        char symbol[8];
+    };
+
+    // The order keeps its client_order_id. A price of 0 keeps the current price.
+    struct BinaryReplace
+    {
+        BinaryHeader header;
+        std::uint64_t client_order_id;
+        char symbol[8];
+        std::int64_t price;
+        std::uint32_t qty; // New total quantity, fills included
+        std::uint8_t reserved[4];
+    };
+
+    struct BinaryAck
+    {
+        BinaryHeader header;
+        BinaryAckState state;
+        char side;
+        std::uint8_t reserved[2];
+        std::uint64_t client_order_id;
+        std::uint64_t order_id; // Assigned by the exchange
+        std::int64_t price;
+        std::uint32_t qty;        // Total quantity
+        std::uint32_t filled_qty; // Cumulative
+    };
+
+    struct BinaryFill
+    {
+        BinaryHeader header;
+        char side;
+        std::uint8_t reserved[3];
+        std::uint32_t leaves_qty; // Still open after this fill
+        std::uint64_t client_order_id;
+        std::uint64_t order_id;
+        std::uint64_t exec_id;
+        std::int64_t price;
+        std::uint32_t qty;
+        std::uint32_t filled_qty; // Cumulative
+    };
+
+    struct BinaryReject
+    {
+        BinaryHeader header;
+        BinaryType ref_type; // The rejected message's type
+        BinaryRejectReason reason;
+        std::uint8_t reserved[2];
+        std::uint64_t client_order_id;
+    };
+
+#pragma pack(pop)
+
+    static_assert(sizeof(BinaryHeader) == 4, "binary layout");
+    static_assert(sizeof(BinaryLogon) == 20, "binary layout");
+    static_assert(sizeof(BinaryLogonReply) == 8, "binary layout");
+    static_assert(sizeof(BinaryNewOrder) == 36, "binary layout");
+    static_assert(sizeof(BinaryCancel) == 20, "binary layout");
+    static_assert(sizeof(BinaryReplace) == 36, "binary layout");
+    static_assert(sizeof(BinaryAck) == 40, "binary layout");
+    static_assert(sizeof(BinaryFill) == 52, "binary layout");
+    static_assert(sizeof(BinaryReject) == 16, "binary layout");
+
+    // Size of an inbound message of the given type, 0 if it is not one
+    constexpr std::size_t binary_inbound_size(BinaryType type)
+    {
+        switch (type)
+        {
+        case BinaryType::Logon:
+            return sizeof(BinaryLogon);
+        case BinaryType::Logout:
+            return sizeof(BinaryLogout);
+        case BinaryType::NewOrder:
+            return sizeof(BinaryNewOrder);
+        case BinaryType::Cancel:
+            return sizeof(BinaryCancel);
+        case BinaryType::Replace:
+            return sizeof(BinaryReplace);
+        default:
+            return 0;
+        }
+    }
+
+} // namespace crucible
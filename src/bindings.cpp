@@ -1,29 +1,117 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <pybind11/functional.h>
+#include <pybind11/numpy.h>
+#include "fix_encoder.hpp"
+#include "fix_gateway.hpp"
+#include "fix_parser.hpp"
 #include "matching_engine.hpp"
 
 namespace py = pybind11;
 using namespace crucible;
 
+// Engine calls only touch C++ state, so Python session threads may run them in parallel
+using release_gil = py::call_guard<py::gil_scoped_release>;
+
+namespace pybind11
+{
+    namespace detail
+    {
+        // Client order ids cross the boundary as plain Python strings
+        template <>
+        struct type_caster<ClOrdId>
+        {
+            PYBIND11_TYPE_CASTER(ClOrdId, const_name("str"));
+
+            bool load(handle src, bool)
+            {
+                if (!PyUnicode_Check(src.ptr()))
+                    return false;
+                Py_ssize_t size = 0;
+                const char *data = PyUnicode_AsUTF8AndSize(src.ptr(), &size);
+                if (!data)
+                {
+                    PyErr_Clear();
+                    return false;
+                }
+                if (!value.assign(std::string_view(data, static_cast<std::size_t>(size))))
+                    throw value_error("cl_ord_id longer than " + std::to_string(ClOrdId::capacity) + " chars");
+                return true;
+            }
+
+            static handle cast(const ClOrdId &src, return_value_policy, handle)
+            {
+                auto view = src.view();
+                return PyUnicode_DecodeUTF8(view.data(), static_cast<Py_ssize_t>(view.size()), nullptr);
+            }
+        };
+    }
+}
+
+// FIX tags may be given as ints or as the strings a parsed tag dict would use
+static int fix_tag(const py::handle &key)
+{
+    if (py::isinstance<py::int_>(key))
+        return key.cast<int>();
+    int tag = -1;
+    if (py::isinstance<py::str>(key) && !parse_fix_int(key.cast<std::string>(), tag))
+        tag = -1;
+    return tag;
+}
+
+static py::str fix_value(std::string_view value)
+{
+    return py::str(value.data(), value.size());
+}
+
+// Send buffer the encoder appends into; Python gets one str copy of the result
+static std::string &fix_send_buffer()
+{
+    thread_local std::string buffer;
+    buffer.clear();
+    return buffer;
+}
+
+PYBIND11_NUMPY_DTYPE(BatchOrder, order_id, price, timestamp, symbol_id, qty, side, order_type, cl_ord_id);
+PYBIND11_NUMPY_DTYPE(BatchCancel, order_id, symbol_id);
+PYBIND11_NUMPY_DTYPE(Match, buy_order_id, sell_order_id, qty, price_ticks, price, timestamp);
+PYBIND11_NUMPY_DTYPE(DepthLevel, price_ticks, price, qty, order_count);
+PYBIND11_NUMPY_DTYPE(L3Event, sequence, order_id, price_ticks, timestamp, symbol_id, qty, type, side);
+
 PYBIND11_MODULE(crucible_engine, m)
 {
     m.doc() = "High-performance C++ matching engine for Crucible FIX Exchange";
 
+    py::enum_<BookType>(m, "BookType")
+        .value("Map", BookType::Map)
+        .value("Ladder", BookType::Ladder);
+
+    // Per-symbol book configuration
+    py::class_<BookConfig>(m, "BookConfig")
+        .def(py::init<>())
+        .def_readwrite("tick_size", &BookConfig::tick_size)
+        .def_readwrite("book_type", &BookConfig::book_type)
+        .def_readwrite("ladder_levels", &BookConfig::ladder_levels)
+        .def_readwrite("order_capacity", &BookConfig::order_capacity)
+        .def_readwrite("level_capacity", &BookConfig::level_capacity)
+        .def_readwrite("event_capacity", &BookConfig::event_capacity)
+        .def_readwrite("l3_capacity", &BookConfig::l3_capacity);
+
     // Order struct
     py::class_<Order, std::shared_ptr<Order>>(m, "Order")
-        .def(py::init<const std::string &, const std::string &, const std::string &,
-                      char, int, char, double, double>(),
-             py::arg("order_id"), py::arg("cl_ord_id"), py::arg("symbol"),
-             py::arg("side"), py::arg("order_qty"), py::arg("order_type"),
-             py::arg("price"), py::arg("timestamp"))
+        .def(py::init([](const ClOrdId &cl_ord_id, char side, int qty, char order_type, double price,
+                         double timestamp, OrderId order_id)
+                      { return std::make_shared<Order>(order_id, cl_ord_id, side, qty, order_type, price, timestamp); }),
+             py::arg("cl_ord_id"), py::arg("side"), py::arg("order_qty"), py::arg("order_type"),
+             py::arg("price"), py::arg("timestamp") = 0.0, py::arg("order_id") = 0)
         .def_readwrite("order_id", &Order::order_id)
         .def_readwrite("cl_ord_id", &Order::cl_ord_id)
-        .def_readwrite("symbol", &Order::symbol)
+        .def_readonly("symbol_id", &Order::symbol_id)
         .def_readwrite("side", &Order::side)
         .def_readwrite("order_qty", &Order::order_qty)
         .def_readwrite("order_type", &Order::order_type)
         .def_readwrite("price", &Order::price)
+        .def_readwrite("price_ticks", &Order::price_ticks)
         .def_readwrite("filled_qty", &Order::filled_qty)
         .def_readwrite("status", &Order::status)
         .def_readwrite("timestamp", &Order::timestamp)
@@ -35,25 +123,428 @@ PYBIND11_MODULE(crucible_engine, m)
         .def_readonly("buy_order_id", &Match::buy_order_id)
         .def_readonly("sell_order_id", &Match::sell_order_id)
         .def_readonly("qty", &Match::qty)
+        .def_readonly("price_ticks", &Match::price_ticks)
         .def_readonly("price", &Match::price)
         .def_readonly("timestamp", &Match::timestamp);
 
+    // SubmitResult struct
+    py::class_<SubmitResult>(m, "SubmitResult")
+        .def_readonly("accepted", &SubmitResult::accepted)
+        .def_readonly("resting", &SubmitResult::resting)
+        .def_readonly("filled_qty", &SubmitResult::filled_qty)
+        .def_readonly("match_count", &SubmitResult::match_count);
+
+    py::enum_<EventType>(m, "EventType")
+        .value("Ack", EventType::Ack)
+        .value("Fill", EventType::Fill)
+        .value("Cancel", EventType::Cancel)
+        .value("Replace", EventType::Replace)
+        .value("BookUpdate", EventType::BookUpdate);
+
+    // EngineEvent struct
+    py::class_<EngineEvent>(m, "EngineEvent")
+        .def_readonly("type", &EngineEvent::type)
+        .def_readonly("side", &EngineEvent::side)
+        .def_readonly("status", &EngineEvent::status)
+        .def_readonly("symbol_id", &EngineEvent::symbol_id)
+        .def_readonly("order_id", &EngineEvent::order_id)
+        .def_readonly("contra_order_id", &EngineEvent::contra_order_id)
+        .def_readonly("qty", &EngineEvent::qty)
+        .def_readonly("leaves_qty", &EngineEvent::leaves_qty)
+        .def_readonly("price_ticks", &EngineEvent::price_ticks)
+        .def_readonly("timestamp", &EngineEvent::timestamp)
+        .def_readonly("sequence", &EngineEvent::sequence);
+
+    py::enum_<L3Type>(m, "L3Type")
+        .value("Add", L3Type::Add)
+        .value("Modify", L3Type::Modify)
+        .value("Execute", L3Type::Execute)
+        .value("Delete", L3Type::Delete);
+
+    // DepthLevel struct
+    py::class_<DepthLevel>(m, "DepthLevel")
+        .def_readonly("price_ticks", &DepthLevel::price_ticks)
+        .def_readonly("price", &DepthLevel::price)
+        .def_readonly("qty", &DepthLevel::qty)
+        .def_readonly("order_count", &DepthLevel::order_count);
+
+    // BookSnapshot struct
+    py::class_<BookSnapshot>(m, "BookSnapshot")
+        .def_readonly("sequence", &BookSnapshot::sequence)
+        .def_readonly("bids", &BookSnapshot::bids)
+        .def_readonly("asks", &BookSnapshot::asks);
+
+    // TopOfBook struct
+    py::class_<TopOfBook>(m, "TopOfBook")
+        .def_readonly("bid_ticks", &TopOfBook::bid_ticks)
+        .def_readonly("ask_ticks", &TopOfBook::ask_ticks)
+        .def_readonly("last_ticks", &TopOfBook::last_ticks)
+        .def_readonly("bid_qty", &TopOfBook::bid_qty)
+        .def_readonly("ask_qty", &TopOfBook::ask_qty)
+        .def_readonly("last_qty", &TopOfBook::last_qty)
+        .def_readonly("sequence", &TopOfBook::sequence);
+
     // OrderBook class
     py::class_<OrderBook, std::shared_ptr<OrderBook>>(m, "OrderBook")
-        .def(py::init<const std::string &>(), py::arg("symbol"))
-        .def("add_order", &OrderBook::add_order)
-        .def("match_orders", &OrderBook::match_orders)
-        .def("get_buy_depth", &OrderBook::get_buy_depth)
-        .def("get_sell_depth", &OrderBook::get_sell_depth)
-        .def("get_best_bid", &OrderBook::get_best_bid)
-        .def("get_best_ask", &OrderBook::get_best_ask)
-        .def("get_spread", &OrderBook::get_spread);
+        .def(py::init([](const std::string &symbol, const BookConfig &config)
+                      { return make_order_book(symbol, config); }),
+             py::arg("symbol"), py::arg("config") = BookConfig())
+        .def("create_order", &OrderBook::create_order,
+             py::arg("cl_ord_id"), py::arg("side"), py::arg("order_qty"),
+             py::arg("order_type"), py::arg("price"), py::arg("timestamp") = 0.0, release_gil())
+        .def("add_order", &OrderBook::add_order, release_gil())
+        .def("match_orders", py::overload_cast<>(&OrderBook::match_orders), release_gil())
+        .def("match", &OrderBook::match, release_gil())
+        .def("submit_order", [](OrderBook &book, std::shared_ptr<Order> order)
+             {
+                 std::vector<Match> matches;
+                 SubmitResult result = book.submit_order(std::move(order), matches);
+                 return std::make_pair(result, matches); },
+             py::arg("order"), release_gil(), "Match on entry; returns (SubmitResult, matches)")
+        .def("cancel_order", &OrderBook::cancel_order, py::arg("order_id"), release_gil())
+        .def("cancel_by_cl_ord_id", &OrderBook::cancel_by_cl_ord_id, py::arg("cl_ord_id"), release_gil())
+        .def("replace_order", py::overload_cast<OrderId, int, double>(&OrderBook::replace_order),
+             py::arg("order_id"), py::arg("new_qty"), py::arg("new_price") = 0.0, release_gil())
+        .def("find_order", &OrderBook::find_order, py::arg("order_id"), release_gil())
+        .def("find_by_cl_ord_id", &OrderBook::find_by_cl_ord_id, py::arg("cl_ord_id"), release_gil())
+        .def("to_ticks", &OrderBook::to_ticks)
+        .def("to_price", &OrderBook::to_price)
+        .def("tick_size", &OrderBook::tick_size)
+        .def("symbol", &OrderBook::symbol)
+        .def("symbol_id", &OrderBook::symbol_id)
+        .def("get_buy_depth", &OrderBook::get_buy_depth, release_gil())
+        .def("get_sell_depth", &OrderBook::get_sell_depth, release_gil())
+        .def("get_depth", [](const OrderBook &book, char side, std::size_t levels)
+             {
+                 py::array_t<DepthLevel> depth(static_cast<py::ssize_t>(levels));
+                 DepthLevel *data = depth.mutable_data();
+                 std::size_t count;
+                 {
+                     py::gil_scoped_release release;
+                     count = book.get_depth(side, data, levels);
+                 }
+                 depth.resize({static_cast<py::ssize_t>(count)});
+                 return depth; },
+             py::arg("side"), py::arg("levels") = 10,
+             "Top levels of one side, best first, as a depth_level_dtype array")
+        .def("snapshot", &OrderBook::snapshot, py::arg("max_levels") = SIZE_MAX, release_gil())
+        .def("get_best_bid", &OrderBook::get_best_bid, release_gil())
+        .def("get_best_ask", &OrderBook::get_best_ask, release_gil())
+        .def("get_spread", &OrderBook::get_spread, release_gil())
+        .def("get_best_bid_ticks", &OrderBook::get_best_bid_ticks, release_gil())
+        .def("get_best_ask_ticks", &OrderBook::get_best_ask_ticks, release_gil())
+        .def("top_of_book", &OrderBook::top_of_book, release_gil());
 
     // MatchingEngine class
     py::class_<MatchingEngine>(m, "MatchingEngine")
-        .def(py::init<>())
-        .def("add_order", &MatchingEngine::add_order)
-        .def("match_orders", &MatchingEngine::match_orders)
-        .def("get_or_create_book", &MatchingEngine::get_or_create_book)
-        .def("get_book", &MatchingEngine::get_book);
+        .def(py::init<std::size_t>(), py::arg("max_symbols") = 4096)
+        .def("configure_symbol", &MatchingEngine::configure_symbol,
+             py::arg("symbol"), py::arg("config"))
+        .def("set_default_config", &MatchingEngine::set_default_config, py::arg("config"))
+        .def("symbol_id", &MatchingEngine::symbol_id, py::arg("symbol"))
+        .def("symbol_name", &MatchingEngine::symbol_name, py::arg("symbol_id"))
+        .def("next_order_id", &MatchingEngine::next_order_id)
+        .def("create_order", &MatchingEngine::create_order,
+             py::arg("symbol"), py::arg("cl_ord_id"), py::arg("side"),
+             py::arg("order_qty"), py::arg("order_type"), py::arg("price"), py::arg("timestamp") = 0.0,
+             release_gil())
+        .def("add_order", py::overload_cast<const std::string &, std::shared_ptr<Order>>(&MatchingEngine::add_order),
+             py::arg("symbol"), py::arg("order"), release_gil())
+        .def("match_orders", py::overload_cast<const std::string &>(&MatchingEngine::match_orders), release_gil())
+        .def("match", py::overload_cast<const std::string &>(&MatchingEngine::match), py::arg("symbol"),
+             release_gil())
+        .def("submit_order", [](MatchingEngine &engine, const std::string &symbol, std::shared_ptr<Order> order)
+             {
+                 std::vector<Match> matches;
+                 SubmitResult result = engine.submit_order(symbol, std::move(order), matches);
+                 return std::make_pair(result, matches); },
+             py::arg("symbol"), py::arg("order"), release_gil(), "Match on entry; returns (SubmitResult, matches)")
+        .def("submit_batch", [](MatchingEngine &engine, const std::string &symbol,
+                                const std::vector<std::shared_ptr<Order>> &orders)
+             {
+                 std::vector<Match> matches;
+                 auto book = engine.get_or_create_book(symbol);
+                 for (const auto &order : orders)
+                     book->submit_order(order, matches);
+                 return matches; },
+             py::arg("symbol"), py::arg("orders"), release_gil(), "Submit a list of orders; returns all fills")
+        .def("submit_batch", [](MatchingEngine &engine, py::array_t<BatchOrder, py::array::c_style | py::array::forcecast> orders)
+             {
+                 std::vector<Match> matches;
+                 const BatchOrder *data = orders.data();
+                 std::size_t count = static_cast<std::size_t>(orders.size());
+                 {
+                     py::gil_scoped_release release;
+                     engine.submit_batch(data, count, matches);
+                 }
+                 return py::array_t<Match>(static_cast<py::ssize_t>(matches.size()), matches.data()); },
+             py::arg("orders"), "Submit a batch_order_dtype array; returns fills as a match_dtype array")
+        .def("cancel_batch", [](MatchingEngine &engine, const std::string &symbol, const std::vector<OrderId> &order_ids)
+             {
+                 auto book = engine.get_book(symbol);
+                 std::size_t canceled = 0;
+                 for (OrderId order_id : order_ids)
+                     canceled += book && book->cancel_order(order_id) ? 1 : 0;
+                 return canceled; },
+             py::arg("symbol"), py::arg("order_ids"), release_gil())
+        .def("cancel_batch", [](MatchingEngine &engine, py::array_t<BatchCancel, py::array::c_style | py::array::forcecast> cancels)
+             {
+                 const BatchCancel *data = cancels.data();
+                 std::size_t count = static_cast<std::size_t>(cancels.size());
+                 py::gil_scoped_release release;
+                 return engine.cancel_batch(data, count); },
+             py::arg("cancels"))
+        .def("drain_events", [](MatchingEngine &engine, std::size_t max_events)
+             {
+                 std::vector<EngineEvent> events;
+                 engine.drain_events(events, max_events);
+                 return events; },
+             py::arg("max_events") = 4096, release_gil())
+        .def("events_dropped", &MatchingEngine::events_dropped)
+        .def("drain_l3", [](MatchingEngine &engine, std::size_t max_records)
+             {
+                 std::vector<L3Event> records;
+                 {
+                     py::gil_scoped_release release;
+                     engine.drain_l3(records, max_records);
+                 }
+                 return py::array_t<L3Event>(static_cast<py::ssize_t>(records.size()), records.data()); },
+             py::arg("max_records") = 65536, "Drain L3 records as an l3_event_dtype array")
+        .def("export_l3", &MatchingEngine::export_l3, py::arg("path"), release_gil(),
+             "Append every buffered L3 record to a raw l3_event_dtype file; returns the count")
+        .def("l3_dropped", &MatchingEngine::l3_dropped)
+        .def("open_journal", &MatchingEngine::open_journal, py::arg("path"), py::arg("commit_interval_us") = 1000,
+             release_gil(), "Journal every accepted input to path, appending after an existing journal's records")
+        .def("close_journal", &MatchingEngine::close_journal, release_gil())
+        .def("sync_journal", &MatchingEngine::sync_journal, release_gil(),
+             "Wait until every accepted input is on disk; returns the last durable sequence")
+        .def("replay", &MatchingEngine::replay, py::arg("journal_path"), py::arg("after_sequence") = 0,
+             release_gil(), "Apply a journal's inputs after after_sequence; returns how many were applied")
+        .def("snapshot", &MatchingEngine::snapshot, py::arg("path"), release_gil(),
+             "Copy every book and write it to path from a background thread; False while one is being written")
+        .def("wait_snapshot", &MatchingEngine::wait_snapshot, release_gil(),
+             "Wait for the last snapshot to reach disk; returns its order count")
+        .def("restore", &MatchingEngine::restore, py::arg("path"), release_gil(),
+             "Rebuild the books a snapshot holds; returns the number of orders restored")
+        .def("start_shards", &MatchingEngine::start_shards,
+             py::arg("shard_count"), py::arg("pin_threads") = false, py::arg("queue_capacity") = 65536,
+             release_gil())
+        .def("stop_shards", &MatchingEngine::stop_shards, release_gil())
+        .def("sharded", &MatchingEngine::sharded)
+        .def("post_order", [](MatchingEngine &engine, const std::string &symbol, std::shared_ptr<Order> order)
+             { return engine.post_order(engine.get_or_create_book(symbol)->symbol_id(), std::move(order)); },
+             py::arg("symbol"), py::arg("order"), release_gil())
+        .def("post_cancel", [](MatchingEngine &engine, const std::string &symbol, OrderId order_id)
+             { return engine.post_cancel(engine.symbol_id(symbol), order_id); },
+             py::arg("symbol"), py::arg("order_id"), release_gil())
+        .def("cancel_order", &MatchingEngine::cancel_order, py::arg("symbol"), py::arg("order_id"), release_gil())
+        .def("cancel_by_cl_ord_id", &MatchingEngine::cancel_by_cl_ord_id,
+             py::arg("symbol"), py::arg("cl_ord_id"), release_gil())
+        .def("replace_order", &MatchingEngine::replace_order,
+             py::arg("symbol"), py::arg("order_id"), py::arg("new_qty"), py::arg("new_price") = 0.0, release_gil())
+        .def("find_by_cl_ord_id", &MatchingEngine::find_by_cl_ord_id,
+             py::arg("symbol"), py::arg("cl_ord_id"), release_gil())
+        .def("get_or_create_book", &MatchingEngine::get_or_create_book, py::arg("symbol"), release_gil())
+        .def("get_book", py::overload_cast<const std::string &>(&MatchingEngine::get_book, py::const_), release_gil());
+
+    // FixMessage views the buffer it was parsed from, which parse_fix keeps alive
+    py::class_<FixMessage>(m, "FixMessage")
+        .def("get", [](const FixMessage &message, py::handle key, py::object fallback) -> py::object
+             {
+                 const FixField *field = message.find(fix_tag(key));
+                 return field ? fix_value(field->value) : fallback; },
+             py::arg("tag"), py::arg("default") = py::none())
+        .def("get_int", [](const FixMessage &message, py::handle key) -> py::object
+             {
+                 int value;
+                 const FixField *field = message.find(fix_tag(key));
+                 if (!field)
+                     return py::none();
+                 if (!parse_fix_int(field->value, value))
+                     throw py::value_error("tag " + std::to_string(field->tag) + " is not an integer");
+                 return py::int_(value); },
+             py::arg("tag"))
+        .def("__getitem__", [](const FixMessage &message, py::handle key)
+             {
+                 const FixField *field = message.find(fix_tag(key));
+                 if (!field)
+                     throw py::key_error(std::string(py::str(key)));
+                 return fix_value(field->value); })
+        .def("__contains__", [](const FixMessage &message, py::handle key)
+             { return message.has(fix_tag(key)); })
+        .def("__len__", &FixMessage::size)
+        .def("fields", [](const FixMessage &message)
+             {
+                 py::list fields;
+                 for (const FixField &field : message)
+                     fields.append(py::make_tuple(field.tag, fix_value(field.value)));
+                 return fields; },
+             "All (tag, value) pairs in wire order")
+        .def("new_order", [](const FixMessage &message)
+             {
+                 auto order = std::make_shared<Order>(0, ClOrdId(), '1', 0, '2', 0.0, 0.0);
+                 std::string_view symbol;
+                 int tag;
+                 FixError error = decode_new_order(message, *order, symbol, tag);
+                 if (error != FixError::None)
+                     throw py::value_error(std::string(fix_error_text(error)) + " in tag " + std::to_string(tag));
+                 return std::make_pair(std::string(symbol), order); },
+             "Decode a New Order Single; returns (symbol, Order), raises ValueError naming the bad tag");
+
+    m.def("parse_fix", [](py::bytes data) -> std::optional<FixMessage>
+          {
+              char *buffer;
+              py::ssize_t size;
+              if (PyBytes_AsStringAndSize(data.ptr(), &buffer, &size) != 0)
+                  throw py::error_already_set();
+              FixMessage message;
+              if (!message.parse(std::string_view(buffer, static_cast<std::size_t>(size))))
+                  return std::nullopt;
+              return message; },
+          py::arg("data"), py::keep_alive<0, 1>(), "Parse one FIX message; None if malformed");
+    m.def("parse_fix", [](py::str data) -> std::optional<FixMessage>
+          {
+              Py_ssize_t size;
+              const char *buffer = PyUnicode_AsUTF8AndSize(data.ptr(), &size);
+              if (!buffer)
+                  throw py::error_already_set();
+              FixMessage message;
+              if (!message.parse(std::string_view(buffer, static_cast<std::size_t>(size))))
+                  return std::nullopt;
+              return message; },
+          py::arg("data"), py::keep_alive<0, 1>());
+
+    // One FixEncoder per session; calls hold the GIL, so Python threads may share one
+    py::class_<FixEncoder>(m, "FixEncoder")
+        .def(py::init<std::string_view, std::string_view, int>(),
+             py::arg("sender_comp_id"), py::arg("target_comp_id"), py::arg("price_decimals") = 2)
+        .def("execution_report", [](FixEncoder &encoder, std::string_view order_id, std::string_view cl_ord_id,
+                                    std::string_view exec_id, char exec_type, char ord_status,
+                                    std::string_view symbol, char side, int order_qty, int last_qty,
+                                    double last_px, int cum_qty, double avg_px, std::string_view text)
+             {
+                 std::string &out = fix_send_buffer();
+                 encoder.append_execution_report({order_id, cl_ord_id, exec_id, symbol, text, exec_type, ord_status,
+                                                  side, order_qty, last_qty, cum_qty, last_px, avg_px},
+                                                 out);
+                 return fix_value(out); },
+             py::arg("order_id"), py::arg("cl_ord_id"), py::arg("exec_id"), py::arg("exec_type"),
+             py::arg("ord_status"), py::arg("symbol"), py::arg("side"), py::arg("order_qty"),
+             py::arg("last_qty"), py::arg("last_px"), py::arg("cum_qty"), py::arg("avg_px"),
+             py::arg("text") = "", "Encode a complete execution report (35=8)")
+        .def("message", [](FixEncoder &encoder, std::string_view msg_type, std::string_view body)
+             {
+                 std::string &out = fix_send_buffer();
+                 encoder.append_message(msg_type, body, out);
+                 return fix_value(out); },
+             py::arg("msg_type"), py::arg("body") = "",
+             "Wrap preformatted tag=value<SOH> body fields in the session header and trailer")
+        .def_property("seq_num", &FixEncoder::seq_num, &FixEncoder::set_seq_num)
+        .def("price_decimals", &FixEncoder::price_decimals);
+
+    py::enum_<FixCheck>(m, "FixCheck")
+        .value("Ok", FixCheck::Ok)
+        .value("BadBeginString", FixCheck::BadBeginString)
+        .value("MissingTag", FixCheck::MissingTag)
+        .value("BadTrailer", FixCheck::BadTrailer)
+        .value("BadBodyLength", FixCheck::BadBodyLength)
+        .value("BadChecksum", FixCheck::BadChecksum);
+
+    // FixValidation struct
+    py::class_<FixValidation>(m, "FixValidation")
+        .def_readonly("status", &FixValidation::status)
+        .def_readonly("tag", &FixValidation::tag)
+        .def_readonly("checksum", &FixValidation::checksum)
+        .def_readonly("body_length", &FixValidation::body_length)
+        .def_property_readonly("ok", [](const FixValidation &result)
+                               { return result.status == FixCheck::Ok; })
+        .def_property_readonly("error", [](const FixValidation &result)
+                               { return std::string(fix_check_text(result.status)); });
+
+    m.def("validate_fix", [](py::bytes data)
+          {
+              char *buffer;
+              py::ssize_t size;
+              if (PyBytes_AsStringAndSize(data.ptr(), &buffer, &size) != 0)
+                  throw py::error_already_set();
+              return validate_fix(std::string_view(buffer, static_cast<std::size_t>(size))); },
+          py::arg("data"), "Check BeginString, header tags, BodyLength and CheckSum in one pass");
+    m.def("validate_fix", [](py::str data)
+          {
+              Py_ssize_t size;
+              const char *buffer = PyUnicode_AsUTF8AndSize(data.ptr(), &size);
+              if (!buffer)
+                  throw py::error_already_set();
+              return validate_fix(std::string_view(buffer, static_cast<std::size_t>(size))); },
+          py::arg("data"));
+    m.def("fix_checksum", [](py::bytes data)
+          {
+              char *buffer;
+              py::ssize_t size;
+              if (PyBytes_AsStringAndSize(data.ptr(), &buffer, &size) != 0)
+                  throw py::error_already_set();
+              return fix_checksum(buffer, static_cast<std::size_t>(size)); },
+          py::arg("data"), "Sum of the bytes modulo 256 (FIX tag 10)");
+
+#ifdef __linux__
+    py::enum_<GatewayBackend>(m, "GatewayBackend")
+        .value("Epoll", GatewayBackend::Epoll)
+        .value("IoUring", GatewayBackend::IoUring);
+
+    // GatewayStats struct
+    py::class_<GatewayStats>(m, "GatewayStats")
+        .def_readonly("sessions", &GatewayStats::sessions)
+        .def_readonly("messages", &GatewayStats::messages)
+        .def_readonly("orders", &GatewayStats::orders)
+        .def_readonly("rejects", &GatewayStats::rejects);
+
+    // The gateway thread takes the GIL to run the logon policy, so it is
+    // stopped with the GIL released, including when the object is collected
+    struct GatewayDeleter
+    {
+        void operator()(FixGateway *gateway) const
+        {
+            py::gil_scoped_release release;
+            delete gateway;
+        }
+    };
+    py::class_<FixGateway, std::unique_ptr<FixGateway, GatewayDeleter>>(m, "FixGateway")
+        .def(py::init([](MatchingEngine &engine, std::vector<std::string> symbols, LogonPolicy logon,
+                         std::string comp_id, std::size_t recv_buffer, int price_decimals, GatewayBackend backend)
+                      {
+                          GatewayConfig config;
+                          config.symbols = std::move(symbols);
+                          config.logon = std::move(logon);
+                          config.comp_id = std::move(comp_id);
+                          config.recv_buffer = recv_buffer;
+                          config.price_decimals = price_decimals;
+                          config.backend = backend;
+                          return std::unique_ptr<FixGateway, GatewayDeleter>(new FixGateway(engine, std::move(config))); }),
+             py::arg("engine"), py::arg("symbols"), py::arg("logon") = nullptr, py::arg("comp_id") = "EXCHANGE",
+             py::arg("recv_buffer") = 65536, py::arg("price_decimals") = 2,
+             py::arg("backend") = GatewayBackend::Epoll, py::keep_alive<1, 2>(),
+             "logon(sender_comp_id, target_comp_id) -> bool decides each Logon; every Logon is accepted without it")
+        .def("start", &FixGateway::start, py::arg("host") = "127.0.0.1", py::arg("port") = 0,
+             py::arg("binary_port") = -1, release_gil(),
+             "Listen and start the event loop; port 0 picks a free port and a negative binary_port opens no "
+             "binary listener. False if the backend is unavailable.")
+        .def("stop", &FixGateway::stop, release_gil())
+        .def("running", &FixGateway::running)
+        .def("port", &FixGateway::port)
+        .def("binary_port", &FixGateway::binary_port)
+        .def("session_count", &FixGateway::session_count)
+        .def("stats", &FixGateway::stats);
+#endif
+
+    // Structured dtypes for the array batch entry points; NumPy is only imported on use
+    m.def("batch_order_dtype", []()
+          { return py::dtype::of<BatchOrder>(); });
+    m.def("batch_cancel_dtype", []()
+          { return py::dtype::of<BatchCancel>(); });
+    m.def("match_dtype", []()
+          { return py::dtype::of<Match>(); });
+    m.def("depth_level_dtype", []()
+          { return py::dtype::of<DepthLevel>(); });
+    m.def("l3_event_dtype", []()
+          { return py::dtype::of<L3Event>(); });
 }
@@ -16,7 +16,7 @@ import json
 import asyncio
 import os
 import queue
-from typing import Dict, List, Optional, Tuple, Set
+from typing import Dict, List, Optional, Tuple
 from datetime import datetime
 from dataclasses import dataclass, field
 
@@ -47,6 +47,8 @@ except ImportError:
     logger = logging.getLogger(__name__)
     logger.warning("Database module not available - persistence disabled")
 
+from market_data import MarketDataPublisher
+
 
 # Configure logging
 logging.basicConfig(
@@ -56,11 +58,6 @@ logging.basicConfig(
 logger = logging.getLogger(__name__)
 
 
-# WebSocket clients registry
-ws_clients: Set = set()
-ws_loop = None
-
-
 @dataclass
 class Order:
     """Represents an order in the exchange."""
@@ -140,7 +137,13 @@ class OrderBook:
     Persists to PostgreSQL database.
     """
     
-    def __init__(self, db_manager: Optional['DatabaseManager'] = None):
+    # Per-book event ring size in C++ mode; level deltas are drained after each order
+    MARKET_DATA_RING_SIZE = 65536
+    # Longest ClOrdID the C++ book can key an order by
+    NATIVE_CL_ORD_ID_LENGTH = 23
+    
+    def __init__(self, db_manager: Optional['DatabaseManager'] = None,
+                 use_cpp_engine: Optional[bool] = None):
         self.orders: Dict[str, Order] = {}
         self.buy_orders: Dict[str, List[Order]] = {}
         self.sell_orders: Dict[str, List[Order]] = {}
@@ -151,17 +154,38 @@ class OrderBook:
         self.db_manager = db_manager
 
         # Database queue for asynchronous writes
+        self._running = True
         self.db_queue = queue.Queue()
         self.db_worker_thread = threading.Thread(target=self._process_db_queue, daemon=True)
         self.db_worker_thread.start()
         
-        # Initialize C++ engine if available
-        if CPP_ENGINE_AVAILABLE:
+        # Initialize C++ engine if available (use_cpp_engine=False forces the Python engine)
+        if use_cpp_engine is None:
+            use_cpp_engine = CPP_ENGINE_AVAILABLE
+        if use_cpp_engine and CPP_ENGINE_AVAILABLE:
             self.cpp_engine = crucible_engine.MatchingEngine()
+            config = crucible_engine.BookConfig()
+            config.event_capacity = self.MARKET_DATA_RING_SIZE
+            self.cpp_engine.set_default_config(config)
             logger.info("Using C++ matching engine - High performance mode")
         else:
             self.cpp_engine = None
             logger.info("Using Python matching engine")
+
+        # C++ mode: resting orders by native order ID, and the native order behind each order ID
+        self.native_orders: Dict[int, Order] = {}
+        self.native_handles: Dict[str, 'crucible_engine.Order'] = {}
+        # C++ mode: fills made on entry per symbol, handed out by the next match_orders
+        self.pending_matches: Dict[str, List[Tuple[Order, Order, int, float]]] = {}
+        # C++ mode: symbol and book per native symbol ID, for market data
+        self.native_books: Dict[int, Tuple[str, 'crucible_engine.OrderBook']] = {}
+        # Keeps deltas in sequence order when several sessions publish at once
+        self.market_data_lock = threading.Lock()
+        # Conflates book changes for WebSocket subscribers; the WebSocket loop runs it
+        self.market_data = MarketDataPublisher(self.get_order_book_snapshot,
+                                               level_snapshot=self.get_level_snapshot)
+        # Engine events lost to full rings, as of the last publish
+        self.events_dropped = 0
     
     def _process_db_queue(self):
         """Worker thread to process database write operations."""
@@ -201,50 +225,30 @@ class OrderBook:
             return exec_id
     
     def broadcast_update(self, event_type: str, data: Dict):
-        """Broadcast updates to all connected WebSocket clients."""
-        if not WEBSOCKETS_AVAILABLE or not ws_clients or not ws_loop:
-            return
-        
+        """Queue an update for the WebSocket subscribers' next batch."""
         try:
-            message = json.dumps({
-                'type': event_type,
-                'data': data,
-                'timestamp': datetime.now().isoformat()
-            })
-            
-            # Schedule broadcast in WebSocket loop (non-blocking)
-            asyncio.run_coroutine_threadsafe(
-                self._async_broadcast(message),
-                ws_loop
-            )
+            self.market_data.publish_event(event_type, data)
         except Exception as e:
             logger.error(f"Error broadcasting update: {e}")
     
-    async def _async_broadcast(self, message: str):
-        """Async broadcast to all clients."""
-        disconnected = set()
-        for client in ws_clients:
-            try:
-                await client.send(message)
-            except Exception as e:
-                logger.error(f"Error sending to client: {e}")
-                disconnected.add(client)
-        
-        # Remove disconnected clients
-        for client in disconnected:
-            ws_clients.discard(client)
-    
     def add_order(self, order: Order) -> None:
-        """Add order to the order book."""
+        """Add order to the order book. In C++ mode, raises ValueError for a ClOrdID the book cannot key."""
+        if self.cpp_engine and len(order.cl_ord_id or "") > self.NATIVE_CL_ORD_ID_LENGTH:
+            # Truncating could give two orders the same key, and cancels would hit the wrong one
+            raise ValueError(f"cl_ord_id longer than {self.NATIVE_CL_ORD_ID_LENGTH} chars")
         with self.lock:
+            if self.cpp_engine:
+                # Submitted first, so an order the book refuses is never recorded
+                self._submit_native(order)
+            
             self.orders[order.order_id] = order
             
             # Enqueue order for asynchronous database save
             if self.db_manager:
                 self.db_queue.put(order.to_dict(for_display=False))
             
-            # Add to appropriate side
-            if order.side == "1":  # Buy
+            # Add to appropriate side; the C++ book already holds the order
+            if not self.cpp_engine and order.side == "1":  # Buy
                 if order.symbol not in self.buy_orders:
                     self.buy_orders[order.symbol] = []
                 self.buy_orders[order.symbol].append(order)
@@ -253,7 +257,7 @@ class OrderBook:
                     key=lambda x: (x.price if x.price else float('inf'), x.timestamp),
                     reverse=True
                 )
-            else:  # Sell
+            elif not self.cpp_engine:  # Sell
                 if order.symbol not in self.sell_orders:
                     self.sell_orders[order.symbol] = []
                 self.sell_orders[order.symbol].append(order)
@@ -265,10 +269,56 @@ class OrderBook:
         # Broadcast new order (use display format for WebSocket)
         self.broadcast_update('new_order', order.to_dict(for_display=True))
     
+    def _submit_native(self, order: Order) -> None:
+        """
+        Match an order on entry in the C++ book and mirror the fills. Caller holds self.lock.
+        
+        The book trades the order against resting orders at their prices, rests a limit
+        remainder and cancels a market remainder. The fills wait in pending_matches for
+        the next match_orders call.
+        """
+        if order.order_qty <= 0:
+            return  # Nothing to match; kept in self.orders only
+        
+        native = crucible_engine.Order(
+            order.cl_ord_id, order.side, order.order_qty, order.order_type,
+            order.price or 0.0, order.timestamp
+        )
+        result, fills = self.cpp_engine.submit_order(order.symbol, native)
+        if not result.accepted:
+            return
+        if native.symbol_id not in self.native_books:
+            self.native_books[native.symbol_id] = (order.symbol, self.cpp_engine.get_book(order.symbol))
+        if result.resting:
+            self.native_orders[native.order_id] = order
+            self.native_handles[order.order_id] = native
+        
+        matches = self._mirror_native(fills, native.order_id, order)
+        if native.status == "4":
+            order.status = "4"  # Market remainder canceled by the book
+        self.pending_matches.setdefault(order.symbol, []).extend(matches)
+    
     def get_order(self, order_id: str) -> Optional[Order]:
         """Retrieve order by ID."""
         return self.orders.get(order_id)
     
+    def cancel_by_cl_ord_id(self, symbol: str, cl_ord_id: str) -> Optional[Order]:
+        """Cancel the resting order with this client order ID; returns it, or None if none rests."""
+        if not self.cpp_engine:
+            order = next((o for o in self.orders.values() if o.cl_ord_id == cl_ord_id), None)
+            return order if order and self.cancel_order(order.order_id) else None
+        
+        with self.lock:
+            # The C++ book finds the order through its client order ID index
+            native = self.cpp_engine.cancel_by_cl_ord_id(symbol, cl_ord_id) if symbol else None
+            order = self.native_orders.pop(native.order_id, None) if native else None
+            if not order:
+                return None
+            self.native_handles.pop(order.order_id, None)
+            order.status = "4"  # Canceled
+            self.broadcast_update('cancel_order', order.to_dict(for_display=True))
+            return order
+    
     def cancel_order(self, order_id: str) -> bool:
         """Cancel an order."""
         with self.lock:
@@ -279,7 +329,12 @@ class OrderBook:
             order.status = "4"  # Canceled
             
             # Remove from active orders
-            if order.side == "1":
+            if self.cpp_engine:
+                native = self.native_handles.pop(order_id, None)
+                if native:
+                    self.cpp_engine.cancel_order(order.symbol, native.order_id)
+                    self.native_orders.pop(native.order_id, None)
+            elif order.side == "1":
                 if order.symbol in self.buy_orders and order in self.buy_orders[order.symbol]:
                     self.buy_orders[order.symbol].remove(order)
             else:
@@ -299,14 +354,88 @@ class OrderBook:
                 'recent_executions': self.executions[-20:] if self.executions else []
             }
             
-            for symbol, orders in self.buy_orders.items():
+            if self.cpp_engine:
+                buy_orders, sell_orders = self._native_resting_orders()
+            else:
+                buy_orders, sell_orders = self.buy_orders, self.sell_orders
+            
+            for symbol, orders in buy_orders.items():
                 snapshot['buy_orders'][symbol] = [o.to_dict(for_display=True) for o in orders if not o.is_complete]
             
-            for symbol, orders in self.sell_orders.items():
+            for symbol, orders in sell_orders.items():
                 snapshot['sell_orders'][symbol] = [o.to_dict(for_display=True) for o in orders if not o.is_complete]
             
             return snapshot
     
+    def publish_market_data(self):
+        """Hand book changes to the publisher: level deltas from the C++ engine, else a dirty book."""
+        if not self.cpp_engine:
+            self.market_data.mark_book_dirty()
+            return
+        
+        # Always drain, even with no clients, so the rings never fill up
+        with self.market_data_lock:
+            deltas = []
+            while True:
+                events = self.cpp_engine.drain_events()
+                if not events:
+                    break
+                deltas.extend(self._level_delta(e) for e in events
+                              if e.type == crucible_engine.EventType.BookUpdate)
+            if deltas:
+                self.market_data.update_levels(deltas)
+            
+            # A lost BookUpdate leaves a level no later delta repairs
+            dropped = self.cpp_engine.events_dropped()
+            if dropped != self.events_dropped:
+                logger.warning(f"Market data lost {dropped - self.events_dropped} engine events; resyncing subscribers")
+                self.events_dropped = dropped
+                self.market_data.resync_levels(dropped)
+    
+    def _level_delta(self, event) -> Dict:
+        """One C++ BookUpdate event as a WebSocket level delta; qty 0 removes the level."""
+        symbol, book = self.native_books[event.symbol_id]
+        return {
+            'symbol': symbol,
+            'side': 'Buy' if event.side == '1' else 'Sell',
+            'price': book.to_price(event.price_ticks),
+            'qty': event.qty,
+            'orders': event.leaves_qty,
+            'seq': event.sequence,
+        }
+    
+    def get_level_snapshot(self) -> Dict:
+        """Aggregated levels per symbol from the C++ books, with the sequence deltas continue from."""
+        levels = {}
+        with self.lock:
+            books = list(self.native_books.values())
+        
+        for symbol, book in books:
+            snapshot = book.snapshot()
+            levels[symbol] = {
+                'seq': snapshot.sequence,
+                'bids': [[level.price, level.qty, level.order_count] for level in snapshot.bids],
+                'asks': [[level.price, level.qty, level.order_count] for level in snapshot.asks],
+            }
+        return levels
+    
+    def _native_resting_orders(self) -> Tuple[Dict[str, List[Order]], Dict[str, List[Order]]]:
+        """Resting orders of the C++ books per symbol, in price-time order. Caller holds self.lock."""
+        buy_orders: Dict[str, List[Order]] = {}
+        sell_orders: Dict[str, List[Order]] = {}
+        
+        # Native order IDs increase with arrival, so they double as the time key
+        for native_id, order in sorted(self.native_orders.items()):
+            side_orders = buy_orders if order.side == "1" else sell_orders
+            side_orders.setdefault(order.symbol, []).append(order)
+        
+        for orders in buy_orders.values():
+            orders.sort(key=lambda o: -(o.price or float('inf')))
+        for orders in sell_orders.values():
+            orders.sort(key=lambda o: o.price or 0)
+        
+        return buy_orders, sell_orders
+    
     def add_execution(self, execution: Dict):
         """Add execution to history and broadcast."""
         with self.lock:
@@ -327,95 +456,133 @@ class OrderBook:
     def match_orders(self, symbol: str) -> List[Tuple[Order, Order, int, float]]:
         """Match buy and sell orders using price-time priority. Fast single-pass matching."""
         with self.lock:
-            matches = []
+            if self.cpp_engine:
+                matches = self._match_native(symbol)
+            else:
+                matches = self._match_python(symbol)
+        
+        # Record executions outside the book lock; add_execution takes it again
+        for buy_order, sell_order, match_qty, match_price in matches:
+            execution = {
+                'symbol': symbol,
+                'side': 'Buy',
+                'last_qty': match_qty,
+                'last_px': match_price,
+                'status': 'Filled' if buy_order.is_complete else 'Partial',
+                'timestamp': datetime.now().strftime('%H:%M:%S')
+            }
+            self.add_execution(execution)
+        
+        return matches
+    
+    def _match_native(self, symbol: str) -> List[Tuple[Order, Order, int, float]]:
+        """Fills the C++ book made on entry since the last call. Caller holds self.lock."""
+        return self.pending_matches.pop(symbol, [])
+    
+    def _mirror_native(self, fills, incoming_id: int, incoming: Order) -> List[Tuple[Order, Order, int, float]]:
+        """Apply C++ fills to the Python orders, incoming being the order with native ID incoming_id."""
+        matches = []
+        
+        for match in fills:
+            buy_order = incoming if match.buy_order_id == incoming_id else self.native_orders[match.buy_order_id]
+            sell_order = incoming if match.sell_order_id == incoming_id else self.native_orders[match.sell_order_id]
             
-            if symbol not in self.buy_orders or symbol not in self.sell_orders:
-                return matches
+            for order in (buy_order, sell_order):
+                order.filled_qty += match.qty
+                order.status = "2" if order.is_complete else "1"
             
-            # Get active orders and sort ONCE
-            buy_orders = [o for o in self.buy_orders[symbol] if not o.is_complete]
-            sell_orders = [o for o in self.sell_orders[symbol] if not o.is_complete]
+            matches.append((buy_order, sell_order, match.qty, match.price))
+        
+        # The C++ book has already dropped filled orders
+        for match in matches:
+            for order in match[:2]:
+                if order.is_complete and order.order_id in self.native_handles:
+                    native = self.native_handles.pop(order.order_id)
+                    del self.native_orders[native.order_id]
+        
+        return matches
+    
+    def _match_python(self, symbol: str) -> List[Tuple[Order, Order, int, float]]:
+        """Match with the Python sorted-list engine. Caller holds self.lock."""
+        matches = []
+        
+        if symbol not in self.buy_orders or symbol not in self.sell_orders:
+            return matches
+        
+        # Get active orders and sort ONCE
+        buy_orders = [o for o in self.buy_orders[symbol] if not o.is_complete]
+        sell_orders = [o for o in self.sell_orders[symbol] if not o.is_complete]
+        
+        if not buy_orders or not sell_orders:
+            return matches
+        
+        # Sort by price-time priority (once only)
+        buy_orders.sort(key=lambda o: (-(o.price or 0), o.timestamp))
+        sell_orders.sort(key=lambda o: (o.price or float('inf'), o.timestamp))
+        
+        # Match iteratively with safety limit
+        buy_idx = 0
+        sell_idx = 0
+        max_iterations = 100
+        iterations = 0
+        
+        while buy_idx < len(buy_orders) and sell_idx < len(sell_orders) and iterations < max_iterations:
+            iterations += 1
+            buy_order = buy_orders[buy_idx]
+            sell_order = sell_orders[sell_idx]
             
-            if not buy_orders or not sell_orders:
-                return matches
+            # Skip completed orders
+            if buy_order.is_complete:
+                buy_idx += 1
+                continue
+            if sell_order.is_complete:
+                sell_idx += 1
+                continue
             
-            # Sort by price-time priority (once only)
-            buy_orders.sort(key=lambda o: (-(o.price or 0), o.timestamp))
-            sell_orders.sort(key=lambda o: (o.price or float('inf'), o.timestamp))
+            # Check if they can match
+            can_match = False
+            match_price = 0.0
             
-            # Match iteratively with safety limit
-            buy_idx = 0
-            sell_idx = 0
-            max_iterations = 100
-            iterations = 0
+            if buy_order.order_type == "1":  # Market
+                can_match = True
+                match_price = sell_order.price or 100.0
+            elif sell_order.order_type == "1":  # Market
+                can_match = True
+                match_price = buy_order.price or 100.0
+            elif buy_order.price and sell_order.price and buy_order.price >= sell_order.price:
+                can_match = True
+                match_price = sell_order.price
             
-            while buy_idx < len(buy_orders) and sell_idx < len(sell_orders) and iterations < max_iterations:
-                iterations += 1
-                buy_order = buy_orders[buy_idx]
-                sell_order = sell_orders[sell_idx]
-                
-                # Skip completed orders
-                if buy_order.is_complete:
-                    buy_idx += 1
-                    continue
-                if sell_order.is_complete:
-                    sell_idx += 1
-                    continue
-                
-                # Check if they can match
-                can_match = False
-                match_price = 0.0
-                
-                if buy_order.order_type == "1":  # Market
-                    can_match = True
-                    match_price = sell_order.price or 100.0
-                elif sell_order.order_type == "1":  # Market
-                    can_match = True
-                    match_price = buy_order.price or 100.0
-                elif buy_order.price and sell_order.price and buy_order.price >= sell_order.price:
-                    can_match = True
-                    match_price = sell_order.price
-                
-                if not can_match:
-                    break  # No more matches possible
-                
-                # Execute the match
-                match_qty = min(buy_order.remaining_qty, sell_order.remaining_qty)
-                
-                buy_order.filled_qty += match_qty
-                sell_order.filled_qty += match_qty
-                buy_order.status = "2" if buy_order.is_complete else "1"
-                sell_order.status = "2" if sell_order.is_complete else "1"
-                
-                # Skip DB save during matching for speed - will save later
-                # if self.db_manager:
-                #     try:
-                #         self.db_manager.save_order(buy_order.to_dict(for_display=False))
-                #         self.db_manager.save_order(sell_order.to_dict(for_display=False))
-                #     except Exception as e:
-                #         logger.error(f"DB save failed: {e}")
-                
-                matches.append((buy_order, sell_order, match_qty, match_price))
-                
-                execution = {
-                    'symbol': symbol,
-                    'side': 'Buy',
-                    'last_qty': match_qty,
-                    'last_px': match_price,
-                    'status': 'Filled' if buy_order.is_complete else 'Partial',
-                    'timestamp': datetime.now().strftime('%H:%M:%S')
-                }
-                self.add_execution(execution)
-                
-                # Move to next order if current one complete
-                if buy_order.is_complete:
-                    buy_idx += 1
-                if sell_order.is_complete:
-                    sell_idx += 1
-                
-                # Safety: if neither complete, break to avoid infinite loop
-                if not buy_order.is_complete and not sell_order.is_complete:
-                    break
+            if not can_match:
+                break  # No more matches possible
+            
+            # Execute the match
+            match_qty = min(buy_order.remaining_qty, sell_order.remaining_qty)
+            
+            buy_order.filled_qty += match_qty
+            sell_order.filled_qty += match_qty
+            buy_order.status = "2" if buy_order.is_complete else "1"
+            sell_order.status = "2" if sell_order.is_complete else "1"
+            
+            # Skip DB save during matching for speed - will save later
+            # if self.db_manager:
+            #     try:
+            #         self.db_manager.save_order(buy_order.to_dict(for_display=False))
+            #         self.db_manager.save_order(sell_order.to_dict(for_display=False))
+            #     except Exception as e:
+            #         logger.error(f"DB save failed: {e}")
+            
+            matches.append((buy_order, sell_order, match_qty, match_price))
+            
+            # Move to next order if current one complete
+            if buy_order.is_complete:
+                buy_idx += 1
+            if sell_order.is_complete:
+                sell_idx += 1
+            
+            # Safety: if neither complete, break to avoid infinite loop
+            if not buy_order.is_complete and not sell_order.is_complete:
+                break
         
         return matches
 
@@ -431,7 +598,15 @@ class ExchangeServer:
     SOH = '\x01'
     VALID_SYMBOLS = ["AAPL", "GOOGL", "MSFT", "AMZN", "TSLA"]
     
-    def __init__(self, host: str = "127.0.0.1", port: int = 9878, db_manager: Optional['DatabaseManager'] = None):
+    # Native gateway mode: how often book changes are handed to the market data publisher
+    NATIVE_POLL_INTERVAL = 0.01
+    # Native gateway mode: seconds between book snapshots when a snapshot path is set
+    SNAPSHOT_INTERVAL = 60.0
+    
+    def __init__(self, host: str = "127.0.0.1", port: int = 9878, db_manager: Optional['DatabaseManager'] = None,
+                 native_gateway: bool = False, gateway_backend: str = "epoll",
+                 binary_port: Optional[int] = None, journal_path: Optional[str] = None,
+                 snapshot_path: Optional[str] = None):
         self.host = host
         self.port = port
         self.server_socket = None
@@ -439,9 +614,26 @@ class ExchangeServer:
         self.order_book = OrderBook(db_manager=db_manager)
         self.sessions: Dict[str, bool] = {}  # Track logged-in sessions
         self.db_manager = db_manager
+        # Python sessions: (SenderCompID, TargetCompID) answered with, set at Logon
+        self.session_comp_ids: Dict[str, Tuple[str, str]] = {}
+        # Native encoders for outbound messages, one per session so each keeps its own MsgSeqNum
+        self.session_encoders: Dict[str, 'crucible_engine.FixEncoder'] = {}
+        # Serve sessions from the C++ epoll gateway instead of a Python thread per connection
+        self.native_gateway = native_gateway and self.order_book.cpp_engine is not None
+        if native_gateway and not self.native_gateway:
+            logger.warning("Native gateway needs the C++ engine; using Python sessions")
+        self.gateway_backend = gateway_backend  # "epoll" or "io_uring"
+        self.binary_port = binary_port  # Native gateway only: binary order entry port, None for none
+        self.journal_path = journal_path  # Native gateway only: engine input journal, replayed on start
+        self.snapshot_path = snapshot_path  # Native gateway only: book snapshot, restored before the journal
+        self.gateway = None
     
     def start(self):
         """Start the exchange server."""
+        if self.native_gateway:
+            self._serve_native()
+            return
+        
         self.server_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
         self.server_socket.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
         self.server_socket.bind((self.host, self.port))
@@ -469,9 +661,76 @@ class ExchangeServer:
         finally:
             self.stop()
     
+    def _serve_native(self):
+        """
+        Run the C++ FIX gateway on the server port.
+        
+        The gateway frames, validates and matches orders itself; Python only decides
+        logons and forwards book changes to WebSocket subscribers. Orders entered this
+        way live in the C++ books only, so the Python order views do not list them.
+        """
+        engine = self.order_book.cpp_engine
+        if self.snapshot_path and os.path.exists(self.snapshot_path):
+            # The snapshot brings the books back in bulk; the journal replay below skips what it holds
+            restored = engine.restore(self.snapshot_path)
+            logger.info(f"Restored {restored} resting orders from {self.snapshot_path}")
+        if self.journal_path:
+            # Orders accepted before a restart come back from the journal, then new ones extend it
+            if os.path.exists(self.journal_path):
+                replayed = engine.replay(self.journal_path)
+                logger.info(f"Replayed {replayed} journaled inputs from {self.journal_path}")
+            engine.open_journal(self.journal_path)
+        for symbol in self.VALID_SYMBOLS:
+            book = engine.get_or_create_book(symbol)
+            self.order_book.native_books[book.symbol_id()] = (symbol, book)
+        
+        backend = (crucible_engine.GatewayBackend.IoUring if self.gateway_backend == "io_uring"
+                   else crucible_engine.GatewayBackend.Epoll)
+        self.gateway = crucible_engine.FixGateway(engine, self.VALID_SYMBOLS, logon=self.native_logon,
+                                                  backend=backend)
+        binary_port = -1 if self.binary_port is None else self.binary_port
+        if not self.gateway.start(self.host, self.port, binary_port):
+            raise OSError(f"Native gateway ({self.gateway_backend}) could not start on {self.host}:{self.port}")
+        self.running = True
+        
+        logger.info(f"Exchange Server started on {self.host}:{self.port} (native gateway, {self.gateway_backend})")
+        if self.binary_port is not None:
+            logger.info(f"Binary order entry on {self.host}:{self.gateway.binary_port()}")
+        
+        last_snapshot = time.monotonic()
+        try:
+            while self.running:
+                time.sleep(self.NATIVE_POLL_INTERVAL)
+                self.order_book.publish_market_data()
+                if self.snapshot_path and time.monotonic() - last_snapshot >= self.SNAPSHOT_INTERVAL:
+                    # Written in the background; a snapshot still being written skips this round
+                    engine.snapshot(self.snapshot_path)
+                    last_snapshot = time.monotonic()
+        finally:
+            self.stop()
+    
+    def native_logon(self, sender_comp_id: str, target_comp_id: str) -> bool:
+        """Logon policy for native gateway sessions; runs on the gateway thread."""
+        self.sessions[sender_comp_id] = True
+        logger.info(f"Session {sender_comp_id} logged in (native gateway)")
+        return True
+    
     def stop(self):
         """Stop the exchange server."""
         self.running = False
+        if self.gateway:
+            self.gateway.stop()
+            if self.snapshot_path:
+                # A final snapshot leaves nothing in the journal to replay on restart
+                engine = self.order_book.cpp_engine
+                try:
+                    engine.wait_snapshot()
+                    engine.snapshot(self.snapshot_path)
+                    engine.wait_snapshot()
+                except RuntimeError as e:
+                    logger.error(f"Snapshot failed: {e}")
+        if self.journal_path and self.order_book.cpp_engine is not None:
+            self.order_book.cpp_engine.close_journal()
         if self.server_socket:
             self.server_socket.close()
         self.order_book.stop() # Stop the order book's background threads
@@ -532,6 +791,8 @@ class ExchangeServer:
             # Clean up session
             if session_id in self.sessions:
                 del self.sessions[session_id]
+            self.session_comp_ids.pop(session_id, None)
+            self.session_encoders.pop(session_id, None)
             client_socket.close()
             logger.info(f"Connection closed: {address}")
     
@@ -547,23 +808,31 @@ class ExchangeServer:
         
         return tags
     
-    def build_fix_message(self, msg_type: str, tags: Dict[str, str]) -> str:
+    def build_fix_message(self, msg_type: str, tags: Dict[str, str], session_id: Optional[str] = None) -> str:
         """
         Build FIX message with header and trailer.
         
         Args:
             msg_type: Message type (Tag 35)
             tags: Dictionary of tag-value pairs for body
+            session_id: Session the message goes to; its Logon set the CompIDs
             
         Returns:
             Complete FIX message string
         """
+        encoder = self.session_encoders.get(session_id)
+        if encoder:
+            body = "".join(f"{tag}={value}{self.SOH}" for tag, value in tags.items())
+            return encoder.message(msg_type, body)
+        
+        sender_comp_id, target_comp_id = self.session_comp_ids.get(session_id, ("EXCHANGE", "CLIENT"))
+        
         # Build body
         body = f"35={msg_type}{self.SOH}"
         
         # Add standard tags
-        body += f"49=EXCHANGE{self.SOH}"
-        body += f"56=CLIENT{self.SOH}"
+        body += f"49={sender_comp_id}{self.SOH}"
+        body += f"56={target_comp_id}{self.SOH}"
         body += f"34=1{self.SOH}"  # Simplified sequence number
         body += f"52={datetime.utcnow().strftime('%Y%m%d-%H:%M:%S')}{self.SOH}"
         
@@ -596,7 +865,12 @@ class ExchangeServer:
         Returns:
             Response FIX message or None
         """
-        tags = self.parse_fix_message(message)
+        tags = None
+        if CPP_ENGINE_AVAILABLE:
+            # Native parse scans the message once; handlers read tags through the same get/in/[] interface
+            tags = crucible_engine.parse_fix(message)
+        if tags is None:
+            tags = self.parse_fix_message(message)
         msg_type = tags.get("35")
         
         logger.info(f"Received message type: {msg_type} from {session_id}")
@@ -604,13 +878,13 @@ class ExchangeServer:
         if msg_type == "A":  # Logon
             return self.handle_logon(tags, session_id)
         elif msg_type == "0":  # Heartbeat
-            return self.handle_heartbeat(tags)
+            return self.handle_heartbeat(tags, session_id)
         elif msg_type == "5":  # Logout
             return self.handle_logout(tags, session_id)
         elif msg_type == "D":  # New Order Single
-            return self.handle_new_order(tags)
+            return self.handle_new_order(tags, session_id)
         elif msg_type == "F":  # Order Cancel Request
-            return self.handle_cancel_request(tags)
+            return self.handle_cancel_request(tags, session_id)
         else:
             logger.warning(f"Unknown message type: {msg_type}")
             return None
@@ -620,13 +894,20 @@ class ExchangeServer:
         self.sessions[session_id] = True
         logger.info(f"Session {session_id} logged in")
         
+        # Answer as the CompID the client addressed, to the CompID it sent from
+        comp_ids = (tags.get("56") or "EXCHANGE", tags.get("49") or "CLIENT")
+        if self.session_comp_ids.get(session_id) != comp_ids:
+            self.session_comp_ids[session_id] = comp_ids
+            if CPP_ENGINE_AVAILABLE:
+                self.session_encoders[session_id] = crucible_engine.FixEncoder(*comp_ids)
+        
         response_tags = {
             "108": tags.get("108", "30")  # Heartbeat interval
         }
         
-        return self.build_fix_message("A", response_tags)
+        return self.build_fix_message("A", response_tags, session_id)
     
-    def handle_heartbeat(self, tags: Dict[str, str]) -> str:
+    def handle_heartbeat(self, tags: Dict[str, str], session_id: str) -> str:
         """Handle Heartbeat message."""
         response_tags = {}
         
@@ -634,7 +915,7 @@ class ExchangeServer:
         if "112" in tags:
             response_tags["112"] = tags["112"]
         
-        return self.build_fix_message("0", response_tags)
+        return self.build_fix_message("0", response_tags, session_id)
     
     def handle_logout(self, tags: Dict[str, str], session_id: str) -> str:
         """Handle Logout message."""
@@ -643,9 +924,12 @@ class ExchangeServer:
         
         logger.info(f"Session {session_id} logged out")
         
-        return self.build_fix_message("5", {})
+        response = self.build_fix_message("5", {}, session_id)
+        self.session_comp_ids.pop(session_id, None)
+        self.session_encoders.pop(session_id, None)
+        return response
     
-    def handle_new_order(self, tags: Dict[str, str]) -> str:
+    def handle_new_order(self, tags: Dict[str, str], session_id: str) -> str:
         """Handle New Order Single message."""
         cl_ord_id = tags.get("11")
         symbol = tags.get("55")
@@ -654,25 +938,49 @@ class ExchangeServer:
         order_type = tags.get("40")
         price = float(tags.get("44")) if "44" in tags else None
         
+        # Required fields, as the native gateway requires them
+        if not cl_ord_id:
+            return self._create_reject_execution_report(
+                cl_ord_id, symbol, side, order_qty,
+                "Missing ClOrdID", session_id
+            )
+        if side not in ("1", "2"):
+            return self._create_reject_execution_report(
+                cl_ord_id, symbol, side, order_qty,
+                f"Invalid side: {side}", session_id
+            )
+        if order_type not in ("1", "2"):
+            return self._create_reject_execution_report(
+                cl_ord_id, symbol, side, order_qty,
+                f"Invalid order type: {order_type}", session_id
+            )
+        
         # Validate symbol
         if symbol not in self.VALID_SYMBOLS:
             return self._create_reject_execution_report(
                 cl_ord_id, symbol, side, order_qty,
-                f"Invalid symbol: {symbol}"
+                f"Invalid symbol: {symbol}", session_id
             )
         
         # Validate price
         if price is not None and price <= 0:
             return self._create_reject_execution_report(
                 cl_ord_id, symbol, side, order_qty,
-                f"Invalid price: {price}"
+                f"Invalid price: {price}", session_id
             )
         
         # Validate quantity
         if order_qty <= 0:
             return self._create_reject_execution_report(
                 cl_ord_id, symbol, side, order_qty,
-                f"Invalid quantity: {order_qty}"
+                f"Invalid quantity: {order_qty}", session_id
+            )
+        
+        # The C++ book keys orders by fixed-width client IDs
+        if self.order_book.cpp_engine and len(cl_ord_id or "") > OrderBook.NATIVE_CL_ORD_ID_LENGTH:
+            return self._create_reject_execution_report(
+                cl_ord_id, symbol, side, order_qty,
+                f"ClOrdID longer than {OrderBook.NATIVE_CL_ORD_ID_LENGTH} characters", session_id
             )
         
         # Create order
@@ -688,14 +996,14 @@ class ExchangeServer:
             status="0"  # New
         )
         
+        # Send New acknowledgment; built first, since in C++ mode add_order already matches
+        response = self._create_execution_report(order, "0", "0", 0, 0.0, session_id)
+        
         self.order_book.add_order(order)
         logger.info(f"Order created: {order_id}")
         
         # Note: Broadcasting is handled in add_order method
         
-        # Send New acknowledgment
-        response = self._create_execution_report(order, "0", "0", 0, 0.0)
-        
         # Try to match orders with timing
         import time
         start = time.time()
@@ -707,43 +1015,33 @@ class ExchangeServer:
             logger.error(f"Error matching orders: {e}", exc_info=True)
             matches = []
         
-        # Broadcast updated orderbook after matching
-        orderbook_snapshot = self.order_book.get_order_book_snapshot()
-        self.order_book.broadcast_update('orderbook', orderbook_snapshot)
+        # Broadcast what the order and its matches changed in the book
+        self.order_book.publish_market_data()
         
-        # Send execution reports for matches
+        # Send execution reports for matches, only for the incoming order
+        # (to avoid sending reports for previously placed orders); built only
+        # when sent, since each one takes a MsgSeqNum from this session
         for buy_order, sell_order, match_qty, match_price in matches:
-            # Report for the buy side
-            buy_exec_type = "2" if buy_order.is_complete else "1"
-            buy_report = self._create_execution_report(
-                buy_order, buy_exec_type, buy_order.status, match_qty, match_price
-            )
-            # Report for the sell side
-            sell_exec_type = "2" if sell_order.is_complete else "1"
-            sell_report = self._create_execution_report(
-                sell_order, sell_exec_type, sell_order.status, match_qty, match_price
-            )
-            
-            # Only append to response if this is the incoming order
-            # (to avoid sending reports for previously placed orders)
-            if buy_order.cl_ord_id == cl_ord_id:
-                response += buy_report
-            if sell_order.cl_ord_id == cl_ord_id:
-                response += sell_report
+            for matched in (buy_order, sell_order):
+                if matched.cl_ord_id == cl_ord_id:
+                    exec_type = "2" if matched.is_complete else "1"
+                    response += self._create_execution_report(
+                        matched, exec_type, matched.status, match_qty, match_price, session_id
+                    )
+        
+        # The C++ book cancels what a market order could not fill
+        if order.status == "4":
+            response += self._create_execution_report(order, "4", "4", 0, 0.0, session_id)
         
         logger.info(f"Returning response for order {cl_ord_id}, length: {len(response)} bytes")
         return response
     
-    def handle_cancel_request(self, tags: Dict[str, str]) -> str:
+    def handle_cancel_request(self, tags: Dict[str, str], session_id: str) -> str:
         """Handle Order Cancel Request message."""
         orig_cl_ord_id = tags.get("41")
         
-        # Find order by client order ID
-        order = None
-        for ord in self.order_book.orders.values():
-            if ord.cl_ord_id == orig_cl_ord_id:
-                order = ord
-                break
+        # Cancel by client order ID
+        order = self.order_book.cancel_by_cl_ord_id(tags.get("55"), orig_cl_ord_id)
         
         if not order:
             # Send cancel reject
@@ -753,13 +1051,13 @@ class ExchangeServer:
                 "39": "8",  # Rejected
                 "58": "Order not found"
             }
-            return self.build_fix_message("8", response_tags)
+            return self.build_fix_message("8", response_tags, session_id)
         
-        # Cancel the order
-        self.order_book.cancel_order(order.order_id)
+        if self.order_book.cpp_engine:
+            self.order_book.publish_market_data()
         
         # Send execution report with canceled status
-        return self._create_execution_report(order, "4", "4", 0, 0.0)
+        return self._create_execution_report(order, "4", "4", 0, 0.0, session_id)
     
     def _create_execution_report(
         self,
@@ -767,11 +1065,20 @@ class ExchangeServer:
         exec_type: str,
         ord_status: str,
         last_qty: int,
-        last_px: float
+        last_px: float,
+        session_id: Optional[str] = None
     ) -> str:
         """Create execution report for an order."""
         exec_id = self.order_book.generate_exec_id()
         
+        encoder = self.session_encoders.get(session_id)
+        if encoder and order.side and len(order.side) == 1:
+            return encoder.execution_report(
+                order.order_id, order.cl_ord_id or "", exec_id, exec_type, ord_status,
+                order.symbol, order.side, order.order_qty, last_qty, last_px,
+                order.filled_qty, last_px
+            )
+        
         tags = {
             "37": order.order_id,
             "11": order.cl_ord_id,
@@ -788,7 +1095,7 @@ class ExchangeServer:
             "60": datetime.utcnow().strftime("%Y%m%d-%H:%M:%S")
         }
         
-        return self.build_fix_message("8", tags)
+        return self.build_fix_message("8", tags, session_id)
     
     def _create_reject_execution_report(
         self,
@@ -796,12 +1103,19 @@ class ExchangeServer:
         symbol: str,
         side: str,
         order_qty: int,
-        reason: str
+        reason: str,
+        session_id: Optional[str] = None
     ) -> str:
         """Create rejection execution report."""
         exec_id = self.order_book.generate_exec_id()
         order_id = self.order_book.generate_order_id()
         
+        encoder = self.session_encoders.get(session_id)
+        if encoder and side and len(side) == 1:
+            return encoder.execution_report(
+                order_id, cl_ord_id or "", exec_id, "8", "8", symbol or "", side, order_qty, 0, 0.0, 0, 0.0, reason
+            )
+        
         tags = {
             "37": order_id,
             "11": cl_ord_id,
@@ -819,13 +1133,11 @@ class ExchangeServer:
             "60": datetime.utcnow().strftime("%Y%m%d-%H:%M:%S")
         }
         
-        return self.build_fix_message("8", tags)
+        return self.build_fix_message("8", tags, session_id)
 
 
 def main():
     """Main entry point for the exchange server."""
-    global ws_loop
-    
     # Initialize database if available
     db_manager = None
     if DB_AVAILABLE:
@@ -838,41 +1150,75 @@ def main():
             db_manager = None
     
     # Start FIX server with database
-    server = ExchangeServer(db_manager=db_manager)
+    # CRUCIBLE_NATIVE_GATEWAY=1 (or epoll) or io_uring serves FIX from the C++ gateway
+    # and CRUCIBLE_BINARY_PORT adds the gateway's binary order entry port;
+    # CRUCIBLE_JOURNAL names the engine journal it recovers from and appends to,
+    # and CRUCIBLE_SNAPSHOT the book snapshot it restores first and rewrites periodically
+    gateway_mode = os.environ.get('CRUCIBLE_NATIVE_GATEWAY', '')
+    binary_port = os.environ.get('CRUCIBLE_BINARY_PORT')
+    server = ExchangeServer(db_manager=db_manager, native_gateway=gateway_mode in ('1', 'epoll', 'io_uring'),
+                            gateway_backend='io_uring' if gateway_mode == 'io_uring' else 'epoll',
+                            binary_port=int(binary_port) if binary_port else None,
+                            journal_path=os.environ.get('CRUCIBLE_JOURNAL'),
+                            snapshot_path=os.environ.get('CRUCIBLE_SNAPSHOT'))
     
     # Start WebSocket server if available
     if WEBSOCKETS_AVAILABLE:
+        market_data = server.order_book.market_data
+        
         def start_websocket():
-            global ws_loop
             ws_loop = asyncio.new_event_loop()
             asyncio.set_event_loop(ws_loop)
             
             async def websocket_handler(websocket):
                 """Handle WebSocket connections."""
-                ws_clients.add(websocket)
-                logger.info(f"WebSocket client connected. Total clients: {len(ws_clients)}")
                 
-                try:
-                    # Send initial snapshot
+                async def send_snapshot():
+                    # Batches continue from this snapshot
+                    market_data.subscribe(websocket)
                     snapshot = server.order_book.get_order_book_snapshot()
+                    if server.order_book.cpp_engine:
+                        # Level deltas with a higher seq apply on top of these levels
+                        snapshot['levels'] = server.order_book.get_level_snapshot()
+                        snapshot['events_dropped'] = server.order_book.events_dropped
                     await websocket.send(json.dumps({
                         'type': 'snapshot',
                         'data': snapshot,
                         'timestamp': datetime.now().isoformat()
                     }))
+                
+                try:
+                    # Send initial snapshot
+                    await send_snapshot()
+                    logger.info(f"WebSocket client connected. Total clients: {market_data.subscriber_count()}")
                     
-                    # Keep connection alive
+                    # A client may ask for a fresh snapshot or a different update interval
                     async for message in websocket:
-                        pass
+                        try:
+                            request = json.loads(message)
+                        except ValueError:
+                            continue
+                        if not isinstance(request, dict):
+                            continue
+                        if request.get('type') == 'snapshot':
+                            await send_snapshot()
+                        elif request.get('type') == 'subscribe':
+                            throttle_ms = request.get('throttle_ms')
+                            if throttle_ms is None or isinstance(throttle_ms, (int, float)):
+                                market_data.set_throttle(websocket, throttle_ms)
                 except websockets.exceptions.ConnectionClosed:
                     logger.info("WebSocket client disconnected")
                 finally:
-                    ws_clients.discard(websocket)
+                    market_data.unsubscribe(websocket)
             
             async def start_ws_server():
                 server_ws = await websockets.serve(websocket_handler, "127.0.0.1", 8765)
                 logger.info("WebSocket server started on ws://127.0.0.1:8765")
-                await server_ws.wait_closed()
+                publisher = asyncio.ensure_future(market_data.run())
+                try:
+                    await server_ws.wait_closed()
+                finally:
+                    publisher.cancel()
             
             ws_loop.run_until_complete(start_ws_server())
         
@@ -0,0 +1,192 @@
+#include "fix_encoder.hpp"
+#include <charconv>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CRUCIBLE_FIX_SSE2 1
+#endif
+
+namespace crucible
+{
+
+    namespace
+    {
+        constexpr char kSoh = '\x01';
+        constexpr std::string_view kBeginString = "8=FIX.4.2\x01" "9=";
+
+        constexpr std::int64_t kPow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+
+        void append_int(std::string &out, std::int64_t value)
+        {
+            char digits[24];
+            auto result = std::to_chars(digits, digits + sizeof(digits), value);
+            out.append(digits, static_cast<std::size_t>(result.ptr - digits));
+        }
+
+        // Fixed point with the given decimals, rounded half away from zero
+        void append_price(std::string &out, double price, int decimals)
+        {
+            std::int64_t scaled = std::llround(price * static_cast<double>(kPow10[decimals]));
+            if (scaled < 0)
+            {
+                out.push_back('-');
+                scaled = -scaled;
+            }
+            append_int(out, scaled / kPow10[decimals]);
+            if (decimals == 0)
+                return;
+
+            out.push_back('.');
+            std::int64_t fraction = scaled % kPow10[decimals];
+            for (int i = decimals - 1; i >= 0; --i)
+                out.push_back(static_cast<char>('0' + fraction / kPow10[i] % 10));
+        }
+
+        void append_field(std::string &out, std::string_view tag, std::string_view value)
+        {
+            out.append(tag);
+            out.append(value);
+            out.push_back(kSoh);
+        }
+
+        void append_field(std::string &out, std::string_view tag, char value)
+        {
+            out.append(tag);
+            out.push_back(value);
+            out.push_back(kSoh);
+        }
+
+        void append_int_field(std::string &out, std::string_view tag, std::int64_t value)
+        {
+            out.append(tag);
+            append_int(out, value);
+            out.push_back(kSoh);
+        }
+
+        void append_price_field(std::string &out, std::string_view tag, double price, int decimals)
+        {
+            out.append(tag);
+            append_price(out, price, decimals);
+            out.push_back(kSoh);
+        }
+    }
+
+    std::uint32_t fix_checksum(const char *data, std::size_t size)
+    {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+        std::uint64_t sum = 0;
+        std::size_t i = 0;
+
+#ifdef CRUCIBLE_FIX_SSE2
+        // psadbw against zero adds each 8-byte half into a 64-bit lane
+        __m128i zero = _mm_setzero_si128();
+        __m128i total = zero;
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i));
+            total = _mm_add_epi64(total, _mm_sad_epu8(chunk, zero));
+        }
+        alignas(16) std::uint64_t lanes[2];
+        _mm_store_si128(reinterpret_cast<__m128i *>(lanes), total);
+        sum = lanes[0] + lanes[1];
+#endif
+        for (; i < size; ++i)
+            sum += bytes[i];
+        return static_cast<std::uint32_t>(sum % 256);
+    }
+
+    FixEncoder::FixEncoder(std::string_view sender_comp_id, std::string_view target_comp_id, int price_decimals)
+        : price_decimals_(price_decimals < 0 ? 0 : price_decimals > 8 ? 8 : price_decimals)
+    {
+        append_field(comp_ids_, "49=", sender_comp_id);
+        append_field(comp_ids_, "56=", target_comp_id);
+        body_.reserve(512);
+    }
+
+    std::string_view FixEncoder::timestamp()
+    {
+        std::time_t now = std::time(nullptr);
+        if (now != timestamp_second_)
+        {
+            std::tm utc;
+#ifdef _WIN32
+            gmtime_s(&utc, &now);
+#else
+            gmtime_r(&now, &utc);
+#endif
+            auto put = [this](int offset, int value, int width)
+            {
+                for (int i = offset + width - 1; i >= offset; --i, value /= 10)
+                    timestamp_[i] = static_cast<char>('0' + value % 10);
+            };
+            put(0, utc.tm_year + 1900, 4);
+            put(4, utc.tm_mon + 1, 2);
+            put(6, utc.tm_mday, 2);
+            timestamp_[8] = '-';
+            put(9, utc.tm_hour, 2);
+            timestamp_[11] = ':';
+            put(12, utc.tm_min, 2);
+            timestamp_[14] = ':';
+            put(15, utc.tm_sec, 2);
+            timestamp_second_ = now;
+        }
+        return std::string_view(timestamp_, sizeof(timestamp_));
+    }
+
+    std::size_t FixEncoder::finish(std::string_view msg_type, std::string &out)
+    {
+        char seq_num[24];
+        std::size_t seq_size = static_cast<std::size_t>(
+            std::to_chars(seq_num, seq_num + sizeof(seq_num), seq_num_++).ptr - seq_num);
+        std::string_view sending_time = timestamp();
+
+        // BodyLength counts from MsgType to the last body field; the header's size is known up front
+        std::size_t body_length = 3 + msg_type.size() + 1 + comp_ids_.size() + 3 + seq_size + 1 +
+                                  3 + sending_time.size() + 1 + body_.size();
+
+        std::size_t start = out.size();
+        out.append(kBeginString);
+        append_int(out, static_cast<std::int64_t>(body_length));
+        out.push_back(kSoh);
+        append_field(out, "35=", msg_type);
+        out.append(comp_ids_);
+        append_field(out, "34=", std::string_view(seq_num, seq_size));
+        append_field(out, "52=", sending_time);
+        out.append(body_);
+
+        std::uint32_t checksum = fix_checksum(out.data() + start, out.size() - start);
+        char trailer[] = {'1', '0', '=', static_cast<char>('0' + checksum / 100),
+                          static_cast<char>('0' + checksum / 10 % 10), static_cast<char>('0' + checksum % 10), kSoh};
+        out.append(trailer, sizeof(trailer));
+        return out.size() - start;
+    }
+
+    std::size_t FixEncoder::append_execution_report(const ExecReport &report, std::string &out)
+    {
+        body_.clear();
+        append_field(body_, "37=", report.order_id);
+        append_field(body_, "11=", report.cl_ord_id);
+        append_field(body_, "17=", report.exec_id);
+        append_field(body_, "150=", report.exec_type);
+        append_field(body_, "39=", report.ord_status);
+        append_field(body_, "55=", report.symbol);
+        append_field(body_, "54=", report.side);
+        append_int_field(body_, "38=", report.order_qty);
+        append_int_field(body_, "32=", report.last_qty);
+        append_price_field(body_, "31=", report.last_px, price_decimals_);
+        append_int_field(body_, "14=", report.cum_qty);
+        append_price_field(body_, "6=", report.avg_px, price_decimals_);
+        if (!report.text.empty())
+            append_field(body_, "58=", report.text);
+        append_field(body_, "60=", timestamp());
+        return finish("8", out);
+    }
+
+    std::size_t FixEncoder::append_message(std::string_view msg_type, std::string_view body, std::string &out)
+    {
+        body_.assign(body.data(), body.size());
+        return finish(msg_type, out);
+    }
+
+} // namespace crucible
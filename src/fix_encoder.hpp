@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <string_view>
+
+namespace crucible
+{
+
+    // Sum of the bytes modulo 256, as carried in FIX tag 10
+    std::uint32_t fix_checksum(const char *data, std::size_t size);
+
+    // Fields of one execution report (35=8); strings view caller-owned data
+    struct ExecReport
+    {
+        std::string_view order_id;  // 37
+        std::string_view cl_ord_id; // 11
+        std::string_view exec_id;   // 17
+        std::string_view symbol;    // 55
+        std::string_view text;      // 58, left out when empty
+        char exec_type;             // 150
+        char ord_status;            // 39
+        char side;                  // 54
+        int order_qty;              // 38
+        int last_qty;               // 32
+        int cum_qty;                // 14
+        double last_px;             // 31
+        double avg_px;              // 6
+    };
+
+    // Encodes outbound messages of one session. The BeginString, comp ids and
+    // SendingTime are preformatted (the time once per second), numbers are
+    // written in place, and each message is appended whole to the caller's send
+    // buffer. Not thread safe: one encoder per session or per thread.
+    class FixEncoder
+    {
+    private:
+        std::string comp_ids_; // "49=...<SOH>56=...<SOH>"
+        std::string body_;     // Scratch, reused so encoding does not allocate
+        std::uint64_t seq_num_ = 1;
+        int price_decimals_;
+        std::time_t timestamp_second_ = -1;
+        char timestamp_[17];   // YYYYMMDD-HH:MM:SS of timestamp_second_, not terminated
+
+        std::string_view timestamp();
+        std::size_t finish(std::string_view msg_type, std::string &out);
+
+    public:
+        FixEncoder(std::string_view sender_comp_id, std::string_view target_comp_id, int price_decimals = 2);
+
+        // Each append returns the length of the message added to out
+        std::size_t append_execution_report(const ExecReport &report, std::string &out);
+        // body holds the message's own tag=value<SOH> fields after the standard header
+        std::size_t append_message(std::string_view msg_type, std::string_view body, std::string &out);
+
+        std::uint64_t seq_num() const { return seq_num_; } // MsgSeqNum of the next message
+        void set_seq_num(std::uint64_t seq_num) { seq_num_ = seq_num; }
+        int price_decimals() const { return price_decimals_; }
+    };
+
+} // namespace crucible
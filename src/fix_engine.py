@@ -9,6 +9,13 @@ import time
 from typing import Dict, Optional, Tuple
 from datetime import datetime
 
+# Native checksum and validation kernels, when the C++ engine is built
+try:
+    import crucible_engine
+    NATIVE_FIX_AVAILABLE = True
+except ImportError:
+    NATIVE_FIX_AVAILABLE = False
+
 
 class FIXEngine:
     """
@@ -77,7 +84,10 @@ class FIXEngine:
         Returns:
             Three-digit checksum string (e.g., "156")
         """
-        checksum = sum(ord(char) for char in message) % 256
+        if NATIVE_FIX_AVAILABLE:
+            checksum = crucible_engine.fix_checksum(message.encode())
+        else:
+            checksum = sum(ord(char) for char in message) % 256
         return f"{checksum:03d}"
     
     def _get_timestamp(self) -> str:
@@ -381,6 +391,10 @@ class FIXEngine:
         Returns:
             Tuple of (is_valid, error_message)
         """
+        # One native pass settles valid messages; the checks below explain invalid ones
+        if NATIVE_FIX_AVAILABLE and crucible_engine.validate_fix(raw_message).ok:
+            return True, None
+        
         # Check if message starts with BeginString (Tag 8)
         if not raw_message.startswith("8="):
             return False, "Message must start with BeginString (Tag 8)"
@@ -402,6 +416,12 @@ class FIXEngine:
         if not self.validate_checksum(raw_message):
             return False, "Invalid checksum"
         
+        # Validate body length (bytes after the BodyLength field up to the checksum field)
+        body_start = raw_message.find(self.SOH, raw_message.find(self.SOH + "9=") + 1) + 1
+        body_length = len(raw_message[body_start:raw_message.rfind("10=")].encode())
+        if tags["9"] != str(body_length):
+            return False, "Invalid body length"
+        
         return True, None
     
     def reset_sequence(self) -> None:
@@ -0,0 +1,1168 @@
+#include "fix_gateway.hpp"
+
+#ifdef __linux__
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace crucible
+{
+
+    namespace
+    {
+        constexpr std::uint64_t kListenId = 0;
+        constexpr std::uint64_t kWakeId = 1;
+        constexpr std::uint64_t kBinaryListenId = 2;
+        constexpr std::uint64_t kFirstSessionId = 3;
+        constexpr int kMaxEvents = 256;
+        constexpr std::size_t kMaxHeader = 32; // 8=BeginString<SOH>9=BodyLength<SOH> fits in this
+        constexpr std::size_t kTrailerSize = 7; // 10=NNN<SOH>
+
+        // io_uring: operation in the top byte of user_data, session id below
+        constexpr unsigned kOpShift = 56;
+        constexpr std::uint64_t kRecvOp = 1;
+        constexpr std::uint64_t kSendOp = 2;
+        constexpr unsigned kRingEntries = 4096;
+        constexpr unsigned kRecvBuffers = 4096; // Shared by all sessions; a power of two
+        constexpr unsigned kRecvBufferSize = 4096;
+        constexpr std::uint16_t kBufferGroup = 0;
+
+        double now_seconds()
+        {
+            return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+        // prefix followed by value in decimal, written into buffer
+        std::string_view format_id(char *buffer, std::size_t size, std::string_view prefix, std::uint64_t value)
+        {
+            std::memcpy(buffer, prefix.data(), prefix.size());
+            char *end = std::to_chars(buffer + prefix.size(), buffer + size, value).ptr;
+            return std::string_view(buffer, static_cast<std::size_t>(end - buffer));
+        }
+
+        // A binary client_order_id as the ClOrdId its order rests under: the
+        // id in decimal, at most 20 digits, so it always fits. Ownership is
+        // keyed by OwnedKey{session.id, ...}, which keeps equal ids from
+        // different sessions apart.
+        ClOrdId binary_cl_ord_id(std::uint64_t client_order_id)
+        {
+            char buffer[24];
+            return ClOrdId(format_id(buffer, sizeof(buffer), "", client_order_id));
+        }
+
+        // A fixed-width binary field without its trailing space or NUL padding
+        std::string_view padded_view(const char *field, std::size_t size)
+        {
+            while (size > 0 && (field[size - 1] == ' ' || field[size - 1] == '\0'))
+                --size;
+            return std::string_view(field, size);
+        }
+
+        void append_field(std::string &out, std::string_view tag, std::string_view value)
+        {
+            out.append(tag);
+            out.append(value);
+            out.push_back(kFixSoh);
+        }
+
+        // Bytes up to the end of the BodyLength field and the length it gives.
+        // Returns 0 if more bytes are needed, -1 if the start is not a FIX header.
+        int frame_header(const char *data, std::size_t size, std::size_t &header_size, std::size_t &body_length)
+        {
+            std::size_t limit = size < kMaxHeader ? size : kMaxHeader;
+            if (limit >= 1 && data[0] != '8')
+                return -1;
+            if (limit >= 2 && data[1] != '=')
+                return -1;
+
+            const char *soh = static_cast<const char *>(std::memchr(data, kFixSoh, limit));
+            if (!soh)
+                return size < kMaxHeader ? 0 : -1;
+
+            std::size_t i = static_cast<std::size_t>(soh - data) + 1;
+            if (i + 2 > limit)
+                return size < kMaxHeader ? 0 : -1;
+            if (data[i] != '9' || data[i + 1] != '=')
+                return -1;
+
+            body_length = 0;
+            std::size_t digits = 0;
+            for (i += 2; i < limit && data[i] != kFixSoh; ++i, ++digits)
+            {
+                if (data[i] < '0' || data[i] > '9' || digits == 9)
+                    return -1;
+                body_length = body_length * 10 + static_cast<std::size_t>(data[i] - '0');
+            }
+            if (i == limit)
+                return size < kMaxHeader ? 0 : -1;
+            if (digits == 0)
+                return -1;
+            header_size = i + 1;
+            return 1;
+        }
+    }
+
+    struct FixGateway::Session
+    {
+        int fd;
+        std::uint64_t id;
+        std::unique_ptr<char[]> buffer;
+        std::size_t capacity;
+        std::size_t begin = 0; // Start of the first unprocessed byte
+        std::size_t end = 0;   // End of the received bytes
+        std::string out;       // Messages queued in this pass
+        std::size_t out_sent = 0;
+        std::unique_ptr<FixEncoder> encoder; // Created by Logon, addressed to the peer's comp id
+        bool binary;          // Speaks the binary protocol rather than FIX
+        bool logged_on = false;
+        bool closing = false; // Close once the queued output is written
+        bool queued = false;  // In pending_ for this pass
+
+        // io_uring only: the kernel reads sending until its send completes
+        std::string sending;
+        std::size_t send_offset = 0;
+        unsigned inflight = 0; // Submitted receives and sends not yet finished
+        bool send_busy = false;
+        bool shut = false;     // Shut down; waiting for inflight to reach zero
+
+        Session(int socket_fd, std::uint64_t session_id, std::size_t buffer_size, bool binary_protocol)
+            : fd(socket_fd), id(session_id), buffer(new char[buffer_size]), capacity(buffer_size),
+              binary(binary_protocol) {}
+    };
+
+    FixGateway::FixGateway(MatchingEngine &engine, GatewayConfig config)
+        : engine_(engine), config_(std::move(config)), next_session_id_(kFirstSessionId)
+    {
+        if (config_.recv_buffer < 256)
+            config_.recv_buffer = 256;
+        body_.reserve(256);
+    }
+
+    FixGateway::~FixGateway()
+    {
+        stop();
+    }
+
+    bool FixGateway::listen_on(int fd, const std::string &host, int port, int &bound_port)
+    {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<std::uint16_t>(port));
+        int reuse = 1;
+        if (fd < 0 || inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1 ||
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+            bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0)
+            return false;
+
+        socklen_t length = sizeof(address);
+        getsockname(fd, reinterpret_cast<sockaddr *>(&address), &length);
+        bound_port = ntohs(address.sin_port);
+        return true;
+    }
+
+    bool FixGateway::start(const std::string &host, int port, int binary_port)
+    {
+        if (running() || thread_.joinable() || engine_.sharded())
+            return false;
+
+        bool uring = config_.backend == GatewayBackend::IoUring;
+        listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (binary_port >= 0)
+            binary_listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (!uring)
+            epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (wake_fd_ < 0 || (!uring && epoll_fd_ < 0) || !listen_on(listen_fd_, host, port, port_) ||
+            (binary_port >= 0 && !listen_on(binary_listen_fd_, host, binary_port, binary_port_)))
+        {
+            close_fds();
+            return false;
+        }
+
+        if (uring)
+        {
+#ifdef CRUCIBLE_HAS_IO_URING
+            ring_ = std::make_unique<IoUring>();
+            if (!ring_->init(kRingEntries) || !ring_->init_buffers(kRecvBuffers, kRecvBufferSize, kBufferGroup))
+            {
+                ring_.reset();
+                close_fds();
+                return false;
+            }
+#else
+            close_fds();
+            return false;
+#endif
+        }
+        else
+        {
+            epoll_event event{};
+            event.events = EPOLLIN | EPOLLET;
+            event.data.u64 = kListenId;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event);
+            if (binary_listen_fd_ >= 0)
+            {
+                event.data.u64 = kBinaryListenId;
+                epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, binary_listen_fd_, &event);
+            }
+            event.events = EPOLLIN;
+            event.data.u64 = kWakeId;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+        }
+
+        books_.clear();
+        for (const std::string &symbol : config_.symbols)
+            books_.emplace_back(symbol, engine_.get_or_create_book(symbol));
+
+        running_.store(true, std::memory_order_release);
+        thread_ = std::thread(&FixGateway::run, this);
+        return true;
+    }
+
+    void FixGateway::stop()
+    {
+        if (!thread_.joinable())
+            return;
+        std::uint64_t one = 1;
+        ssize_t written = write(wake_fd_, &one, sizeof(one));
+        (void)written;
+        thread_.join();
+
+        for (auto &entry : sessions_)
+            close(entry.second->fd);
+        sessions_.clear();
+        resting_.clear();
+        owned_.clear();
+        pending_.clear();
+        session_count_.store(0, std::memory_order_relaxed);
+#ifdef CRUCIBLE_HAS_IO_URING
+        ring_.reset();
+#endif
+        close_fds();
+        port_ = binary_port_ = 0;
+    }
+
+    void FixGateway::close_fds()
+    {
+        for (int *fd : {&listen_fd_, &binary_listen_fd_, &epoll_fd_, &wake_fd_})
+        {
+            if (*fd >= 0)
+                close(*fd);
+            *fd = -1;
+        }
+    }
+
+    GatewayStats FixGateway::stats() const
+    {
+        GatewayStats stats;
+        stats.sessions = stat_sessions_.load(std::memory_order_relaxed);
+        stats.messages = stat_messages_.load(std::memory_order_relaxed);
+        stats.orders = stat_orders_.load(std::memory_order_relaxed);
+        stats.rejects = stat_rejects_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    void FixGateway::run()
+    {
+#ifdef CRUCIBLE_HAS_IO_URING
+        if (ring_)
+            run_uring();
+        else
+#endif
+            run_epoll();
+        running_.store(false, std::memory_order_release);
+    }
+
+    void FixGateway::run_epoll()
+    {
+        epoll_event events[kMaxEvents];
+        while (running_.load(std::memory_order_acquire))
+        {
+            int ready = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+            if (ready < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+
+            for (int i = 0; i < ready; ++i)
+            {
+                std::uint64_t id = events[i].data.u64;
+                if (id == kListenId || id == kBinaryListenId)
+                {
+                    accept_sessions(id == kListenId ? listen_fd_ : binary_listen_fd_, id == kBinaryListenId);
+                    continue;
+                }
+                if (id == kWakeId)
+                {
+                    running_.store(false, std::memory_order_release);
+                    continue;
+                }
+
+                auto it = sessions_.find(id);
+                if (it == sessions_.end())
+                    continue;
+                Session &session = *it->second;
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                    read_session(session);
+                if (events[i].events & EPOLLOUT)
+                    queue_output(session);
+            }
+
+            // Reports to every session, including the resting side of fills, leave in one write each
+            for (Session *session : pending_)
+            {
+                session->queued = false;
+                flush(*session);
+                if (session->closing && session->out.empty())
+                    close_session(*session);
+            }
+            pending_.clear();
+        }
+    }
+
+    FixGateway::Session &FixGateway::add_session(int fd, bool binary)
+    {
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        std::uint64_t id = next_session_id_++;
+        Session &session = *sessions_.emplace(id, std::make_unique<Session>(fd, id, config_.recv_buffer, binary)).first->second;
+        session_count_.fetch_add(1, std::memory_order_relaxed);
+        stat_sessions_.fetch_add(1, std::memory_order_relaxed);
+        return session;
+    }
+
+    void FixGateway::accept_sessions(int listen_fd, bool binary)
+    {
+        for (;;)
+        {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                return; // EAGAIN, or out of descriptors until a session closes
+            }
+
+            epoll_event event{};
+            event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            event.data.u64 = next_session_id_; // The id add_session assigns
+            if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0)
+            {
+                close(fd);
+                continue;
+            }
+            add_session(fd, binary);
+        }
+    }
+
+    void FixGateway::read_session(Session &session)
+    {
+        // Edge triggered: read until the socket is empty
+        while (!session.closing)
+        {
+            if (session.end == session.capacity)
+            {
+                if (session.begin == 0)
+                {
+                    session.closing = true; // One message larger than the buffer
+                    break;
+                }
+                std::memmove(session.buffer.get(), session.buffer.get() + session.begin, session.end - session.begin);
+                session.end -= session.begin;
+                session.begin = 0;
+            }
+
+            ssize_t received = recv(session.fd, session.buffer.get() + session.end, session.capacity - session.end, 0);
+            if (received == 0)
+            {
+                session.closing = true;
+                break;
+            }
+            if (received < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                {
+                    session.closing = true;
+                    session.out.clear();
+                }
+                break;
+            }
+            session.end += static_cast<std::size_t>(received);
+
+            session.begin += frame_messages(session, session.buffer.get() + session.begin, session.end - session.begin);
+            if (session.begin == session.end)
+                session.begin = session.end = 0;
+        }
+        if (session.closing)
+            queue_output(session);
+    }
+
+    std::size_t FixGateway::frame_messages(Session &session, const char *data, std::size_t size)
+    {
+        // Handles every complete message where it lies; returns the bytes they took
+        if (session.binary)
+            return frame_binary(session, data, size);
+        std::size_t used = 0;
+        while (!session.closing)
+        {
+            std::size_t header_size = 0, body_length = 0;
+            int header = frame_header(data + used, size - used, header_size, body_length);
+            if (header < 0)
+            {
+                session.closing = true; // Garbled stream; FIX gives no way to resynchronize
+                break;
+            }
+            std::size_t total = header_size + body_length + kTrailerSize;
+            if (header == 0 || total > size - used)
+            {
+                if (header != 0 && total > session.capacity)
+                    session.closing = true;
+                break;
+            }
+            handle_message(session, std::string_view(data + used, total));
+            used += total;
+        }
+        return used;
+    }
+
+    void FixGateway::receive(Session &session, const char *data, std::size_t size)
+    {
+        if (session.begin == session.end)
+        {
+            // Nothing buffered: frame straight from data and keep only a partial tail
+            std::size_t used = frame_messages(session, data, size);
+            data += used;
+            size -= used;
+            session.begin = session.end = 0;
+            if (size == 0 || session.closing)
+                return;
+        }
+        else if (session.end + size > session.capacity)
+        {
+            std::memmove(session.buffer.get(), session.buffer.get() + session.begin, session.end - session.begin);
+            session.end -= session.begin;
+            session.begin = 0;
+        }
+
+        if (session.end + size > session.capacity)
+        {
+            session.closing = true; // One message larger than the buffer
+            return;
+        }
+        std::memcpy(session.buffer.get() + session.end, data, size);
+        session.end += size;
+        session.begin += frame_messages(session, session.buffer.get() + session.begin, session.end - session.begin);
+        if (session.begin == session.end)
+            session.begin = session.end = 0;
+    }
+
+    void FixGateway::queue_output(Session &session)
+    {
+        if (!session.queued)
+        {
+            session.queued = true;
+            pending_.push_back(&session);
+        }
+    }
+
+    void FixGateway::flush(Session &session)
+    {
+        while (session.out_sent < session.out.size())
+        {
+            ssize_t sent = send(session.fd, session.out.data() + session.out_sent,
+                                session.out.size() - session.out_sent, MSG_NOSIGNAL);
+            if (sent > 0)
+            {
+                session.out_sent += static_cast<std::size_t>(sent);
+                continue;
+            }
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return; // EPOLLOUT queues the session again
+            session.closing = true;
+            break;
+        }
+        session.out.clear();
+        session.out_sent = 0;
+    }
+
+    void FixGateway::close_session(Session &session)
+    {
+        close(session.fd); // Also leaves the epoll set
+        session_count_.fetch_sub(1, std::memory_order_relaxed);
+        sessions_.erase(session.id); // Resting orders stay in the book; their fills go unreported
+    }
+
+#ifdef CRUCIBLE_HAS_IO_URING
+    void FixGateway::run_uring()
+    {
+        IoUring &ring = *ring_;
+        arm_accept(listen_fd_, kListenId);
+        if (binary_listen_fd_ >= 0)
+            arm_accept(binary_listen_fd_, kBinaryListenId);
+        io_uring_sqe *wake = ring.get_sqe();
+        wake->opcode = IORING_OP_POLL_ADD;
+        wake->fd = wake_fd_;
+        wake->poll32_events = POLLIN;
+        wake->user_data = kWakeId;
+
+        while (running_.load(std::memory_order_acquire))
+        {
+            // Submits the previous pass's receives and sends in one call, then waits
+            if (ring.submit(true) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                break;
+            ring.for_each_completion([this](const io_uring_cqe &cqe) { complete(cqe); });
+
+            for (Session *session : pending_)
+            {
+                session->queued = false;
+                start_send(*session);
+            }
+            pending_.clear();
+        }
+
+        // Shutting the sockets down completes their receives; wait for those and any sends
+        shutdown(listen_fd_, SHUT_RDWR);
+        if (binary_listen_fd_ >= 0)
+            shutdown(binary_listen_fd_, SHUT_RDWR);
+        for (auto &entry : sessions_)
+        {
+            entry.second->closing = entry.second->shut = true;
+            shutdown(entry.second->fd, SHUT_RDWR);
+        }
+        auto busy = [this]()
+        {
+            for (auto &entry : sessions_)
+                if (entry.second->inflight)
+                    return true;
+            return false;
+        };
+        for (int attempt = 0; attempt < 64 && busy(); ++attempt)
+        {
+            if (ring.submit(true) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                break;
+            ring.for_each_completion([this](const io_uring_cqe &cqe) { complete(cqe); });
+        }
+        pending_.clear();
+    }
+
+    void FixGateway::arm_accept(int listen_fd, std::uint64_t id)
+    {
+        io_uring_sqe *sqe = ring_->get_sqe();
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = listen_fd;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        sqe->user_data = id;
+    }
+
+    void FixGateway::arm_recv(Session &session)
+    {
+        io_uring_sqe *sqe = ring_->get_sqe();
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = session.fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = ring_->buffer_group();
+        sqe->user_data = (kRecvOp << kOpShift) | session.id;
+        ++session.inflight;
+    }
+
+    void FixGateway::start_send(Session &session)
+    {
+        if (session.send_busy)
+            return; // Its completion submits the rest
+        if (session.sending.empty() && !session.out.empty())
+        {
+            session.sending.swap(session.out);
+            session.send_offset = 0;
+        }
+
+        if (!session.sending.empty())
+        {
+            io_uring_sqe *sqe = ring_->get_sqe();
+            sqe->opcode = IORING_OP_SEND;
+            sqe->fd = session.fd;
+            sqe->addr = reinterpret_cast<std::uint64_t>(session.sending.data() + session.send_offset);
+            sqe->len = static_cast<std::uint32_t>(session.sending.size() - session.send_offset);
+            sqe->msg_flags = MSG_NOSIGNAL;
+            sqe->user_data = (kSendOp << kOpShift) | session.id;
+            session.send_busy = true;
+            ++session.inflight;
+            return;
+        }
+
+        if (session.closing)
+        {
+            if (!session.shut)
+            {
+                session.shut = true;
+                shutdown(session.fd, SHUT_RDWR); // Ends the multishot receive
+            }
+            if (session.inflight == 0)
+                close_session(session);
+        }
+    }
+
+    void FixGateway::complete(const io_uring_cqe &cqe)
+    {
+        std::uint64_t op = cqe.user_data >> kOpShift;
+        std::uint64_t id = cqe.user_data & ((std::uint64_t(1) << kOpShift) - 1);
+        bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+
+        if (id == kListenId || id == kBinaryListenId)
+        {
+            if (cqe.res >= 0)
+            {
+                Session &session = add_session(cqe.res, id == kBinaryListenId);
+                arm_recv(session);
+            }
+            if (!more && running_.load(std::memory_order_acquire))
+                arm_accept(id == kListenId ? listen_fd_ : binary_listen_fd_, id);
+            return;
+        }
+        if (id == kWakeId)
+        {
+            running_.store(false, std::memory_order_release);
+            return;
+        }
+
+        auto it = sessions_.find(id);
+        if (it == sessions_.end())
+        {
+            if (cqe.flags & IORING_CQE_F_BUFFER)
+                ring_->recycle_buffer(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            return;
+        }
+        Session &session = *it->second;
+
+        if (op == kRecvOp)
+        {
+            if (cqe.flags & IORING_CQE_F_BUFFER)
+            {
+                unsigned buffer_id = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+                if (cqe.res > 0 && !session.closing)
+                    receive(session, ring_->buffer(buffer_id), static_cast<std::size_t>(cqe.res));
+                ring_->recycle_buffer(buffer_id);
+            }
+            else if (cqe.res != -ENOBUFS)
+                session.closing = true; // End of stream or a socket error
+
+            if (!more)
+            {
+                --session.inflight;
+                if (!session.closing && !session.shut)
+                    arm_recv(session); // Out of buffers, or the kernel ended the multishot
+            }
+        }
+        else if (op == kSendOp)
+        {
+            --session.inflight;
+            session.send_busy = false;
+            if (cqe.res < 0)
+            {
+                session.closing = true;
+                session.sending.clear();
+                session.out.clear();
+            }
+            else
+            {
+                session.send_offset += static_cast<std::size_t>(cqe.res);
+                if (session.send_offset == session.sending.size())
+                {
+                    session.sending.clear();
+                    session.send_offset = 0;
+                }
+            }
+        }
+
+        if (session.closing || !session.sending.empty() || !session.out.empty())
+            queue_output(session);
+    }
+#endif
+
+    void FixGateway::send_message(Session &session, std::string_view msg_type)
+    {
+        session.encoder->append_message(msg_type, body_, session.out);
+        queue_output(session);
+    }
+
+    void FixGateway::handle_message(Session &session, std::string_view raw)
+    {
+        stat_messages_.fetch_add(1, std::memory_order_relaxed);
+
+        FixValidation validation = validate_fix(raw);
+        bool parsed = validation.status == FixCheck::Ok && message_.parse(raw);
+        if (!session.logged_on)
+        {
+            // The first message must be a valid Logon
+            if (parsed && message_.get(35) == "A")
+                handle_logon(session);
+            else
+                session.closing = true;
+            return;
+        }
+        if (!parsed)
+        {
+            stat_rejects_.fetch_add(1, std::memory_order_relaxed);
+            body_.clear();
+            append_field(body_, "58=", validation.status == FixCheck::Ok ? "Malformed message"
+                                                                         : fix_check_text(validation.status));
+            send_message(session, "3");
+            return;
+        }
+
+        std::string_view msg_type = message_.get(35);
+        if (msg_type == "D")
+            handle_new_order(session);
+        else if (msg_type == "F")
+            handle_cancel(session);
+        else if (msg_type == "0" || msg_type == "1")
+        {
+            // Heartbeat, or the reply a Test Request asks for; either echoes TestReqID
+            body_.clear();
+            if (message_.has(112))
+                append_field(body_, "112=", message_.get(112));
+            send_message(session, "0");
+        }
+        else if (msg_type == "5")
+        {
+            body_.clear();
+            send_message(session, "5");
+            session.closing = true;
+        }
+        else if (msg_type == "A")
+            handle_logon(session);
+        // Other message types are ignored, as the Python server does
+    }
+
+    bool FixGateway::admit(const std::string &sender_comp_id, const std::string &target_comp_id)
+    {
+        if (!config_.logon)
+            return true;
+        try
+        {
+            return config_.logon(sender_comp_id, target_comp_id);
+        }
+        catch (...)
+        {
+            return false; // A failing policy refuses rather than ending the event loop
+        }
+    }
+
+    void FixGateway::handle_logon(Session &session)
+    {
+        std::string sender(message_.get(49));
+        bool accepted = admit(sender, std::string(message_.get(56)));
+
+        if (!session.encoder)
+            session.encoder = std::make_unique<FixEncoder>(config_.comp_id, sender, config_.price_decimals);
+        body_.clear();
+        if (!accepted)
+        {
+            append_field(body_, "58=", "Logon refused");
+            send_message(session, "5");
+            session.closing = true;
+            return;
+        }
+        session.logged_on = true;
+        std::string_view interval = message_.get(108);
+        append_field(body_, "108=", interval.empty() ? std::string_view("30") : interval);
+        send_message(session, "A");
+    }
+
+    const FixGateway::BookEntry *FixGateway::find_book(std::string_view symbol) const
+    {
+        for (const BookEntry &book : books_)
+        {
+            if (book.first == symbol)
+                return &book;
+        }
+        return nullptr;
+    }
+
+    std::shared_ptr<Order> FixGateway::find_owned(const Session &session, const BookEntry &book,
+                                                  const ClOrdId &cl_ord_id) const
+    {
+        auto owned = owned_.find(OwnedKey{session.id, cl_ord_id});
+        if (owned == owned_.end())
+            return nullptr;
+        const std::shared_ptr<Order> &order = resting_.at(owned->second).order;
+        return order->symbol_id == book.second->symbol_id() ? order : nullptr;
+    }
+
+    std::shared_ptr<Order> FixGateway::cancel_owned(const Session &session, const BookEntry &book,
+                                                    const ClOrdId &cl_ord_id)
+    {
+        auto order = find_owned(session, book, cl_ord_id);
+        if (!order)
+            return nullptr;
+        auto canceled = book.second->cancel_order(order->order_id);
+        forget_resting(resting_.find(order->order_id));
+        return canceled;
+    }
+
+    void FixGateway::forget_resting(std::unordered_map<OrderId, RestingOrder>::iterator resting)
+    {
+        owned_.erase(OwnedKey{resting->second.session_id, resting->second.order->cl_ord_id});
+        resting_.erase(resting);
+    }
+
+    bool FixGateway::submit(Session &session, std::shared_ptr<Order> order, const BookEntry &book)
+    {
+        // A ClOrdId stays taken while its order rests
+        if (owned_.count(OwnedKey{session.id, order->cl_ord_id}))
+            return false;
+
+        matches_.clear();
+        SubmitResult result = book.second->submit_order(order, matches_);
+        if (!result.accepted)
+            return false;
+        stat_orders_.fetch_add(1, std::memory_order_relaxed);
+
+        send_report(session, *order, book.first, '0', '0', 0, 0.0, 0);
+        int cum_qty = 0;
+        for (const Match &match : matches_)
+        {
+            cum_qty += match.qty;
+            char status = cum_qty >= order->order_qty ? '2' : '1';
+            send_report(session, *order, book.first, status, status, match.qty, match.price, cum_qty);
+            report_resting_fill(match.buy_order_id == order->order_id ? match.sell_order_id : match.buy_order_id,
+                                book.first, match);
+        }
+        if (result.resting)
+        {
+            resting_[order->order_id] = RestingOrder{order, session.id};
+            owned_[OwnedKey{session.id, order->cl_ord_id}] = order->order_id;
+        }
+        return true;
+    }
+
+    void FixGateway::report_resting_fill(OrderId order_id, const std::string &symbol, const Match &match)
+    {
+        auto resting = resting_.find(order_id);
+        if (resting == resting_.end())
+            return; // Entered by someone other than the gateway
+        const Order &order = *resting->second.order;
+        char status = order.filled_qty >= order.order_qty ? '2' : '1';
+        auto owner = sessions_.find(resting->second.session_id);
+        if (owner != sessions_.end() && !owner->second->closing)
+            send_report(*owner->second, order, symbol, status, status, match.qty, match.price, order.filled_qty);
+        if (status == '2')
+            forget_resting(resting);
+    }
+
+    void FixGateway::handle_new_order(Session &session)
+    {
+        auto order = std::make_shared<Order>(engine_.next_order_id(), ClOrdId(), '1', 0, '2', 0.0, now_seconds());
+        std::string_view symbol;
+        int tag = 0;
+        FixError error = decode_new_order(message_, *order, symbol, tag);
+        if (error != FixError::None)
+        {
+            std::string text = fix_error_text(error);
+            text += " in tag ";
+            text += std::to_string(tag);
+            std::string_view side = message_.get(54);
+            int qty = 0;
+            parse_fix_int(message_.get(38), qty);
+            send_reject(session, message_.get(11), message_.get(55), side.size() == 1 ? side[0] : '0', qty, text);
+            return;
+        }
+
+        const BookEntry *book = find_book(symbol);
+        if (!book)
+        {
+            send_reject(session, order->cl_ord_id.view(), symbol, order->side, order->order_qty,
+                        "Invalid symbol: " + std::string(symbol));
+            return;
+        }
+        if (!submit(session, order, *book))
+            send_reject(session, order->cl_ord_id.view(), symbol, order->side, order->order_qty, "Duplicate order");
+    }
+
+    void FixGateway::handle_cancel(Session &session)
+    {
+        std::string_view orig_cl_ord_id = message_.get(41);
+        const BookEntry *book = find_book(message_.get(55));
+
+        std::shared_ptr<Order> canceled;
+        ClOrdId cl_ord_id;
+        if (book && cl_ord_id.assign(orig_cl_ord_id))
+            canceled = cancel_owned(session, *book, cl_ord_id);
+
+        if (!canceled)
+        {
+            stat_rejects_.fetch_add(1, std::memory_order_relaxed);
+            body_.clear();
+            append_field(body_, "11=", message_.get(11));
+            append_field(body_, "41=", orig_cl_ord_id);
+            append_field(body_, "39=", "8");
+            append_field(body_, "58=", "Order not found");
+            send_message(session, "8");
+            return;
+        }
+        send_report(session, *canceled, book->first, '4', '4', 0, 0.0, canceled->filled_qty);
+    }
+
+    void FixGateway::send_report(Session &session, const Order &order, std::string_view symbol, char exec_type,
+                                 char ord_status, int last_qty, double last_px, int cum_qty)
+    {
+        if (session.binary)
+        {
+            send_binary_report(session, order, exec_type, last_qty, last_px, cum_qty);
+            return;
+        }
+
+        char order_id[24], exec_id[32];
+        ExecReport report;
+        report.order_id = format_id(order_id, sizeof(order_id), "", order.order_id);
+        report.cl_ord_id = order.cl_ord_id.view();
+        report.exec_id = format_id(exec_id, sizeof(exec_id), "EXEC", next_exec_id_++);
+        report.symbol = symbol;
+        report.exec_type = exec_type;
+        report.ord_status = ord_status;
+        report.side = order.side;
+        report.order_qty = order.order_qty;
+        report.last_qty = last_qty;
+        report.cum_qty = cum_qty;
+        report.last_px = last_px;
+        report.avg_px = last_px;
+        session.encoder->append_execution_report(report, session.out);
+        queue_output(session);
+    }
+
+    void FixGateway::send_reject(Session &session, std::string_view cl_ord_id, std::string_view symbol, char side,
+                                 int order_qty, std::string_view text)
+    {
+        stat_rejects_.fetch_add(1, std::memory_order_relaxed);
+        char exec_id[32];
+        ExecReport report{};
+        report.order_id = "NONE";
+        report.cl_ord_id = cl_ord_id;
+        report.exec_id = format_id(exec_id, sizeof(exec_id), "EXEC", next_exec_id_++);
+        report.symbol = symbol;
+        report.text = text;
+        report.exec_type = '8';
+        report.ord_status = '8';
+        report.side = side;
+        report.order_qty = order_qty;
+        session.encoder->append_execution_report(report, session.out);
+        queue_output(session);
+    }
+
+    std::size_t FixGateway::frame_binary(Session &session, const char *data, std::size_t size)
+    {
+        std::size_t used = 0;
+        while (!session.closing && size - used >= sizeof(BinaryHeader))
+        {
+            BinaryHeader header;
+            std::memcpy(&header, data + used, sizeof(header));
+            std::size_t expected = binary_inbound_size(header.type);
+            if (expected == 0 || header.length != expected || header.version != kBinaryVersion)
+            {
+                session.closing = true; // Unknown or mis-sized message; the stream cannot be resynchronized
+                break;
+            }
+            if (size - used < expected)
+                break;
+            handle_binary(session, data + used);
+            used += expected;
+        }
+        return used;
+    }
+
+    void FixGateway::handle_binary(Session &session, const char *message)
+    {
+        stat_messages_.fetch_add(1, std::memory_order_relaxed);
+        BinaryType type = reinterpret_cast<const BinaryHeader *>(message)->type;
+
+        if (!session.logged_on)
+        {
+            if (type != BinaryType::Logon)
+            {
+                session.closing = true;
+                return;
+            }
+            const auto &logon = *reinterpret_cast<const BinaryLogon *>(message);
+            BinaryLogonReply reply{};
+            reply.accepted = admit(std::string(padded_view(logon.comp_id, sizeof(logon.comp_id))), config_.comp_id);
+            append_binary(session, BinaryType::LogonReply, reply);
+            session.logged_on = reply.accepted != 0;
+            session.closing = !session.logged_on;
+            return;
+        }
+
+        switch (type)
+        {
+        case BinaryType::NewOrder:
+            binary_new_order(session, *reinterpret_cast<const BinaryNewOrder *>(message));
+            break;
+        case BinaryType::Cancel:
+            binary_cancel(session, *reinterpret_cast<const BinaryCancel *>(message));
+            break;
+        case BinaryType::Replace:
+            binary_replace(session, *reinterpret_cast<const BinaryReplace *>(message));
+            break;
+        case BinaryType::Logout:
+            session.closing = true;
+            break;
+        default:
+            break; // A repeated Logon
+        }
+    }
+
+    void FixGateway::binary_new_order(Session &session, const BinaryNewOrder &message)
+    {
+        bool limit = message.order_type == '2';
+        if ((message.side != '1' && message.side != '2') || (!limit && message.order_type != '1') ||
+            message.qty == 0 || message.qty > static_cast<std::uint32_t>(INT32_MAX) || (limit && message.price <= 0))
+        {
+            send_binary_reject(session, BinaryType::NewOrder, BinaryRejectReason::BadValue, message.client_order_id);
+            return;
+        }
+        const BookEntry *book = find_book(padded_view(message.symbol, sizeof(message.symbol)));
+        if (!book)
+        {
+            send_binary_reject(session, BinaryType::NewOrder, BinaryRejectReason::UnknownSymbol,
+                               message.client_order_id);
+            return;
+        }
+
+        double price = limit ? static_cast<double>(message.price) / kBinaryPriceScale : 0.0;
+        auto order = std::make_shared<Order>(engine_.next_order_id(), binary_cl_ord_id(message.client_order_id),
+                                             message.side, static_cast<int>(message.qty), message.order_type, price,
+                                             now_seconds());
+        if (!submit(session, order, *book))
+            send_binary_reject(session, BinaryType::NewOrder, BinaryRejectReason::DuplicateOrder,
+                               message.client_order_id);
+    }
+
+    void FixGateway::binary_cancel(Session &session, const BinaryCancel &message)
+    {
+        const BookEntry *book = find_book(padded_view(message.symbol, sizeof(message.symbol)));
+        auto canceled = book ? cancel_owned(session, *book, binary_cl_ord_id(message.client_order_id)) : nullptr;
+        if (!canceled)
+        {
+            send_binary_reject(session, BinaryType::Cancel, BinaryRejectReason::NotFound, message.client_order_id);
+            return;
+        }
+        send_report(session, *canceled, book->first, '4', '4', 0, 0.0, canceled->filled_qty);
+    }
+
+    void FixGateway::binary_replace(Session &session, const BinaryReplace &message)
+    {
+        const BookEntry *book = find_book(padded_view(message.symbol, sizeof(message.symbol)));
+        auto order = book ? find_owned(session, *book, binary_cl_ord_id(message.client_order_id)) : nullptr;
+        if (!order)
+        {
+            send_binary_reject(session, BinaryType::Replace, BinaryRejectReason::NotFound, message.client_order_id);
+            return;
+        }
+        double price = message.price > 0 ? static_cast<double>(message.price) / kBinaryPriceScale : 0.0;
+        matches_.clear();
+        auto replaced = message.qty <= static_cast<std::uint32_t>(INT32_MAX) && message.price >= 0
+                            ? book->second->replace_order(order->order_id, static_cast<int>(message.qty), price,
+                                                          matches_)
+                            : nullptr;
+        if (!replaced)
+        {
+            send_binary_reject(session, BinaryType::Replace, BinaryRejectReason::BadValue, message.client_order_id);
+            return;
+        }
+
+        // A requeued order that crosses trades at once; report the replace as of before its fills
+        int cum_qty = replaced->filled_qty;
+        for (const Match &match : matches_)
+            cum_qty -= match.qty;
+        send_report(session, *replaced, book->first, '5', '5', 0, 0.0, cum_qty);
+        for (const Match &match : matches_)
+        {
+            cum_qty += match.qty;
+            char status = cum_qty >= replaced->order_qty ? '2' : '1';
+            send_report(session, *replaced, book->first, status, status, match.qty, match.price, cum_qty);
+            report_resting_fill(match.buy_order_id == replaced->order_id ? match.sell_order_id : match.buy_order_id,
+                                book->first, match);
+        }
+        if (replaced->is_complete())
+            forget_resting(resting_.find(replaced->order_id));
+    }
+
+    template <typename Message>
+    void FixGateway::append_binary(Session &session, BinaryType type, Message &message)
+    {
+        message.header.length = static_cast<std::uint16_t>(sizeof(Message));
+        message.header.type = type;
+        message.header.version = kBinaryVersion;
+        session.out.append(reinterpret_cast<const char *>(&message), sizeof(Message));
+        queue_output(session);
+    }
+
+    void FixGateway::send_binary_report(Session &session, const Order &order, char exec_type, int last_qty,
+                                        double last_px, int cum_qty)
+    {
+        // Binary sessions only hold orders they entered, whose client ids are decimal
+        std::uint64_t client_order_id = 0;
+        std::string_view id = order.cl_ord_id.view();
+        std::from_chars(id.data(), id.data() + id.size(), client_order_id);
+
+        if (exec_type == '1' || exec_type == '2')
+        {
+            BinaryFill fill{};
+            fill.side = order.side;
+            fill.leaves_qty = static_cast<std::uint32_t>(order.order_qty - cum_qty);
+            fill.client_order_id = client_order_id;
+            fill.order_id = order.order_id;
+            fill.exec_id = next_exec_id_++;
+            fill.price = std::llround(last_px * kBinaryPriceScale);
+            fill.qty = static_cast<std::uint32_t>(last_qty);
+            fill.filled_qty = static_cast<std::uint32_t>(cum_qty);
+            append_binary(session, BinaryType::Fill, fill);
+            return;
+        }
+
+        BinaryAck ack{};
+        ack.state = exec_type == '4' ? BinaryAckState::Canceled
+                    : exec_type == '5' ? BinaryAckState::Replaced
+                                       : BinaryAckState::New;
+        ack.side = order.side;
+        ack.client_order_id = client_order_id;
+        ack.order_id = order.order_id;
+        ack.price = std::llround(order.price * kBinaryPriceScale);
+        ack.qty = static_cast<std::uint32_t>(order.order_qty);
+        ack.filled_qty = static_cast<std::uint32_t>(cum_qty);
+        append_binary(session, BinaryType::Ack, ack);
+    }
+
+    void FixGateway::send_binary_reject(Session &session, BinaryType ref_type, BinaryRejectReason reason,
+                                        std::uint64_t client_order_id)
+    {
+        stat_rejects_.fetch_add(1, std::memory_order_relaxed);
+        BinaryReject reject{};
+        reject.ref_type = ref_type;
+        reject.reason = reason;
+        reject.client_order_id = client_order_id;
+        append_binary(session, BinaryType::Reject, reject);
+    }
+
+} // namespace crucible
+
+#endif // __linux__
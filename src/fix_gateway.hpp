@@ -0,0 +1,201 @@
+#pragma once
+
+#ifdef __linux__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "binary_protocol.hpp"
+#include "fix_encoder.hpp"
+#include "fix_parser.hpp"
+#include "io_uring.hpp"
+#include "matching_engine.hpp"
+
+namespace crucible
+{
+
+    // Admission policy for a Logon, given its SenderCompID and TargetCompID;
+    // returning false refuses the session
+    using LogonPolicy = std::function<bool(const std::string &sender_comp_id, const std::string &target_comp_id)>;
+
+    enum class GatewayBackend : std::uint8_t
+    {
+        Epoll,   // Edge-triggered readiness, one recv and one send call per socket and pass
+        IoUring, // Multishot accept and recv into registered buffers, sends batched per pass
+    };
+
+    struct GatewayConfig
+    {
+        std::vector<std::string> symbols;   // Tradable symbols; their books are created on start
+        std::string comp_id = "EXCHANGE";   // SenderCompID of outbound messages
+        std::size_t recv_buffer = 65536;    // Per session; a longer message closes the session
+        int price_decimals = 2;
+        GatewayBackend backend = GatewayBackend::Epoll;
+        LogonPolicy logon;                  // Every Logon is accepted if empty
+    };
+
+    struct GatewayStats
+    {
+        std::uint64_t sessions = 0; // Connections accepted since start
+        std::uint64_t messages = 0; // Framed inbound messages
+        std::uint64_t orders = 0;   // New orders accepted by a book, FIX or binary
+        std::uint64_t rejects = 0;  // Orders, cancels and messages refused
+    };
+
+    // FIX acceptor serving every session from one thread. With the epoll
+    // backend the listening socket and all connections sit in one
+    // edge-triggered epoll set and each session frames messages in place in
+    // its receive buffer (only a partial message is ever moved, back to the
+    // front). With io_uring, multishot receives land in kernel-registered
+    // buffers and messages are framed where they land, so only a partial
+    // message is copied into the session. Either way messages are checked
+    // with validate_fix and New Order Singles and cancels go straight to the
+    // symbol's book. Execution reports go to the sessions owning both sides
+    // of a fill, and each session's output leaves in one send per pass over
+    // the ready events; io_uring submits all of a pass's sends in one call.
+    //
+    // An optional second port speaks the fixed-layout binary protocol of
+    // binary_protocol.hpp through the same loop and books: its messages are
+    // length-checked and read in place, with no tag parsing or checksum.
+    //
+    // Books are called directly, so the engine must not be sharded while the
+    // gateway runs. The logon policy is the only callback and runs on the
+    // gateway thread.
+    class FixGateway
+    {
+    private:
+        struct Session;
+        using BookEntry = std::pair<std::string, std::shared_ptr<OrderBook>>;
+
+        // Owning session of a resting order, for fills against it
+        struct RestingOrder
+        {
+            std::shared_ptr<Order> order;
+            std::uint64_t session_id;
+        };
+
+        // Client order ids are only unique within a session, so cancels and
+        // replaces look orders up by both rather than through the book's index
+        struct OwnedKey
+        {
+            std::uint64_t session_id;
+            ClOrdId cl_ord_id;
+
+            bool operator==(const OwnedKey &other) const
+            {
+                return session_id == other.session_id && cl_ord_id == other.cl_ord_id;
+            }
+        };
+
+        struct OwnedKeyHash
+        {
+            std::size_t operator()(const OwnedKey &key) const
+            {
+                return FixedStringHash<ClOrdId::capacity>()(key.cl_ord_id) ^ (key.session_id * 0x9e3779b97f4a7c15ull);
+            }
+        };
+
+        MatchingEngine &engine_;
+        GatewayConfig config_;
+        std::vector<BookEntry> books_;
+        std::unordered_map<std::uint64_t, std::unique_ptr<Session>> sessions_; // By session id
+        std::unordered_map<OrderId, RestingOrder> resting_;
+        std::unordered_map<OwnedKey, OrderId, OwnedKeyHash> owned_; // Same orders as resting_
+        std::vector<Session *> pending_; // Sessions with output queued in this pass
+        std::vector<Match> matches_;
+        FixMessage message_;
+        std::string body_;
+        std::uint64_t next_session_id_;
+        std::uint64_t next_exec_id_ = 1;
+
+        int epoll_fd_ = -1;
+        int listen_fd_ = -1;
+        int binary_listen_fd_ = -1;
+        int wake_fd_ = -1;
+        int port_ = 0;
+        int binary_port_ = 0;
+        std::thread thread_;
+        std::atomic<bool> running_{false};
+        std::atomic<std::size_t> session_count_{0};
+        std::atomic<std::uint64_t> stat_sessions_{0}, stat_messages_{0}, stat_orders_{0}, stat_rejects_{0};
+#ifdef CRUCIBLE_HAS_IO_URING
+        std::unique_ptr<IoUring> ring_; // Set when running the io_uring backend
+#endif
+
+        void run();
+        void run_epoll();
+        bool listen_on(int fd, const std::string &host, int port, int &bound_port);
+        Session &add_session(int fd, bool binary);
+        void accept_sessions(int listen_fd, bool binary);
+        void read_session(Session &session);
+        void flush(Session &session);
+        void close_session(Session &session);
+        void queue_output(Session &session);
+        std::size_t frame_messages(Session &session, const char *data, std::size_t size);
+        void receive(Session &session, const char *data, std::size_t size);
+#ifdef CRUCIBLE_HAS_IO_URING
+        void run_uring();
+        void complete(const io_uring_cqe &cqe);
+        void arm_accept(int listen_fd, std::uint64_t id);
+        void arm_recv(Session &session);
+        void start_send(Session &session);
+#endif
+        void handle_message(Session &session, std::string_view raw);
+        bool admit(const std::string &sender_comp_id, const std::string &target_comp_id);
+        void handle_logon(Session &session);
+        void handle_new_order(Session &session);
+        void handle_cancel(Session &session);
+        const BookEntry *find_book(std::string_view symbol) const;
+        std::shared_ptr<Order> find_owned(const Session &session, const BookEntry &book, const ClOrdId &cl_ord_id) const;
+        std::shared_ptr<Order> cancel_owned(const Session &session, const BookEntry &book, const ClOrdId &cl_ord_id);
+        void forget_resting(std::unordered_map<OrderId, RestingOrder>::iterator resting);
+        bool submit(Session &session, std::shared_ptr<Order> order, const BookEntry &book);
+        void report_resting_fill(OrderId order_id, const std::string &symbol, const Match &match);
+        void send_report(Session &session, const Order &order, std::string_view symbol, char exec_type,
+                         char ord_status, int last_qty, double last_px, int cum_qty);
+        void send_reject(Session &session, std::string_view cl_ord_id, std::string_view symbol, char side,
+                         int order_qty, std::string_view text);
+        void send_message(Session &session, std::string_view msg_type);
+        std::size_t frame_binary(Session &session, const char *data, std::size_t size);
+        void handle_binary(Session &session, const char *message);
+        void binary_new_order(Session &session, const BinaryNewOrder &message);
+        void binary_cancel(Session &session, const BinaryCancel &message);
+        void binary_replace(Session &session, const BinaryReplace &message);
+        template <typename Message>
+        void append_binary(Session &session, BinaryType type, Message &message);
+        void send_binary_report(Session &session, const Order &order, char exec_type, int last_qty, double last_px,
+                                int cum_qty);
+        void send_binary_reject(Session &session, BinaryType ref_type, BinaryRejectReason reason,
+                                std::uint64_t client_order_id);
+        void close_fds();
+
+    public:
+        FixGateway(MatchingEngine &engine, GatewayConfig config);
+        ~FixGateway();
+        FixGateway(const FixGateway &) = delete;
+        FixGateway &operator=(const FixGateway &) = delete;
+
+        // Listens for FIX on host:port (port 0 picks a free one), and for the
+        // binary protocol on binary_port unless it is negative, then starts the
+        // event loop. Returns false if already running, the engine is sharded,
+        // a socket fails or the kernel lacks the configured backend.
+        bool start(const std::string &host, int port, int binary_port = -1);
+        // Closes every session and joins the event loop thread
+        void stop();
+
+        bool running() const { return running_.load(std::memory_order_acquire); }
+        int port() const { return port_; } // Bound port while running
+        int binary_port() const { return binary_port_; } // 0 unless a binary port is open
+        std::size_t session_count() const { return session_count_.load(std::memory_order_relaxed); }
+        GatewayStats stats() const;
+    };
+
+} // namespace crucible
+
+#endif // __linux__
@@ -0,0 +1,462 @@
+#include "fix_parser.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CRUCIBLE_FIX_SSE2 1
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CRUCIBLE_FIX_AVX2 1 // Compiled per function and picked at run time
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace crucible
+{
+
+    namespace
+    {
+        constexpr double kPow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+                                     1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18};
+
+        int lowest_bit(std::uint32_t bits)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, bits);
+            return static_cast<int>(index);
+#else
+            return __builtin_ctz(bits);
+#endif
+        }
+
+        // Bit i is set if p[i] is '=' or SOH, for the 16 bytes at p
+        std::uint32_t delimiter_mask(const char *p)
+        {
+#ifdef CRUCIBLE_FIX_SSE2
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('=')),
+                                        _mm_cmpeq_epi8(bytes, _mm_set1_epi8(kFixSoh)));
+            return static_cast<std::uint32_t>(_mm_movemask_epi8(hits));
+#else
+            std::uint32_t mask = 0;
+            for (int i = 0; i < 16; ++i)
+                mask |= std::uint32_t(p[i] == '=' || p[i] == kFixSoh) << i;
+            return mask;
+#endif
+        }
+
+        // Collects what validation needs from each field start: the leading
+        // 8/9/35 fields, where the body begins, the required header tags and
+        // where the last 10= field starts
+        struct FieldScan
+        {
+            const char *data;
+            const char *end;
+            std::size_t index = 0;
+            const char *body_start = nullptr;
+            const char *trailer = nullptr;
+            std::uint32_t seen = 0; // Bit per entry of kRequiredTags
+            bool leading_ok = true;
+
+            static constexpr int kRequiredTags[] = {49, 56, 34, 52};
+
+            void field(const char *p)
+            {
+                int tag = 0;
+                const char *q = p;
+                for (; q < end && q - p < 6 && *q >= '0' && *q <= '9'; ++q)
+                    tag = tag * 10 + (*q - '0');
+                if (q == end || *q != '=' || q == p)
+                    tag = -1;
+
+                static constexpr int kLeading[] = {8, 9, 35};
+                if (index < 3 && tag != kLeading[index])
+                    leading_ok = false;
+                if (index == 2)
+                    body_start = p;
+                for (int i = 0; i < 4; ++i)
+                    seen |= std::uint32_t(tag == kRequiredTags[i]) << i;
+                if (tag == 10)
+                    trailer = p;
+                ++index;
+            }
+        };
+
+        std::uint64_t scan_scalar(const char *p, const char *end, FieldScan &scan)
+        {
+            std::uint64_t sum = 0;
+            for (; p < end; ++p)
+            {
+                sum += static_cast<unsigned char>(*p);
+                if (*p == kFixSoh && p + 1 < end)
+                    scan.field(p + 1);
+            }
+            return sum;
+        }
+
+#ifdef CRUCIBLE_FIX_SSE2
+        std::uint64_t scan_sse2(const char *p, const char *end, FieldScan &scan)
+        {
+            __m128i zero = _mm_setzero_si128();
+            __m128i soh = _mm_set1_epi8(kFixSoh);
+            __m128i total = zero;
+            for (; end - p >= 16; p += 16)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+                total = _mm_add_epi64(total, _mm_sad_epu8(bytes, zero));
+                auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, soh)));
+                for (; mask; mask &= mask - 1)
+                {
+                    const char *next = p + lowest_bit(mask) + 1;
+                    if (next < end)
+                        scan.field(next);
+                }
+            }
+            alignas(16) std::uint64_t lanes[2];
+            _mm_store_si128(reinterpret_cast<__m128i *>(lanes), total);
+            return lanes[0] + lanes[1] + scan_scalar(p, end, scan);
+        }
+#endif
+
+#ifdef CRUCIBLE_FIX_AVX2
+        __attribute__((target("avx2"))) std::uint64_t scan_avx2(const char *p, const char *end, FieldScan &scan)
+        {
+            __m256i zero = _mm256_setzero_si256();
+            __m256i soh = _mm256_set1_epi8(kFixSoh);
+            __m256i total = zero;
+            for (; end - p >= 32; p += 32)
+            {
+                __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+                total = _mm256_add_epi64(total, _mm256_sad_epu8(bytes, zero));
+                auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, soh)));
+                for (; mask; mask &= mask - 1)
+                {
+                    const char *next = p + lowest_bit(mask) + 1;
+                    if (next < end)
+                        scan.field(next);
+                }
+            }
+            alignas(32) std::uint64_t lanes[4];
+            _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), total);
+            return lanes[0] + lanes[1] + lanes[2] + lanes[3] + scan_scalar(p, end, scan);
+        }
+
+        // Resolved on first use: a namespace-scope initializer can run before
+        // libgcc has filled in the CPU model that __builtin_cpu_supports reads
+        bool has_avx2()
+        {
+            static const bool supported = []
+            {
+                __builtin_cpu_init();
+                return __builtin_cpu_supports("avx2") != 0;
+            }();
+            return supported;
+        }
+#endif
+
+        std::uint64_t scan_fields(const char *p, const char *end, FieldScan &scan)
+        {
+#ifdef CRUCIBLE_FIX_AVX2
+            if (has_avx2())
+                return scan_avx2(p, end, scan);
+#endif
+#ifdef CRUCIBLE_FIX_SSE2
+            return scan_sse2(p, end, scan);
+#else
+            return scan_scalar(p, end, scan);
+#endif
+        }
+    }
+
+    void FixMessage::clear()
+    {
+        for (std::size_t i = 0; i < size_; ++i)
+        {
+            if (fields_[i].tag < kIndexedTags)
+                index_[fields_[i].tag] = 0;
+        }
+        size_ = 0;
+    }
+
+    bool FixMessage::add_field(const char *tag_begin, const char *tag_end, const char *value_end)
+    {
+        int tag;
+        if (size_ == kMaxFields || !parse_fix_int(std::string_view(tag_begin, tag_end - tag_begin), tag) ||
+            tag == 0)
+            return false;
+
+        fields_[size_] = {tag, std::string_view(tag_end + 1, value_end - tag_end - 1)};
+        ++size_;
+        if (tag < kIndexedTags && index_[tag] == 0)
+            index_[tag] = static_cast<std::uint8_t>(size_);
+        return true;
+    }
+
+    bool FixMessage::parse(std::string_view buffer)
+    {
+        clear();
+
+        // Fields alternate between a tag ended by '=' and a value ended by SOH;
+        // '=' inside a value is data, SOH inside a tag is an error
+        const char *data = buffer.data();
+        const char *end = data + buffer.size();
+        const char *field = data;
+        const char *equals = nullptr;
+
+        auto delimiter = [&](const char *p)
+        {
+            if (!equals)
+            {
+                if (*p != '=')
+                    return false;
+                equals = p;
+                return true;
+            }
+            if (*p != kFixSoh)
+                return true;
+            if (!add_field(field, equals, p))
+                return false;
+            field = p + 1;
+            equals = nullptr;
+            return true;
+        };
+
+        const char *p = data;
+        for (; end - p >= 16; p += 16)
+        {
+            for (std::uint32_t mask = delimiter_mask(p); mask; mask &= mask - 1)
+            {
+                if (!delimiter(p + lowest_bit(mask)))
+                {
+                    clear();
+                    return false;
+                }
+            }
+        }
+        for (; p < end; ++p)
+        {
+            if ((*p == '=' || *p == kFixSoh) && !delimiter(p))
+            {
+                clear();
+                return false;
+            }
+        }
+
+        if (field != end || size_ == 0)
+        {
+            clear(); // Last field not terminated by SOH
+            return false;
+        }
+        return true;
+    }
+
+    const FixField *FixMessage::find(int tag) const
+    {
+        if (tag >= 0 && tag < kIndexedTags)
+            return index_[tag] ? &fields_[index_[tag] - 1] : nullptr;
+
+        for (const FixField &field : *this)
+        {
+            if (field.tag == tag)
+                return &field;
+        }
+        return nullptr;
+    }
+
+    const char *fix_error_text(FixError error)
+    {
+        switch (error)
+        {
+        case FixError::None:
+            return "ok";
+        case FixError::MissingField:
+            return "missing field";
+        case FixError::BadValue:
+            return "bad value";
+        }
+        return "unknown error";
+    }
+
+    const char *fix_check_text(FixCheck check)
+    {
+        switch (check)
+        {
+        case FixCheck::Ok:
+            return "ok";
+        case FixCheck::BadBeginString:
+            return "message must start with BeginString, BodyLength and MsgType";
+        case FixCheck::MissingTag:
+            return "missing required tag";
+        case FixCheck::BadTrailer:
+            return "message must end with CheckSum";
+        case FixCheck::BadBodyLength:
+            return "invalid body length";
+        case FixCheck::BadChecksum:
+            return "invalid checksum";
+        }
+        return "unknown error";
+    }
+
+    FixValidation validate_fix(std::string_view message)
+    {
+        FixValidation result{FixCheck::Ok, 0, 0, 0};
+        const char *data = message.data();
+        const char *end = data + message.size();
+
+        FieldScan scan{data, end};
+        if (!message.empty())
+            scan.field(data);
+        std::uint64_t sum = scan_fields(data, end, scan);
+
+        if (!scan.leading_ok || scan.index < 3)
+        {
+            result.status = FixCheck::BadBeginString;
+            return result;
+        }
+        for (int i = 0; i < 4; ++i)
+        {
+            if (!(scan.seen & (1u << i)))
+            {
+                result.status = FixCheck::MissingTag;
+                result.tag = FieldScan::kRequiredTags[i];
+                return result;
+            }
+        }
+
+        // The trailer is exactly 10=NNN<SOH> at the very end
+        const char *trailer = scan.trailer;
+        if (!trailer || end - trailer != 7 || end[-1] != kFixSoh)
+        {
+            result.status = FixCheck::BadTrailer;
+            return result;
+        }
+        int declared_checksum;
+        if (!parse_fix_int(std::string_view(trailer + 3, 3), declared_checksum))
+        {
+            result.status = FixCheck::BadTrailer;
+            return result;
+        }
+
+        for (const char *p = trailer; p < end; ++p)
+            sum -= static_cast<unsigned char>(*p);
+        result.checksum = static_cast<std::uint32_t>(sum % 256);
+        result.body_length = static_cast<std::size_t>(trailer - scan.body_start);
+
+        // BodyLength is the second field: "9=" up to the SOH before MsgType
+        int declared_length;
+        const char *length = std::find(data, end, kFixSoh) + 3;
+        if (!parse_fix_int(std::string_view(length, scan.body_start - 1 - length), declared_length) ||
+            static_cast<std::size_t>(declared_length) != result.body_length)
+            result.status = FixCheck::BadBodyLength;
+        else if (static_cast<std::uint32_t>(declared_checksum) != result.checksum)
+            result.status = FixCheck::BadChecksum;
+        return result;
+    }
+
+    bool parse_fix_int(std::string_view value, int &out)
+    {
+        if (value.empty() || value.size() > 10)
+            return false;
+
+        std::int64_t result = 0;
+        for (char c : value)
+        {
+            if (c < '0' || c > '9')
+                return false;
+            result = result * 10 + (c - '0');
+        }
+        if (result > std::numeric_limits<int>::max())
+            return false;
+        out = static_cast<int>(result);
+        return true;
+    }
+
+    bool parse_fix_price(std::string_view value, double &out)
+    {
+        std::size_t i = 0;
+        bool negative = false;
+        if (!value.empty() && (value[0] == '-' || value[0] == '+'))
+        {
+            negative = value[0] == '-';
+            ++i;
+        }
+
+        // Up to 18 significant digits fit the mantissa exactly
+        std::uint64_t mantissa = 0;
+        int digits = 0; // Significant digits, leading zeros excluded
+        int scale = 0;
+        bool point = false;
+        bool any_digit = false;
+        for (; i < value.size(); ++i)
+        {
+            char c = value[i];
+            if (c == '.' && !point)
+            {
+                point = true;
+                continue;
+            }
+            if (c < '0' || c > '9' || digits == 18 || scale == 18)
+                return false;
+            mantissa = mantissa * 10 + static_cast<std::uint64_t>(c - '0');
+            digits += mantissa != 0 ? 1 : 0;
+            scale += point ? 1 : 0;
+            any_digit = true;
+        }
+        if (!any_digit)
+            return false;
+
+        double result = static_cast<double>(mantissa) / kPow10[scale];
+        out = negative ? -result : result;
+        return true;
+    }
+
+    FixError decode_new_order(const FixMessage &message, Order &order, std::string_view &symbol, int &tag)
+    {
+        auto required = [&](int field_tag, std::string_view &value)
+        {
+            tag = field_tag;
+            value = message.get(field_tag);
+            return !value.empty();
+        };
+
+        std::string_view cl_ord_id, side, qty, order_type, price;
+        if (!required(11, cl_ord_id) || !required(55, symbol) || !required(54, side) ||
+            !required(38, qty) || !required(40, order_type))
+            return FixError::MissingField;
+
+        tag = 11;
+        if (!order.cl_ord_id.assign(cl_ord_id))
+            return FixError::BadValue;
+        tag = 54;
+        if (side.size() != 1 || (side[0] != '1' && side[0] != '2'))
+            return FixError::BadValue;
+        order.side = side[0];
+        tag = 38;
+        if (!parse_fix_int(qty, order.order_qty) || order.order_qty <= 0)
+            return FixError::BadValue;
+        tag = 40;
+        if (order_type.size() != 1 || (order_type[0] != '1' && order_type[0] != '2'))
+            return FixError::BadValue;
+        order.order_type = order_type[0];
+
+        order.price = 0.0;
+        if (!required(44, price))
+        {
+            if (order.order_type == '2')
+                return FixError::MissingField;
+        }
+        else if (!parse_fix_price(price, order.price) || order.price <= 0.0)
+            return FixError::BadValue;
+
+        order.filled_qty = 0;
+        order.status = '0';
+        tag = 0;
+        return FixError::None;
+    }
+
+} // namespace crucible
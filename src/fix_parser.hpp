@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include "matching_engine.hpp"
+
+namespace crucible
+{
+
+    constexpr char kFixSoh = '\x01';
+
+    // One tag=value field; value views the parsed buffer
+    struct FixField
+    {
+        int tag;
+        std::string_view value;
+    };
+
+    // Fields of one FIX tag=value message, in wire order. parse() scans the
+    // buffer once and keeps views into it, so the buffer must outlive the
+    // message. Tags below kIndexedTags, which covers the header and the order
+    // fields, are found through a direct index; others by a linear scan.
+    // A repeated tag resolves to its first occurrence.
+    class FixMessage
+    {
+    public:
+        static constexpr std::size_t kMaxFields = 128;
+        static constexpr int kIndexedTags = 128;
+
+    private:
+        std::array<FixField, kMaxFields> fields_;
+        std::size_t size_ = 0;
+        std::array<std::uint8_t, kIndexedTags> index_{}; // Field position + 1, 0 = absent
+
+        bool add_field(const char *tag_begin, const char *tag_end, const char *value_end);
+        void clear();
+
+    public:
+        // Returns false if the buffer is not a sequence of tag=value<SOH> fields
+        // or holds more than kMaxFields; the message is then empty
+        bool parse(std::string_view buffer);
+
+        const FixField *find(int tag) const;
+        bool has(int tag) const { return find(tag) != nullptr; }
+        // Empty view if the tag is absent
+        std::string_view get(int tag) const
+        {
+            const FixField *field = find(tag);
+            return field ? field->value : std::string_view();
+        }
+
+        std::size_t size() const { return size_; }
+        const FixField *begin() const { return fields_.data(); }
+        const FixField *end() const { return fields_.data() + size_; }
+    };
+
+    enum class FixError : std::uint8_t
+    {
+        None,
+        MissingField, // A required tag is absent
+        BadValue,     // A value does not parse or is out of range
+    };
+
+    const char *fix_error_text(FixError error);
+
+    // Decimal integer without sign or exponent; false on anything else or overflow
+    bool parse_fix_int(std::string_view value, int &out);
+    // Decimal with optional sign and fraction, such as FIX Price fields
+    bool parse_fix_price(std::string_view value, double &out);
+
+    enum class FixCheck : std::uint8_t
+    {
+        Ok,
+        BadBeginString, // Does not start with 8=, or 9 and 35 do not follow it
+        MissingTag,     // A required header tag is absent
+        BadTrailer,     // Does not end with a 10=NNN<SOH> field
+        BadBodyLength,  // Tag 9 disagrees with the bytes between it and tag 10
+        BadChecksum,    // Tag 10 disagrees with the sum of the bytes before it
+    };
+
+    struct FixValidation
+    {
+        FixCheck status;
+        int tag;                 // The missing tag, for MissingTag
+        std::uint32_t checksum;  // Byte sum modulo 256 up to the trailer
+        std::size_t body_length; // Bytes from after the BodyLength field up to the trailer
+    };
+
+    const char *fix_check_text(FixCheck check);
+
+    // Checks the framing of one complete message in a single pass over its bytes:
+    // 8, 9 and 35 lead in that order, 49, 56, 34 and 52 are present, and 10
+    // closes it with matching BodyLength and CheckSum. Uses AVX2 where the CPU
+    // has it, SSE2 or plain loops otherwise.
+    FixValidation validate_fix(std::string_view message);
+
+    // Decodes a New Order Single (tags 11, 38, 40, 44, 54, 55) into order,
+    // leaving its id and book fields alone. Price is required for limit orders.
+    // symbol views the message buffer. On failure, tag names the offending field.
+    FixError decode_new_order(const FixMessage &message, Order &order, std::string_view &symbol, int &tag);
+
+} // namespace crucible
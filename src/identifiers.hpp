@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace crucible
+{
+
+    using OrderId = std::uint64_t;  // Assigned by the engine, 0 = not yet assigned
+    using SymbolId = std::uint32_t; // Dense index into the engine's symbol table
+
+    constexpr SymbolId kInvalidSymbol = ~SymbolId(0);
+
+    // Source of order ids, shared by every book of an engine
+    class OrderIdSequence
+    {
+    private:
+        std::atomic<OrderId> next_{1};
+
+    public:
+        OrderId next() { return next_.fetch_add(1, std::memory_order_relaxed); }
+        // Ids handed out from now on are above id, e.g. after replaying a journal
+        void advance_past(OrderId id)
+        {
+            OrderId next = next_.load(std::memory_order_relaxed);
+            while (next <= id && !next_.compare_exchange_weak(next, id + 1, std::memory_order_relaxed))
+            {
+            }
+        }
+    };
+
+    // Inline string of at most N chars, used for client-supplied identifiers so
+    // orders stay trivially copyable and never allocate
+    template <std::size_t N>
+    class FixedString
+    {
+        static_assert(N < 256, "length is stored in one byte");
+
+    private:
+        char data_[N] = {};
+        std::uint8_t size_ = 0;
+
+    public:
+        static constexpr std::size_t capacity = N;
+
+        FixedString() = default;
+        // Throws std::length_error rather than truncating: two long ids cut to
+        // the same prefix would otherwise collide as keys
+        explicit FixedString(std::string_view value)
+        {
+            if (!assign(value))
+                throw std::length_error("identifier longer than " + std::to_string(N) + " chars");
+        }
+
+        // Truncates to N chars; returns false if value did not fit
+        bool assign(std::string_view value)
+        {
+            size_ = static_cast<std::uint8_t>(std::min(value.size(), N));
+            std::memcpy(data_, value.data(), size_);
+            return value.size() <= N;
+        }
+
+        std::string_view view() const { return std::string_view(data_, size_); }
+        std::string str() const { return std::string(data_, size_); }
+        std::size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+        bool operator==(const FixedString &other) const { return view() == other.view(); }
+        bool operator!=(const FixedString &other) const { return view() != other.view(); }
+    };
+
+    template <std::size_t N>
+    struct FixedStringHash
+    {
+        std::size_t operator()(const FixedString<N> &value) const
+        {
+            return std::hash<std::string_view>()(value.view());
+        }
+    };
+
+    using ClOrdId = FixedString<23>; // FIX ClOrdID (tag 11)
+
+    // Maps symbol names to dense ids. Interning happens when a book is created;
+    // the matching path only ever sees the ids. The table has a fixed capacity
+    // so lookups never lock: a name is written before its id is published into
+    // the open-addressed index, and neither changes afterwards.
+    class SymbolTable
+    {
+    private:
+        std::vector<std::string> names_;                 // names_[id], written once
+        std::unique_ptr<std::atomic<SymbolId>[]> index_; // id + 1 per hash slot, 0 = empty
+        std::size_t mask_;
+        std::atomic<std::size_t> size_{0};
+        std::mutex mutex_; // Serializes interning only
+
+        static std::size_t slots_for(std::size_t capacity)
+        {
+            std::size_t slots = 2;
+            while (slots < capacity * 2)
+                slots <<= 1;
+            return slots;
+        }
+
+        SymbolId lookup(std::string_view symbol, std::size_t &slot) const
+        {
+            slot = std::hash<std::string_view>()(symbol) & mask_;
+            for (;; slot = (slot + 1) & mask_)
+            {
+                SymbolId entry = index_[slot].load(std::memory_order_acquire);
+                if (entry == 0)
+                    return kInvalidSymbol;
+                if (names_[entry - 1] == symbol)
+                    return entry - 1;
+            }
+        }
+
+    public:
+        explicit SymbolTable(std::size_t capacity)
+            : names_(capacity), index_(new std::atomic<SymbolId>[slots_for(capacity)]),
+              mask_(slots_for(capacity) - 1)
+        {
+            for (std::size_t i = 0; i <= mask_; ++i)
+                index_[i].store(0, std::memory_order_relaxed);
+        }
+
+        // Returns kInvalidSymbol once the table is full
+        SymbolId intern(const std::string &symbol)
+        {
+            std::size_t slot;
+            SymbolId id = lookup(symbol, slot);
+            if (id != kInvalidSymbol)
+                return id;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            id = lookup(symbol, slot); // Another thread may have won the race
+            if (id != kInvalidSymbol)
+                return id;
+            std::size_t size = size_.load(std::memory_order_relaxed);
+            if (size == names_.size())
+                return kInvalidSymbol;
+
+            names_[size] = symbol;
+            size_.store(size + 1, std::memory_order_release);
+            index_[slot].store(static_cast<SymbolId>(size + 1), std::memory_order_release);
+            return static_cast<SymbolId>(size);
+        }
+
+        // Returns kInvalidSymbol for names that were never interned
+        SymbolId find(const std::string &symbol) const
+        {
+            std::size_t slot;
+            return lookup(symbol, slot);
+        }
+
+        std::string name(SymbolId id) const
+        {
+            return id < size() ? names_[id] : std::string();
+        }
+
+        std::size_t size() const { return size_.load(std::memory_order_acquire); }
+        std::size_t capacity() const { return names_.size(); }
+    };
+
+} // namespace crucible
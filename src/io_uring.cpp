@@ -0,0 +1,194 @@
+#include "io_uring.hpp"
+
+#ifdef CRUCIBLE_HAS_IO_URING
+
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace crucible
+{
+
+    namespace
+    {
+        int io_uring_setup(unsigned entries, io_uring_params *params)
+        {
+            return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+        }
+
+        int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+        {
+            return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+        }
+
+        int io_uring_register(int fd, unsigned opcode, void *arg, unsigned count)
+        {
+            return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+        }
+
+        template <typename T>
+        T *at(void *base, unsigned offset)
+        {
+            return reinterpret_cast<T *>(static_cast<char *>(base) + offset);
+        }
+    }
+
+    bool IoUring::init(unsigned entries)
+    {
+        close();
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ring_fd_ = io_uring_setup(entries, &params);
+        if (ring_fd_ < 0)
+            return false;
+
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap && cq_ring_size_ > sq_ring_size_)
+            sq_ring_size_ = cq_ring_size_;
+
+        sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                        IORING_OFF_SQ_RING);
+        if (sq_ring_ == MAP_FAILED)
+        {
+            sq_ring_ = nullptr;
+            close();
+            return false;
+        }
+        if (single_mmap)
+            cq_ring_ = sq_ring_;
+        else
+        {
+            cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                            IORING_OFF_CQ_RING);
+            if (cq_ring_ == MAP_FAILED)
+            {
+                cq_ring_ = nullptr;
+                close();
+                return false;
+            }
+        }
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                          IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+        {
+            close();
+            return false;
+        }
+        sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+        sq_head_ = at<unsigned>(sq_ring_, params.sq_off.head);
+        sq_tail_ = at<unsigned>(sq_ring_, params.sq_off.tail);
+        sq_mask_ = *at<unsigned>(sq_ring_, params.sq_off.ring_mask);
+        sq_entries_ = params.sq_entries;
+        sq_local_tail_ = sq_submitted_ = *sq_tail_;
+        // Submission slot i always names entry i
+        unsigned *array = at<unsigned>(sq_ring_, params.sq_off.array);
+        for (unsigned i = 0; i < sq_entries_; ++i)
+            array[i] = i;
+
+        cq_head_ = at<unsigned>(cq_ring_, params.cq_off.head);
+        cq_tail_ = at<unsigned>(cq_ring_, params.cq_off.tail);
+        cq_mask_ = *at<unsigned>(cq_ring_, params.cq_off.ring_mask);
+        cqes_ = at<io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+        return true;
+    }
+
+    bool IoUring::init_buffers(unsigned count, unsigned size, std::uint16_t group)
+    {
+        if (ring_fd_ < 0 || count == 0 || (count & (count - 1)) != 0 || count > 32768)
+            return false;
+
+        buf_ring_size_ = count * sizeof(io_uring_buf);
+        void *ring = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ring == MAP_FAILED)
+            return false;
+        buf_ring_ = static_cast<io_uring_buf_ring *>(ring);
+        buffers_ = new char[static_cast<std::size_t>(count) * size];
+        buffer_count_ = count;
+        buffer_size_ = size;
+        buffer_group_ = group;
+
+        io_uring_buf_reg reg;
+        std::memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = reinterpret_cast<std::uint64_t>(buf_ring_);
+        reg.ring_entries = count;
+        reg.bgid = group;
+        if (io_uring_register(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+        {
+            munmap(buf_ring_, buf_ring_size_);
+            buf_ring_ = nullptr;
+            delete[] buffers_;
+            buffers_ = nullptr;
+            return false;
+        }
+
+        for (unsigned id = 0; id < count; ++id)
+        {
+            io_uring_buf &buf = ring_buf(id);
+            buf.addr = reinterpret_cast<std::uint64_t>(buffer(id));
+            buf.len = size;
+            buf.bid = static_cast<std::uint16_t>(id);
+        }
+        __atomic_store_n(&buf_ring_->tail, static_cast<std::uint16_t>(count), __ATOMIC_RELEASE);
+        return true;
+    }
+
+    void IoUring::recycle_buffer(unsigned id)
+    {
+        std::uint16_t tail = buf_ring_->tail;
+        io_uring_buf &buf = ring_buf(tail & (buffer_count_ - 1));
+        buf.addr = reinterpret_cast<std::uint64_t>(buffer(id));
+        buf.len = buffer_size_;
+        buf.bid = static_cast<std::uint16_t>(id);
+        __atomic_store_n(&buf_ring_->tail, static_cast<std::uint16_t>(tail + 1), __ATOMIC_RELEASE);
+    }
+
+    io_uring_sqe *IoUring::get_sqe()
+    {
+        if (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_)
+            submit(false);
+        io_uring_sqe *sqe = &sqes_[sq_local_tail_ & sq_mask_];
+        ++sq_local_tail_;
+        std::memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    int IoUring::submit(bool wait)
+    {
+        __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+        unsigned to_submit = sq_local_tail_ - sq_submitted_;
+        int result = io_uring_enter(ring_fd_, to_submit, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0);
+        if (result > 0)
+            sq_submitted_ += static_cast<unsigned>(result);
+        return result;
+    }
+
+    void IoUring::close()
+    {
+        // Closing the ring first ends the kernel's use of the buffers below
+        if (ring_fd_ >= 0)
+            ::close(ring_fd_);
+        if (buf_ring_)
+            munmap(buf_ring_, buf_ring_size_);
+        delete[] buffers_;
+        if (sqes_)
+            munmap(sqes_, sqes_size_);
+        if (cq_ring_ && cq_ring_ != sq_ring_)
+            munmap(cq_ring_, cq_ring_size_);
+        if (sq_ring_)
+            munmap(sq_ring_, sq_ring_size_);
+
+        ring_fd_ = -1;
+        sq_ring_ = cq_ring_ = nullptr;
+        sqes_ = nullptr;
+        buf_ring_ = nullptr;
+        buffers_ = nullptr;
+    }
+
+} // namespace crucible
+
+#endif // CRUCIBLE_HAS_IO_URING
@@ -0,0 +1,89 @@
+#pragma once
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define CRUCIBLE_HAS_IO_URING 1
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+
+namespace crucible
+{
+
+    // Minimal io_uring over the raw system calls: one submission and one
+    // completion queue, plus a ring of provided buffers registered with the
+    // kernel, which receives flagged IOSQE_BUFFER_SELECT take their buffer from.
+    // Used by a single thread; a failed init leaves it unusable rather than throwing.
+    class IoUring
+    {
+    private:
+        int ring_fd_ = -1;
+        void *sq_ring_ = nullptr;
+        void *cq_ring_ = nullptr;
+        std::size_t sq_ring_size_ = 0;
+        std::size_t cq_ring_size_ = 0;
+        io_uring_sqe *sqes_ = nullptr;
+        std::size_t sqes_size_ = 0;
+
+        unsigned *sq_head_ = nullptr;
+        unsigned *sq_tail_ = nullptr;
+        unsigned sq_mask_ = 0;
+        unsigned sq_entries_ = 0;
+        unsigned sq_local_tail_ = 0; // Entries handed out, published to the kernel on submit
+        unsigned sq_submitted_ = 0;  // Entries the kernel has been told about
+
+        unsigned *cq_head_ = nullptr;
+        unsigned *cq_tail_ = nullptr;
+        unsigned cq_mask_ = 0;
+        io_uring_cqe *cqes_ = nullptr;
+
+        io_uring_buf_ring *buf_ring_ = nullptr;
+        std::size_t buf_ring_size_ = 0;
+        char *buffers_ = nullptr;
+        unsigned buffer_count_ = 0;
+        unsigned buffer_size_ = 0;
+        std::uint16_t buffer_group_ = 0;
+
+        void close();
+        // Entries are indexed from the ring's start: compiled as C++, the header's
+        // flexible bufs member lands 8 bytes late, behind an empty struct
+        io_uring_buf &ring_buf(unsigned index) { return reinterpret_cast<io_uring_buf *>(buf_ring_)[index]; }
+
+    public:
+        IoUring() = default;
+        ~IoUring() { close(); }
+        IoUring(const IoUring &) = delete;
+        IoUring &operator=(const IoUring &) = delete;
+
+        // Creates the rings; false if the kernel does not offer io_uring
+        bool init(unsigned entries);
+        // Registers count buffers of size bytes as buffer group group; count must be a power of two
+        bool init_buffers(unsigned count, unsigned size, std::uint16_t group);
+
+        // Next submission entry, zeroed. Submits what is queued first if the ring is full.
+        io_uring_sqe *get_sqe();
+        // Submits the queued entries; wait blocks until at least one completion is ready
+        int submit(bool wait);
+
+        // Calls handle(const io_uring_cqe &) for every ready completion, then
+        // hands the slots back to the kernel. Returns the number handled.
+        template <typename Handler>
+        unsigned for_each_completion(Handler &&handle)
+        {
+            unsigned head = *cq_head_;
+            unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            for (unsigned i = head; i != tail; ++i)
+                handle(cqes_[i & cq_mask_]);
+            __atomic_store_n(cq_head_, tail, __ATOMIC_RELEASE);
+            return tail - head;
+        }
+
+        const char *buffer(unsigned id) const { return buffers_ + static_cast<std::size_t>(id) * buffer_size_; }
+        // Returns a provided buffer to the kernel once its data has been consumed
+        void recycle_buffer(unsigned id);
+        std::uint16_t buffer_group() const { return buffer_group_; }
+    };
+
+} // namespace crucible
+
+#endif // CRUCIBLE_HAS_IO_URING
@@ -0,0 +1,309 @@
+#include "journal.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace crucible
+{
+
+    namespace
+    {
+        constexpr char kJournalMagic[] = "CRUCIBLE-JOURNAL";
+        constexpr std::int32_t kJournalVersion = 1;
+
+        // Word-wise multiplicative hash; the record is ten words and this runs per append
+        std::uint32_t checksum(const JournalRecord &record)
+        {
+            std::uint64_t words[sizeof(JournalRecord) / 8];
+            std::memcpy(words, &record, sizeof(words));
+            words[1] &= ~std::uint64_t(0xffffffff); // The checksum's own bytes
+            std::uint64_t hash = 0xcbf29ce484222325ull;
+            for (std::uint64_t word : words)
+                hash = (hash ^ word) * 0x100000001b3ull;
+            return static_cast<std::uint32_t>(hash ^ (hash >> 32));
+        }
+
+        JournalRecord header_record()
+        {
+            JournalRecord header{};
+            header.type = JournalType::Header;
+            header.qty = kJournalVersion;
+            header.order_id = sizeof(JournalRecord);
+            header.cl_ord_id_size = sizeof(kJournalMagic) - 1;
+            std::memcpy(header.cl_ord_id, kJournalMagic, header.cl_ord_id_size);
+            header.checksum = checksum(header);
+            return header;
+        }
+
+        bool is_header(const JournalRecord &record)
+        {
+            JournalRecord header = header_record();
+            return std::memcmp(&record, &header, sizeof(JournalRecord)) == 0;
+        }
+
+        bool is_valid(const JournalRecord &record, std::uint64_t sequence)
+        {
+            return record.sequence == sequence && record.checksum == checksum(record);
+        }
+    }
+
+#ifndef _WIN32
+    JournalReader::JournalReader(const std::string &path)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw std::runtime_error("cannot open journal " + path);
+        struct stat info;
+        if (fstat(fd, &info) != 0)
+        {
+            close(fd);
+            throw std::runtime_error("cannot read journal " + path);
+        }
+        mapped_ = static_cast<std::size_t>(info.st_size);
+        if (mapped_ > 0)
+            data_ = mmap(nullptr, mapped_, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd); // The mapping keeps the file
+        if (data_ == MAP_FAILED)
+        {
+            data_ = nullptr;
+            throw std::runtime_error("cannot map journal " + path);
+        }
+
+        const auto *records = static_cast<const JournalRecord *>(data_);
+        std::size_t slots = mapped_ / sizeof(JournalRecord);
+        if (slots == 0 || !is_header(records[0]))
+        {
+            if (data_)
+                munmap(data_, mapped_);
+            throw std::runtime_error(path + " is not a journal");
+        }
+        madvise(data_, mapped_, MADV_SEQUENTIAL);
+        while (size_ + 1 < slots && is_valid(records[size_ + 1], size_ + 1))
+            ++size_;
+    }
+
+    JournalReader::~JournalReader()
+    {
+        if (data_)
+            munmap(data_, mapped_);
+    }
+
+    Journal::Journal(const std::string &path, std::chrono::microseconds commit_interval)
+        : segments_(new std::atomic<char *>[kMaxSegments]), commit_interval_(commit_interval)
+    {
+        for (std::size_t i = 0; i < kMaxSegments; ++i)
+            segments_[i].store(nullptr, std::memory_order_relaxed);
+
+        std::uint64_t records = 0;
+        {
+            // Keeps the valid prefix of an existing journal; a new file is empty and throws here
+            int probe = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            struct stat info;
+            bool existing = probe >= 0 && fstat(probe, &info) == 0 && info.st_size > 0;
+            if (probe >= 0)
+                close(probe);
+            if (existing)
+                records = JournalReader(path).size();
+        }
+
+        fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd_ < 0)
+            throw std::runtime_error("cannot open journal " + path);
+        // Cutting the file after the last valid record zeroes any torn tail, so
+        // slots written later are never mistaken for an old run's records
+        JournalRecord header = header_record();
+        off_t used = static_cast<off_t>((records + 1) * sizeof(JournalRecord));
+        if (ftruncate(fd_, used) != 0 || pwrite(fd_, &header, sizeof(header), 0) != sizeof(header) ||
+            fdatasync(fd_) != 0)
+        {
+            close(fd_);
+            throw std::runtime_error("cannot write journal " + path);
+        }
+        next_.store(records + 1, std::memory_order_relaxed);
+        durable_.store(records, std::memory_order_relaxed);
+        map_segment(static_cast<std::size_t>((records + 1) / kSegmentRecords));
+        committer_ = std::thread(&Journal::run_committer, this);
+    }
+
+    Journal::~Journal()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        commit_cv_.notify_one();
+        committer_.join(); // Its last pass commits everything appended
+
+        for (std::size_t i = 0; i < kMaxSegments; ++i)
+        {
+            char *segment = segments_[i].load(std::memory_order_relaxed);
+            if (segment)
+                munmap(segment, kSegmentRecords * sizeof(JournalRecord));
+        }
+        // Segments are allocated whole; give back what holds no record
+        if (ftruncate(fd_, static_cast<off_t>((durable_sequence() + 1) * sizeof(JournalRecord))) == 0)
+            fdatasync(fd_);
+        close(fd_);
+    }
+
+    char *Journal::map_segment(std::size_t segment)
+    {
+        std::lock_guard<std::mutex> lock(map_mutex_);
+        char *mapped = segments_[segment].load(std::memory_order_acquire);
+        if (mapped)
+            return mapped; // Another appender mapped it first
+
+        const std::size_t bytes = kSegmentRecords * sizeof(JournalRecord);
+        // Blocks are allocated and pages mapped up front, so appends neither
+        // fault in pages one by one nor leave allocation to the commit
+        struct stat info;
+        off_t end = static_cast<off_t>((segment + 1) * bytes);
+        if (fstat(fd_, &info) != 0 ||
+            (info.st_size < end && posix_fallocate(fd_, info.st_size, end - info.st_size) != 0))
+            return nullptr;
+        void *data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                          static_cast<off_t>(segment * bytes));
+        if (data == MAP_FAILED)
+            return nullptr;
+        mapped = static_cast<char *>(data);
+        segments_[segment].store(mapped, std::memory_order_release);
+        return mapped;
+    }
+
+    JournalRecord *Journal::slot(std::uint64_t sequence)
+    {
+        std::size_t segment = static_cast<std::size_t>(sequence / kSegmentRecords);
+        if (segment >= kMaxSegments)
+            return nullptr;
+        char *base = segments_[segment].load(std::memory_order_acquire);
+        if (!base && !(base = map_segment(segment)))
+            return nullptr;
+        return reinterpret_cast<JournalRecord *>(base) + sequence % kSegmentRecords;
+    }
+
+    std::uint64_t Journal::append(JournalRecord record)
+    {
+        std::uint64_t sequence = next_.fetch_add(1, std::memory_order_relaxed);
+        JournalRecord *target = slot(sequence);
+        if (!target)
+        {
+            failed_.store(true, std::memory_order_relaxed);
+            return 0;
+        }
+        record.sequence = sequence;
+        record.checksum = checksum(record);
+
+        // Everything but the sequence, which publishes the slot to the committer
+        std::memcpy(reinterpret_cast<char *>(target) + sizeof(record.sequence),
+                    reinterpret_cast<const char *>(&record) + sizeof(record.sequence),
+                    sizeof(record) - sizeof(record.sequence));
+        __atomic_store_n(&target->sequence, sequence, __ATOMIC_RELEASE);
+        return sequence;
+    }
+
+    void Journal::commit()
+    {
+        // Past the middle of a segment, map the next one before an appender needs it
+        std::size_t ahead = static_cast<std::size_t>((last_sequence() + kSegmentRecords / 2) / kSegmentRecords);
+        if (ahead < kMaxSegments && !segments_[ahead].load(std::memory_order_acquire))
+            map_segment(ahead);
+
+        // Durable up to the first slot still being written; later slots wait for the next pass
+        const std::uint64_t durable = durable_.load(std::memory_order_relaxed);
+        const std::uint64_t last = last_sequence();
+        std::uint64_t end = durable;
+        while (end < last)
+        {
+            std::size_t segment = static_cast<std::size_t>((end + 1) / kSegmentRecords);
+            char *base = segment < kMaxSegments ? segments_[segment].load(std::memory_order_acquire) : nullptr;
+            if (!base)
+                break;
+            auto *record = reinterpret_cast<JournalRecord *>(base) + (end + 1) % kSegmentRecords;
+            if (__atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE) != end + 1)
+                break;
+            ++end;
+        }
+        if (end == durable)
+            return;
+
+        const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        for (std::uint64_t first = durable + 1; first <= end;)
+        {
+            std::size_t segment = static_cast<std::size_t>(first / kSegmentRecords);
+            std::uint64_t segment_end = std::min<std::uint64_t>(end, (segment + 1) * kSegmentRecords - 1);
+            char *base = segments_[segment].load(std::memory_order_acquire);
+            std::size_t from = (first % kSegmentRecords) * sizeof(JournalRecord) / page * page;
+            std::size_t to = (segment_end % kSegmentRecords + 1) * sizeof(JournalRecord);
+            if (msync(base + from, to - from, MS_SYNC) != 0)
+            {
+                failed_.store(true, std::memory_order_relaxed);
+                return;
+            }
+            first = segment_end + 1;
+        }
+        durable_.store(end, std::memory_order_release);
+    }
+
+    void Journal::run_committer()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+            commit_cv_.wait_for(lock, commit_interval_, [this] { return stopping_ || commit_requested_; });
+            bool stopping = stopping_;
+            commit_requested_ = false;
+            lock.unlock();
+            commit();
+            lock.lock();
+            durable_cv_.notify_all();
+            if (stopping)
+                break;
+        }
+    }
+#else
+    JournalReader::JournalReader(const std::string &path)
+    {
+        throw std::runtime_error("cannot map journal " + path + ": journals need POSIX memory mapping");
+    }
+
+    JournalReader::~JournalReader() {}
+
+    Journal::Journal(const std::string &path, std::chrono::microseconds commit_interval)
+        : commit_interval_(commit_interval)
+    {
+        throw std::runtime_error("cannot open journal " + path + ": journals need POSIX memory mapping");
+    }
+
+    Journal::~Journal() {}
+
+    std::uint64_t Journal::append(JournalRecord)
+    {
+        return 0;
+    }
+#endif
+
+    std::uint64_t Journal::sync()
+    {
+        const std::uint64_t target = last_sequence();
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (durable_sequence() < target && !failed_.load(std::memory_order_relaxed) && !stopping_)
+        {
+            commit_requested_ = true;
+            commit_cv_.notify_one();
+            durable_cv_.wait(lock);
+        }
+        if (failed_.load(std::memory_order_relaxed))
+            throw std::runtime_error("journal write failed; records after sequence " +
+                                     std::to_string(durable_sequence()) + " are not durable");
+        return durable_sequence();
+    }
+
+} // namespace crucible
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include "identifiers.hpp"
+
+namespace crucible
+{
+
+    enum class JournalType : std::uint8_t
+    {
+        Header, // Slot 0 of every file, never replayed
+        Symbol, // Names a symbol id; written before the symbol's first input
+        Add,    // add_order: rests without matching
+        Submit, // submit_order: matches on entry, then rests any limit remainder
+        Match,  // match_orders / match that produced at least one fill
+        Cancel,
+        Replace, // qty is the new quantity, price_ticks the resolved new price
+    };
+
+    // One accepted engine input. Records are fixed size and slot i of the file
+    // holds sequence i, so a reader can index the file directly. The sequence is
+    // stored last; with the checksum it marks a slot as completely written.
+    struct JournalRecord
+    {
+        std::uint64_t sequence;
+        std::uint32_t checksum; // Over the whole record with this field zero
+        SymbolId symbol_id;     // Journal's own numbering, resolved through Symbol records
+        JournalType type;
+        char side;
+        char order_type;
+        char status;            // Add: the order's status as added
+        std::int32_t qty;
+        OrderId order_id;
+        std::int64_t price_ticks;
+        double timestamp;
+        std::int32_t filled_qty; // Add: quantity already filled when added
+        std::uint8_t cl_ord_id_size;
+        char cl_ord_id[ClOrdId::capacity]; // Symbol: the symbol name
+        std::uint8_t reserved[4];          // Zero; spelled out so no byte is padding
+    };
+
+    static_assert(sizeof(JournalRecord) == 80, "journal layout");
+    static_assert(std::is_trivially_copyable<JournalRecord>::value, "journal records are written with memcpy");
+
+    // Reads the valid prefix of a journal file through one read-only mapping.
+    // Reading stops at the first slot whose sequence or checksum is wrong, so a
+    // torn tail left by a crash is ignored.
+    class JournalReader
+    {
+    private:
+        void *data_ = nullptr;
+        std::size_t mapped_ = 0;
+        std::size_t size_ = 0;
+
+    public:
+        // Throws std::runtime_error if the file cannot be read or is not a journal
+        explicit JournalReader(const std::string &path);
+        ~JournalReader();
+        JournalReader(const JournalReader &) = delete;
+        JournalReader &operator=(const JournalReader &) = delete;
+
+        // Valid records, the header excluded; record(sequence) for 1 <= sequence <= size()
+        std::size_t size() const { return size_; }
+        const JournalRecord &record(std::uint64_t sequence) const
+        {
+            return static_cast<const JournalRecord *>(data_)[sequence];
+        }
+    };
+
+    // Append-only journal over a memory-mapped file. Any thread may append:
+    // a slot is reserved with one atomic increment and the record is copied
+    // straight into the mapping, which grows a segment at a time. A background
+    // thread group-commits: every commit interval (or when sync asks) it
+    // msyncs the written prefix in one call per segment, so one flush covers
+    // every append since the last. Reopening a journal keeps its valid
+    // records and appends after them.
+    class Journal
+    {
+    private:
+        static constexpr std::size_t kSegmentRecords = std::size_t(1) << 18; // 20 MiB segments
+        static constexpr std::size_t kMaxSegments = std::size_t(1) << 16;
+
+        int fd_ = -1;
+        std::unique_ptr<std::atomic<char *>[]> segments_; // Mapped on first use
+        std::mutex map_mutex_;                             // Serializes growing the file
+        alignas(64) std::atomic<std::uint64_t> next_{1};   // Next sequence to hand out
+        alignas(64) std::atomic<std::uint64_t> durable_{0}; // Last sequence known to be on disk
+        std::atomic<bool> failed_{false};
+
+        std::chrono::microseconds commit_interval_;
+        std::mutex mutex_; // Commit requests and waiters
+        std::condition_variable commit_cv_;
+        std::condition_variable durable_cv_;
+        bool commit_requested_ = false;
+        bool stopping_ = false;
+        std::thread committer_;
+
+        JournalRecord *slot(std::uint64_t sequence);
+        char *map_segment(std::size_t segment);
+        void commit();
+        void run_committer();
+
+    public:
+        // Opens or creates the journal at path. Throws std::runtime_error if the
+        // file cannot be opened or holds something other than a journal.
+        explicit Journal(const std::string &path,
+                         std::chrono::microseconds commit_interval = std::chrono::microseconds(1000));
+        // Commits what was appended and trims the file to its records
+        ~Journal();
+        Journal(const Journal &) = delete;
+        Journal &operator=(const Journal &) = delete;
+
+        // Stamps the next sequence and the checksum and writes the record.
+        // Returns the sequence, or 0 once the file could not be grown.
+        std::uint64_t append(JournalRecord record);
+        // Blocks until everything appended before the call is durable and returns
+        // the durable sequence. Throws std::runtime_error if writing failed.
+        std::uint64_t sync();
+
+        std::uint64_t last_sequence() const { return next_.load(std::memory_order_acquire) - 1; }
+        std::uint64_t durable_sequence() const { return durable_.load(std::memory_order_acquire); }
+    };
+
+} // namespace crucible
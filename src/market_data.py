@@ -0,0 +1,259 @@
+"""
+Conflating Market Data Publisher
+
+Collects book changes from the exchange's order book and fans them out to
+WebSocket subscribers on a fixed tick, so a burst of orders costs one update
+per subscriber interval instead of one broadcast per order.
+"""
+
+import asyncio
+import json
+import logging
+import threading
+import time
+from collections import deque
+from dataclasses import dataclass
+from datetime import datetime
+from typing import Any, Callable, Deque, Dict, List, Optional, Tuple
+
+logger = logging.getLogger(__name__)
+
+
+@dataclass
+class Subscriber:
+    """Delivery state of one WebSocket client."""
+    client: Any
+    interval_ticks: int
+    last_tick: int  # Changes stamped up to this tick have been delivered
+    next_tick: int
+    last_sent: float
+    sending: Optional[asyncio.Task] = None
+
+
+class MarketDataPublisher:
+    """
+    Conflates book changes per price level and publishes them on a tick.
+
+    Writers on the FIX threads only record changes: level deltas replace the
+    previous state of their level, a Python book is marked dirty, and
+    executions and order events are queued. Each tick, on the WebSocket loop,
+    every subscriber whose throttle interval has elapsed gets one 'batch'
+    message with everything that changed since its last update. Subscribers
+    that last caught up on the same tick share one serialized message.
+
+    A subscriber whose previous send is still in flight is skipped, and its
+    next update covers the skipped ticks; one that stays behind for longer
+    than max_lag seconds, or outlives the event history, is disconnected.
+
+    Level deltas skip sequence numbers once conflated, so subscribers cannot
+    spot a lost one. When the engine reports dropped events instead, every
+    subscriber's next update starts over from a full-depth level snapshot.
+    """
+
+    def __init__(self, book_snapshot: Callable[[], Dict], tick_interval: float = 0.02,
+                 default_throttle_ms: int = 100, max_lag: float = 5.0, event_history: int = 10000,
+                 level_snapshot: Optional[Callable[[], Dict]] = None):
+        """
+        Initialize the publisher.
+
+        Args:
+            book_snapshot: Returns the full book, sent when a Python book is dirty
+            tick_interval: Seconds between ticks, the finest throttle available
+            default_throttle_ms: Update interval of subscribers that do not ask for one
+            max_lag: Seconds a subscriber may stay behind before it is disconnected
+            event_history: Queued events kept for subscribers that are behind
+            level_snapshot: Returns every symbol's levels, sent after events were dropped
+        """
+        self.book_snapshot = book_snapshot
+        self.tick_interval = tick_interval
+        self.default_throttle_ms = default_throttle_ms
+        self.max_lag = max_lag
+        self.event_history = event_history
+        self.level_snapshot = level_snapshot
+
+        # Written by the FIX threads; entries are stamped with the tick that will publish them
+        self._lock = threading.Lock()
+        self._tick = 0
+        self._levels: Dict[Tuple[str, str, float], Tuple[int, Dict]] = {}
+        self._events: Deque[Tuple[int, Dict]] = deque()
+        self._evicted_tick = 0  # Newest stamp dropped from a full event history
+        self._book_tick = 0
+        self._resync_tick = 0
+        self._events_dropped = 0
+
+        # Only touched on the WebSocket loop
+        self._subscribers: Dict[Any, Subscriber] = {}
+
+    def subscriber_count(self) -> int:
+        """Number of connected subscribers."""
+        return len(self._subscribers)
+
+    def publish_event(self, event_type: str, data: Dict):
+        """Queue an event that is delivered as is, such as an execution."""
+        if not self._subscribers:
+            return  # A new subscriber starts from a snapshot
+
+        event = {'type': event_type, 'data': data, 'timestamp': datetime.now().isoformat()}
+        with self._lock:
+            self._events.append((self._tick + 1, event))
+            while len(self._events) > self.event_history:
+                self._evicted_tick = self._events.popleft()[0]
+
+    def update_levels(self, deltas: List[Dict]):
+        """Record level deltas; only the latest state of each level is published."""
+        if not self._subscribers:
+            return
+
+        with self._lock:
+            stamp = self._tick + 1
+            for delta in deltas:
+                self._levels[(delta['symbol'], delta['side'], delta['price'])] = (stamp, delta)
+
+    def mark_book_dirty(self):
+        """Publish the full book on the next update of every subscriber."""
+        if not self._subscribers:
+            return
+
+        with self._lock:
+            self._book_tick = self._tick + 1
+
+    def resync_levels(self, events_dropped: int):
+        """Send full-depth levels on the next update of every subscriber; deltas may have gaps."""
+        with self._lock:
+            self._events_dropped = events_dropped
+            if self._subscribers:
+                self._resync_tick = self._tick + 1
+
+    @property
+    def events_dropped(self) -> int:
+        """Engine events lost as of the last resync."""
+        return self._events_dropped
+
+    def subscribe(self, client: Any, throttle_ms: Optional[int] = None):
+        """Add a client, or reset an existing one to a snapshot taken right after this call."""
+        now = time.monotonic()
+        subscriber = self._subscribers.get(client)
+        if subscriber is None:
+            subscriber = Subscriber(client, 1, 0, 0, now)
+            self._subscribers[client] = subscriber
+            self.set_throttle(client, throttle_ms)
+
+        with self._lock:
+            subscriber.last_tick = self._tick
+        subscriber.next_tick = subscriber.last_tick + subscriber.interval_ticks
+        subscriber.last_sent = now
+
+    def set_throttle(self, client: Any, throttle_ms: Optional[int]):
+        """Change how often a subscriber is updated; None restores the default."""
+        subscriber = self._subscribers.get(client)
+        if subscriber is None:
+            return
+        if throttle_ms is None:
+            throttle_ms = self.default_throttle_ms
+        subscriber.interval_ticks = max(1, round(throttle_ms / 1000.0 / self.tick_interval))
+        subscriber.next_tick = subscriber.last_tick + subscriber.interval_ticks
+
+    def unsubscribe(self, client: Any):
+        """Remove a client; does nothing if it is already gone."""
+        self._subscribers.pop(client, None)
+
+    async def run(self):
+        """Publish every tick_interval until cancelled."""
+        while True:
+            await asyncio.sleep(self.tick_interval)
+            try:
+                self.tick()
+            except Exception as e:
+                logger.error(f"Error publishing market data: {e}", exc_info=True)
+
+    def tick(self):
+        """Close the current tick and send updates to the subscribers that are due."""
+        with self._lock:
+            self._tick += 1
+            tick = self._tick
+
+        now = time.monotonic()
+        messages: Dict[int, Optional[str]] = {}  # By last_tick, built once per tick
+        snapshots: Dict[str, Dict] = {}  # Taken at most once per tick
+
+        for subscriber in list(self._subscribers.values()):
+            if subscriber.next_tick > tick:
+                continue
+            if subscriber.sending is not None and not subscriber.sending.done():
+                # Still sending the previous update; conflate into the next one
+                if now - subscriber.last_sent > self.max_lag:
+                    self._drop(subscriber, "too slow")
+                continue
+            if subscriber.last_tick < self._evicted_tick:
+                self._drop(subscriber, "missed events")
+                continue
+
+            if subscriber.last_tick not in messages:
+                messages[subscriber.last_tick] = self._build_update(subscriber.last_tick, tick, snapshots)
+            message = messages[subscriber.last_tick]
+
+            subscriber.last_tick = tick
+            subscriber.next_tick = tick + subscriber.interval_ticks
+            if message is not None:
+                subscriber.last_sent = now
+                subscriber.sending = asyncio.ensure_future(self._send(subscriber, message))
+            else:
+                subscriber.last_sent = now  # Nothing changed; the subscriber is current
+
+        self._prune(tick)
+
+    def _build_update(self, since: int, tick: int, snapshots: Dict[str, Dict]) -> Optional[str]:
+        """Serialize everything stamped after since and up to tick, or None if nothing changed."""
+        with self._lock:
+            events = [event for stamp, event in self._events if since < stamp <= tick]
+            levels = [delta for stamp, delta in self._levels.values() if since < stamp <= tick]
+            book_dirty = since < self._book_tick <= tick
+            resync = since < self._resync_tick <= tick and self.level_snapshot is not None
+
+        items = events
+        if book_dirty:
+            if 'book' not in snapshots:
+                snapshots['book'] = self.book_snapshot()
+            items.append({'type': 'orderbook', 'data': snapshots['book']})
+        if resync:
+            # Deltas at or below each symbol's snapshot seq are skipped by the client
+            if 'levels' not in snapshots:
+                snapshots['levels'] = {'levels': self.level_snapshot(), 'events_dropped': self._events_dropped}
+            items.append({'type': 'snapshot', 'data': snapshots['levels']})
+        if levels:
+            levels.sort(key=lambda delta: (delta['symbol'], delta['seq']))
+            items.append({'type': 'orderbook_delta', 'data': {'levels': levels}})
+        if not items:
+            return None
+
+        return json.dumps({
+            'type': 'batch',
+            'data': items,
+            'timestamp': datetime.now().isoformat()
+        })
+
+    def _prune(self, tick: int):
+        """Forget changes every subscriber has been sent."""
+        floor = min((s.last_tick for s in self._subscribers.values()), default=tick)
+        with self._lock:
+            while self._events and self._events[0][0] <= floor:
+                self._events.popleft()
+            stale = [key for key, (stamp, _) in self._levels.items() if stamp <= floor]
+            for key in stale:
+                del self._levels[key]
+
+    async def _send(self, subscriber: Subscriber, message: str):
+        """Send one update; a failed send removes the subscriber."""
+        try:
+            await subscriber.client.send(message)
+        except Exception as e:
+            logger.error(f"Error sending to client: {e}")
+            self.unsubscribe(subscriber.client)
+
+    def _drop(self, subscriber: Subscriber, reason: str):
+        """Disconnect a subscriber that cannot keep up."""
+        logger.warning(f"Dropping market data subscriber: {reason}")
+        self.unsubscribe(subscriber.client)
+        if subscriber.sending is not None:
+            subscriber.sending.cancel()
+        asyncio.ensure_future(subscriber.client.close())
@@ -2,203 +2,1613 @@
 #include <algorithm>
 #include <cmath>
 #include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace crucible
 {
 
-    // OrderBook implementation
-    void OrderBook::add_order(std::shared_ptr<Order> order)
+    namespace
+    {
+        bool is_valid_config(const BookConfig &config)
+        {
+            return config.tick_size > 0.0 && std::isfinite(config.tick_size) &&
+                   config.ladder_levels > 0;
+        }
+
+        // Names a symbol id in the journal; the name travels in the cl_ord_id field
+        JournalRecord symbol_record(SymbolId symbol_id, const std::string &symbol)
+        {
+            JournalRecord record{};
+            record.symbol_id = symbol_id;
+            record.type = JournalType::Symbol;
+            record.cl_ord_id_size = static_cast<std::uint8_t>(symbol.size());
+            std::memcpy(record.cl_ord_id, symbol.data(), symbol.size());
+            return record;
+        }
+
+        double wall_clock()
+        {
+            auto now = std::chrono::system_clock::now();
+            return std::chrono::duration<double>(now.time_since_epoch()).count();
+        }
+
+        // Best effort; shards still run unpinned where affinity is unsupported
+        void pin_to_core(std::thread &thread, std::size_t core)
+        {
+#ifdef __linux__
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(core % CPU_SETSIZE, &cpus);
+            pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+#else
+            (void)thread;
+            (void)core;
+#endif
+        }
+
+        int lowest_bit(std::uint64_t bits)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward64(&index, bits);
+            return static_cast<int>(index);
+#else
+            return __builtin_ctzll(bits);
+#endif
+        }
+
+        int highest_bit(std::uint64_t bits)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanReverse64(&index, bits);
+            return static_cast<int>(index);
+#else
+            return 63 - __builtin_clzll(bits);
+#endif
+        }
+    }
+
+    // MapBookSide implementation
+    MapBookSide::MapBookSide(bool bids, const BookConfig &config)
+        : bids_(bids),
+          levels_(LevelMap::allocator_type(std::make_shared<SlabPool>(config.level_capacity))) {}
+
+    const PriceLevel *MapBookSide::best() const
+    {
+        if (levels_.empty())
+            return nullptr;
+        return bids_ ? &levels_.rbegin()->second : &levels_.begin()->second;
+    }
+
+    PriceLevel *MapBookSide::find(Price price)
+    {
+        auto it = levels_.find(price);
+        return it == levels_.end() ? nullptr : &it->second;
+    }
+
+    PriceLevel &MapBookSide::get_or_create(Price price)
+    {
+        return levels_.try_emplace(price, price).first->second;
+    }
+
+    void MapBookSide::erase(Price price)
+    {
+        levels_.erase(price);
+    }
+
+    // LadderBookSide implementation
+    LadderBookSide::LadderBookSide(bool bids, const BookConfig &config)
+        : bids_(bids), base_(0),
+          slots_((config.ladder_levels + 63) / 64 * 64),
+          occupied_(slots_.size() / 64, 0), active_(0), best_slot_(0),
+          overflow_(LevelMap::allocator_type(std::make_shared<SlabPool>(config.level_capacity))) {}
+
+    void LadderBookSide::recenter(Price price)
+    {
+        // Park the window's levels in the tree, then rebuild it around price
+        for (std::size_t word = 0; word < occupied_.size(); ++word)
+        {
+            for (std::uint64_t bits = occupied_[word]; bits != 0; bits &= bits - 1)
+            {
+                PriceLevel &level = slots_[(word << 6) + lowest_bit(bits)];
+                overflow_.try_emplace(level.price, std::move(level));
+            }
+            occupied_[word] = 0;
+        }
+        active_ = 0;
+        base_ = price - static_cast<Price>(slots_.size() / 2);
+
+        // Pull any tree levels that now fall inside the window
+        auto it = overflow_.lower_bound(base_);
+        while (it != overflow_.end() && in_window(it->first))
+        {
+            std::size_t slot = static_cast<std::size_t>(it->first - base_);
+            slots_[slot] = std::move(it->second);
+            occupied_[slot >> 6] |= std::uint64_t(1) << (slot & 63);
+            if (active_ == 0 || better(it->first, slots_[best_slot_].price))
+                best_slot_ = slot;
+            ++active_;
+            it = overflow_.erase(it);
+        }
+    }
+
+    std::size_t LadderBookSide::next_occupied(std::size_t slot) const
+    {
+        // Everything still occupied is worse than the slot just vacated
+        std::size_t word = slot >> 6;
+        if (bids_)
+        {
+            std::uint64_t bits = occupied_[word] & (~std::uint64_t(0) >> (63 - (slot & 63)));
+            while (bits == 0)
+                bits = occupied_[--word];
+            return (word << 6) + highest_bit(bits);
+        }
+        std::uint64_t bits = occupied_[word] & (~std::uint64_t(0) << (slot & 63));
+        while (bits == 0)
+            bits = occupied_[++word];
+        return (word << 6) + lowest_bit(bits);
+    }
+
+    const PriceLevel *LadderBookSide::best() const
+    {
+        const PriceLevel *window = active_ > 0 ? &slots_[best_slot_] : nullptr;
+        if (overflow_.empty())
+            return window;
+        const PriceLevel &outer = bids_ ? overflow_.rbegin()->second : overflow_.begin()->second;
+        if (!window || better(outer.price, window->price))
+            return &outer;
+        return window;
+    }
+
+    PriceLevel *LadderBookSide::find(Price price)
+    {
+        if (in_window(price))
+        {
+            std::size_t slot = static_cast<std::size_t>(price - base_);
+            return is_occupied(slot) ? &slots_[slot] : nullptr;
+        }
+        auto it = overflow_.find(price);
+        return it == overflow_.end() ? nullptr : &it->second;
+    }
+
+    PriceLevel &LadderBookSide::get_or_create(Price price)
+    {
+        // The window follows the market: a level landing outside it moves the
+        // window onto the best price once that has left the window or nears
+        // its edge. Tick 0 is where market orders rest and never moves it.
+        if (!in_window(price) && price > 0)
+        {
+            const PriceLevel *top = best();
+            Price anchor = top && top->price > 0 && !better(price, top->price) ? top->price : price;
+            const Price margin = static_cast<Price>(slots_.size() / 8);
+            if (anchor < base_ + margin || anchor >= base_ + static_cast<Price>(slots_.size()) - margin)
+                recenter(anchor);
+        }
+
+        if (!in_window(price))
+            return overflow_.try_emplace(price, price).first->second;
+
+        std::size_t slot = static_cast<std::size_t>(price - base_);
+        if (!is_occupied(slot))
+        {
+            occupied_[slot >> 6] |= std::uint64_t(1) << (slot & 63);
+            slots_[slot].price = price;
+            if (active_ == 0 || better(price, slots_[best_slot_].price))
+                best_slot_ = slot;
+            ++active_;
+        }
+        return slots_[slot];
+    }
+
+    void LadderBookSide::erase(Price price)
+    {
+        if (!in_window(price))
+        {
+            overflow_.erase(price);
+            return;
+        }
+
+        std::size_t slot = static_cast<std::size_t>(price - base_);
+        if (!is_occupied(slot))
+            return;
+        occupied_[slot >> 6] &= ~(std::uint64_t(1) << (slot & 63));
+        --active_;
+        if (active_ > 0 && slot == best_slot_)
+            best_slot_ = next_occupied(slot);
+    }
+
+    // OrderBook implementation
+    Price OrderBook::to_ticks(double price) const
+    {
+        return static_cast<Price>(std::llround(price / tick_size_));
+    }
+
+    std::shared_ptr<Order> OrderBook::create_order(const ClOrdId &cl_ord_id, char side, int qty,
+                                                   char order_type, double price, double timestamp)
+    {
+        return std::allocate_shared<Order>(order_allocator_, order_ids_->next(), cl_ord_id,
+                                           side, qty, order_type, price, timestamp);
+    }
+
+    std::vector<Match> OrderBook::match_orders()
+    {
+        std::vector<Match> matches;
+        match_orders(matches);
+        return matches;
+    }
+
+    std::shared_ptr<Order> OrderBook::replace_order(OrderId order_id, int new_qty, double new_price)
+    {
+        std::vector<Match> matches;
+        return replace_order(order_id, new_qty, new_price, matches);
+    }
+
+    void OrderBook::prepare_order(Order &order) const
+    {
+        if (order.order_id == 0)
+        {
+            order.order_id = order_ids_->next();
+        }
+        order.symbol_id = symbol_id_;
+        if (order.price_ticks == 0)
+        {
+            order.price_ticks = to_ticks(order.price);
+        }
+        order.price = to_price(order.price_ticks);
+    }
+
+    void OrderBook::set_event_ring(std::shared_ptr<EventRing> ring)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        events_ = std::move(ring);
+    }
+
+    void OrderBook::publish(EventType type, const Order &order, int qty, OrderId contra_order_id)
+    {
+        if (!events_)
+            return;
+        events_->try_push({type, order.side, order.status, symbol_id_, order.order_id, contra_order_id,
+                           qty, order.remaining_qty(), order.price_ticks, wall_clock(), 0});
+    }
+
+    void OrderBook::set_l3_ring(std::shared_ptr<L3Ring> ring)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        l3_ = std::move(ring);
+    }
+
+    void OrderBook::publish_l3(L3Type type, const Order &order, int qty, Price price_ticks)
+    {
+        if (!l3_)
+            return;
+        l3_->try_push({++l3_sequence_, order.order_id, price_ticks, wall_clock(), symbol_id_, qty,
+                       type, order.side});
+    }
+
+    void OrderBook::set_journal(std::shared_ptr<Journal> journal)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        journal_ = std::move(journal);
+    }
+
+    void OrderBook::journal(JournalType type, const Order &order, int qty, Price price_ticks)
+    {
+        if (!journal_)
+            return;
+        JournalRecord record{};
+        record.symbol_id = symbol_id_;
+        record.type = type;
+        record.side = order.side;
+        record.order_type = order.order_type;
+        record.status = order.status;
+        record.qty = qty;
+        record.order_id = order.order_id;
+        record.price_ticks = price_ticks;
+        record.timestamp = order.timestamp;
+        record.filled_qty = order.filled_qty;
+        record.cl_ord_id_size = static_cast<std::uint8_t>(order.cl_ord_id.size());
+        std::memcpy(record.cl_ord_id, order.cl_ord_id.view().data(), order.cl_ord_id.size());
+        journal_->append(record);
+    }
+
+    void OrderBook::journal_match()
+    {
+        if (!journal_)
+            return;
+        JournalRecord record{};
+        record.symbol_id = symbol_id_;
+        record.type = JournalType::Match;
+        journal_->append(record);
+    }
+
+    void OrderBook::publish_level(char side, const PriceLevel &level)
+    {
+        // The sequence advances even without a ring so snapshots stay comparable
+        ++level_sequence_;
+        if (!events_)
+            return;
+        events_->try_push({EventType::BookUpdate, side, '0', symbol_id_, 0, 0,
+                           static_cast<int>(level.quantity()), level.size(), level.price, wall_clock(),
+                           level_sequence_});
+    }
+
+    void OrderBook::record_trade(Price price_ticks, int qty)
+    {
+        top_state_.last_ticks = price_ticks;
+        top_state_.last_qty = qty;
+    }
+
+    void OrderBook::publish_top(const PriceLevel *best_bid, const PriceLevel *best_ask)
+    {
+        top_state_.bid_ticks = best_bid ? best_bid->price : 0;
+        top_state_.bid_qty = best_bid ? best_bid->quantity() : 0;
+        top_state_.ask_ticks = best_ask ? best_ask->price : 0;
+        top_state_.ask_qty = best_ask ? best_ask->quantity() : 0;
+        ++top_state_.sequence;
+        top_.store(top_state_);
+    }
+
+    double OrderBook::get_best_bid() const
+    {
+        return to_price(get_best_bid_ticks());
+    }
+
+    double OrderBook::get_best_ask() const
+    {
+        return to_price(get_best_ask_ticks());
+    }
+
+    std::vector<DepthLevel> OrderBook::get_depth(char side, std::size_t max_levels) const
+    {
+        std::vector<DepthLevel> depth(max_levels);
+        depth.resize(get_depth(side, depth.data(), max_levels));
+        return depth;
+    }
+
+    double OrderBook::get_spread() const
+    {
+        // One snapshot, so both sides come from the same book state
+        TopOfBook top = top_.load();
+        if (top.bid_ticks == 0 || top.ask_ticks == 0)
+            return 0.0;
+        return to_price(top.ask_ticks - top.bid_ticks);
+    }
+
+    // BasicOrderBook implementation
+    template <typename Levels>
+    BasicOrderBook<Levels>::BasicOrderBook(const std::string &symbol, SymbolId symbol_id,
+                                           const BookConfig &config,
+                                           std::shared_ptr<OrderIdSequence> order_ids)
+        : OrderBook(symbol, symbol_id, config, std::move(order_ids)),
+          buy_levels_(true, config), sell_levels_(false, config),
+          orders_(config.order_capacity, typename decltype(orders_)::hasher(),
+                  typename decltype(orders_)::key_equal(),
+                  typename decltype(orders_)::allocator_type(std::make_shared<SlabPool>(config.order_capacity))),
+          cl_ord_ids_(config.order_capacity, typename decltype(cl_ord_ids_)::hasher(),
+                      typename decltype(cl_ord_ids_)::key_equal(),
+                      typename decltype(cl_ord_ids_)::allocator_type(std::make_shared<SlabPool>(config.order_capacity)))
+    {
+    }
+
+    template <typename Levels>
+    void BasicOrderBook<Levels>::unlink(Order &order)
+    {
+        PriceLevel *level = order.level;
+        level->remove_order(&order);
+        publish_level(order.side, *level);
+        if (level->is_empty())
+        {
+            levels_for(order).erase(level->price);
+        }
+    }
+
+    template <typename Levels>
+    void BasicOrderBook<Levels>::remove_resting(Order &order)
+    {
+        unlink(order);
+        forget(order);
+    }
+
+    template <typename Levels>
+    void BasicOrderBook<Levels>::forget(Order &order)
+    {
+        auto cl = cl_ord_ids_.find(order.cl_ord_id);
+        if (cl != cl_ord_ids_.end() && cl->second == &order)
+        {
+            cl_ord_ids_.erase(cl);
+        }
+        orders_.erase(order.order_id); // May release the order, keep this last
+    }
+
+    template <typename Levels>
+    bool BasicOrderBook<Levels>::add_order(std::shared_ptr<Order> order)
+    {
+        prepare_order(*order);
+
+        BookLock lock(*this);
+        if (!lock)
+            return false;
+
+        auto [it, inserted] = orders_.try_emplace(order->order_id, order);
+        if (!inserted)
+            return false;
+
+        journal(JournalType::Add, *order, order->order_qty, order->price_ticks);
+        publish(EventType::Ack, *order, order->order_qty);
+        rest(order);
+        publish_top();
+        return true;
+    }
+
+    template <typename Levels>
+    void BasicOrderBook<Levels>::rest(const std::shared_ptr<Order> &order)
+    {
+        cl_ord_ids_[order->cl_ord_id] = order.get();
+        PriceLevel &level = levels_for(*order).get_or_create(order->price_ticks);
+        level.add_order(order.get());
+        publish_l3(L3Type::Add, *order, order->remaining_qty(), order->price_ticks);
+        publish_level(order->side, level);
+    }
+
+    template <typename Levels>
+    std::size_t BasicOrderBook<Levels>::cross(Order &order, std::vector<Match> &matches)
+    {
+        const bool is_buy = order.side == '1';
+        const bool is_market = order.order_type == '1';
+        Levels &contra = is_buy ? sell_levels_ : buy_levels_;
+        std::size_t count = 0;
+
+        while (!order.is_complete())
+        {
+            PriceLevel *level = contra.best();
+            if (!level)
+                break;
+
+            // Trade at the resting order's price; a resting market order takes ours
+            Order *resting = level->front();
+            Price match_price;
+            if (resting->order_type != '1')
+                match_price = resting->price_ticks;
+            else if (!is_market)
+                match_price = order.price_ticks;
+            else
+            {
+                // Two market orders have no price to trade at. Market orders never
+                // rest, so one left by add_order is stale: cancel it and look past it
+                resting->status = '4';
+                publish(EventType::Cancel, *resting, resting->order_qty);
+                publish_l3(L3Type::Delete, *resting, resting->remaining_qty(), resting->price_ticks);
+                remove_resting(*resting);
+                continue;
+            }
+
+            if (!is_market && (is_buy ? match_price > order.price_ticks : match_price < order.price_ticks))
+                break;
+
+            int match_qty = std::min(order.remaining_qty(), resting->remaining_qty());
+
+            order.filled_qty += match_qty;
+            resting->filled_qty += match_qty;
+            level->reduce(match_qty);
+
+            order.status = order.is_complete() ? '2' : '1';
+            resting->status = resting->is_complete() ? '2' : '1';
+
+            matches.push_back({is_buy ? order.order_id : resting->order_id,
+                               is_buy ? resting->order_id : order.order_id,
+                               match_qty,
+                               match_price,
+                               to_price(match_price),
+                               wall_clock()});
+            publish(EventType::Fill, order, match_qty, resting->order_id);
+            publish(EventType::Fill, *resting, match_qty, order.order_id);
+            publish_l3(L3Type::Execute, *resting, match_qty, match_price);
+            record_trade(match_price, match_qty);
+            ++count;
+
+            if (resting->is_complete())
+            {
+                remove_resting(*resting);
+            }
+            else
+            {
+                publish_level(resting->side, *level);
+            }
+        }
+        return count;
+    }
+
+    template <typename Levels>
+    SubmitResult BasicOrderBook<Levels>::submit_order(std::shared_ptr<Order> order, std::vector<Match> &matches)
+    {
+        prepare_order(*order);
+
+        BookLock lock(*this);
+        SubmitResult result;
+
+        if (!lock || orders_.find(order->order_id) != orders_.end())
+            return result;
+        result.accepted = true;
+        journal(JournalType::Submit, *order, order->order_qty, order->price_ticks);
+        publish(EventType::Ack, *order, order->order_qty);
+
+        const int filled = order->filled_qty;
+        result.match_count = cross(*order, matches);
+        result.filled_qty = order->filled_qty - filled;
+
+        if (!order->is_complete() && order->order_type == '1')
+        {
+            // Market orders never rest; the unfilled remainder is canceled
+            order->status = '4';
+            publish(EventType::Cancel, *order, order->order_qty);
+        }
+        else if (!order->is_complete())
+        {
+            orders_.emplace(order->order_id, order);
+            rest(order);
+            result.resting = true;
+        }
+
+        publish_top();
+        return result;
+    }
+
+    template <typename Levels>
+    std::size_t BasicOrderBook<Levels>::match_orders(std::vector<Match> &matches)
+    {
+        BookLock lock(*this);
+        if (!lock)
+            return 0;
+        return match_locked([&](const Match &match)
+                            { matches.push_back(match); });
+    }
+
+    template <typename Levels>
+    std::size_t BasicOrderBook<Levels>::match()
+    {
+        BookLock lock(*this);
+        if (!lock)
+            return 0;
+        return match_locked([](const Match &) {});
+    }
+
+    template <typename Levels>
+    template <typename OnMatch>
+    std::size_t BasicOrderBook<Levels>::match_locked(OnMatch &&on_match)
+    {
+        std::size_t count = 0;
+
+        while (true)
+        {
+            // Get best bid and ask; levels are dropped as soon as they empty
+            PriceLevel *best_buy_level = buy_levels_.best();
+            PriceLevel *best_sell_level = sell_levels_.best();
+            if (!best_buy_level || !best_sell_level)
+                break;
+
+            Order *buy_order = best_buy_level->front();
+            Order *sell_order = best_sell_level->front();
+
+            // Check if prices cross
+            bool can_match = false;
+            Price match_price = 0;
+
+            if (buy_order->order_type == '1')
+            { // Market buy
+                can_match = true;
+                match_price = sell_order->price_ticks;
+            }
+            else if (sell_order->order_type == '1')
+            { // Market sell
+                can_match = true;
+                match_price = buy_order->price_ticks;
+            }
+            else if (buy_order->price_ticks >= sell_order->price_ticks)
+            {
+                can_match = true;
+                match_price = sell_order->price_ticks; // Price improvement for buyer
+            }
+
+            if (!can_match)
+                break; // No more matches possible
+
+            // Execute match
+            int match_qty = std::min(buy_order->remaining_qty(), sell_order->remaining_qty());
+
+            buy_order->filled_qty += match_qty;
+            sell_order->filled_qty += match_qty;
+            best_buy_level->reduce(match_qty);
+            best_sell_level->reduce(match_qty);
+
+            buy_order->status = buy_order->is_complete() ? '2' : '1';
+            sell_order->status = sell_order->is_complete() ? '2' : '1';
+
+            // Record match
+            on_match({buy_order->order_id,
+                      sell_order->order_id,
+                      match_qty,
+                      match_price,
+                      to_price(match_price),
+                      wall_clock()});
+            publish(EventType::Fill, *buy_order, match_qty, sell_order->order_id);
+            publish(EventType::Fill, *sell_order, match_qty, buy_order->order_id);
+            publish_l3(L3Type::Execute, *buy_order, match_qty, match_price);
+            publish_l3(L3Type::Execute, *sell_order, match_qty, match_price);
+            record_trade(match_price, match_qty);
+            ++count;
+
+            // Remove completed orders; a partially filled one leaves a smaller level
+            if (buy_order->is_complete())
+            {
+                remove_resting(*buy_order);
+            }
+            else
+            {
+                publish_level('1', *best_buy_level);
+            }
+            if (sell_order->is_complete())
+            {
+                remove_resting(*sell_order);
+            }
+            else
+            {
+                publish_level('2', *best_sell_level);
+            }
+        }
+
+        if (count > 0)
+        {
+            journal_match();
+            publish_top();
+        }
+        return count;
+    }
+
+    template <typename Levels>
+    std::shared_ptr<Order> BasicOrderBook<Levels>::cancel_locked(OrderId order_id)
+    {
+        auto it = orders_.find(order_id);
+        if (it == orders_.end())
+            return nullptr;
+
+        std::shared_ptr<Order> order = it->second;
+        journal(JournalType::Cancel, *order, order->order_qty, order->price_ticks);
+        order->status = '4';
+        publish(EventType::Cancel, *order, order->order_qty);
+        publish_l3(L3Type::Delete, *order, order->remaining_qty(), order->price_ticks);
+        remove_resting(*order);
+        publish_top();
+        return order;
+    }
+
+    template <typename Levels>
+    std::shared_ptr<Order> BasicOrderBook<Levels>::cancel_order(OrderId order_id)
+    {
+        BookLock lock(*this);
+        if (!lock)
+            return nullptr;
+        return cancel_locked(order_id);
+    }
+
+    template <typename Levels>
+    std::shared_ptr<Order> BasicOrderBook<Levels>::cancel_by_cl_ord_id(const ClOrdId &cl_ord_id)
+    {
+        BookLock lock(*this);
+        if (!lock)
+            return nullptr;
+
+        auto it = cl_ord_ids_.find(cl_ord_id);
+        if (it == cl_ord_ids_.end())
+            return nullptr;
+        return cancel_locked(it->second->order_id);
+    }
+
+    template <typename Levels>
+    std::shared_ptr<Order> BasicOrderBook<Levels>::replace_order(OrderId order_id, int new_qty,
+                                                                 double new_price, std::vector<Match> &matches)
+    {
+        Price new_ticks = new_price > 0.0 ? to_ticks(new_price) : 0;
+
+        BookLock lock(*this);
+        if (!lock)
+            return nullptr;
+
+        auto it = orders_.find(order_id);
+        if (it == orders_.end())
+            return nullptr;
+
+        Order &order = *it->second;
+        if (new_qty <= order.filled_qty)
+            return nullptr; // Nothing would be left to rest
+        if (new_ticks == 0)
+            new_ticks = order.price_ticks;
+        journal(JournalType::Replace, order, new_qty, new_ticks);
+
+        if (new_ticks == order.price_ticks && new_qty <= order.order_qty)
+        {
+            // Quantity down at the same price keeps its place in the queue
+            order.level->reduce(order.order_qty - new_qty);
+            order.order_qty = new_qty;
+            publish(EventType::Replace, order, new_qty);
+            publish_l3(L3Type::Modify, order, order.remaining_qty(), order.price_ticks);
+            publish_level(order.side, *order.level);
+            publish_top();
+            return it->second;
+        }
+
+        std::shared_ptr<Order> replaced = it->second; // forget may drop the index's reference
+        publish_l3(L3Type::Delete, order, order.remaining_qty(), order.price_ticks);
+        unlink(order);
+        order.order_qty = new_qty;
+        order.price_ticks = new_ticks;
+        order.price = to_price(new_ticks);
+        publish(EventType::Replace, order, new_qty);
+
+        // Requeued behind the new level, so it trades like a new order if it now crosses
+        cross(order, matches);
+        if (order.is_complete())
+        {
+            forget(order);
+        }
+        else
+        {
+            PriceLevel &level = levels_for(order).get_or_create(new_ticks);
+            level.add_order(&order);
+            publish_l3(L3Type::Add, order, order.remaining_qty(), new_ticks);
+            publish_level(order.side, level);
+        }
+        publish_top();
+        return replaced;
+    }
+
+    template <typename Levels>
+    std::shared_ptr<Order> BasicOrderBook<Levels>::find_order(OrderId order_id) const
+    {
+        BookLock lock(*this);
+        if (!lock)
+            return nullptr;
+
+        auto it = orders_.find(order_id);
+        return it == orders_.end() ? nullptr : it->second;
+    }
+
+    template <typename Levels>
+    std::shared_ptr<Order> BasicOrderBook<Levels>::find_by_cl_ord_id(const ClOrdId &cl_ord_id) const
+    {
+        BookLock lock(*this);
+        if (!lock)
+            return nullptr;
+
+        auto it = cl_ord_ids_.find(cl_ord_id);
+        if (it == cl_ord_ids_.end())
+            return nullptr;
+        return orders_.find(it->second->order_id)->second;
+    }
+
+    template <typename Levels>
+    std::map<double, int> BasicOrderBook<Levels>::get_buy_depth() const
+    {
+        BookLock lock(*this);
+        std::map<double, int> depth;
+        if (!lock)
+            return depth;
+
+        buy_levels_.for_each([&](const PriceLevel &level)
+                             { depth[to_price(level.price)] = level.size(); return true; });
+        return depth;
+    }
+
+    template <typename Levels>
+    std::map<double, int> BasicOrderBook<Levels>::get_sell_depth() const
+    {
+        BookLock lock(*this);
+        std::map<double, int> depth;
+        if (!lock)
+            return depth;
+
+        sell_levels_.for_each([&](const PriceLevel &level)
+                              { depth[to_price(level.price)] = level.size(); return true; });
+        return depth;
+    }
+
+    template <typename Levels>
+    template <typename Out>
+    void BasicOrderBook<Levels>::depth_locked(const Levels &levels, std::size_t max_levels, Out &&out) const
+    {
+        std::size_t count = 0;
+        if (max_levels == 0)
+            return;
+
+        levels.for_each([&](const PriceLevel &level)
+                        {
+                            out(DepthLevel{level.price, to_price(level.price), level.quantity(), level.size()});
+                            return ++count < max_levels; });
+    }
+
+    template <typename Levels>
+    std::size_t BasicOrderBook<Levels>::get_depth(char side, DepthLevel *out, std::size_t max_levels) const
+    {
+        BookLock lock(*this);
+        std::size_t count = 0;
+        if (!lock)
+            return count;
+
+        depth_locked(side == '1' ? buy_levels_ : sell_levels_, max_levels,
+                     [&](const DepthLevel &level)
+                     { out[count++] = level; });
+        return count;
+    }
+
+    template <typename Levels>
+    BookSnapshot BasicOrderBook<Levels>::snapshot(std::size_t max_levels) const
+    {
+        BookSnapshot snapshot;
+        BookLock lock(*this);
+        if (!lock)
+            return snapshot;
+
+        snapshot.sequence = level_sequence_;
+        depth_locked(buy_levels_, max_levels, [&](const DepthLevel &level)
+                     { snapshot.bids.push_back(level); });
+        depth_locked(sell_levels_, max_levels, [&](const DepthLevel &level)
+                     { snapshot.asks.push_back(level); });
+        return snapshot;
+    }
+
+    template <typename Levels>
+    void BasicOrderBook<Levels>::capture(BookImage &image) const
+    {
+        BookLock lock(*this);
+
+        image.symbol = symbol_;
+        image.header = SnapshotBook{};
+        image.orders.clear();
+        if (!lock)
+            return;
+        image.header.journal_sequence = journal_ ? journal_->last_sequence() : 0;
+        image.header.last_ticks = top_state_.last_ticks;
+        image.header.last_qty = top_state_.last_qty;
+        image.header.tick_size = tick_size_;
+        image.header.symbol_size = static_cast<std::uint32_t>(symbol_.size());
+        image.orders.reserve(orders_.size());
+
+        auto copy_level = [&](const PriceLevel &level)
+        {
+            for (const Order *order = level.front(); order; order = order->next)
+            {
+                SnapshotOrder &record = image.orders.emplace_back();
+                record = SnapshotOrder{};
+                record.order_id = order->order_id;
+                record.price_ticks = order->price_ticks;
+                record.timestamp = order->timestamp;
+                record.order_qty = order->order_qty;
+                record.filled_qty = order->filled_qty;
+                record.side = order->side;
+                record.order_type = order->order_type;
+                record.status = order->status;
+                record.cl_ord_id_size = static_cast<std::uint8_t>(order->cl_ord_id.size());
+                std::memcpy(record.cl_ord_id, order->cl_ord_id.view().data(), order->cl_ord_id.size());
+            }
+            return true;
+        };
+        buy_levels_.for_each(copy_level);
+        sell_levels_.for_each(copy_level);
+        image.header.order_count = image.orders.size();
+    }
+
+    template <typename Levels>
+    std::size_t BasicOrderBook<Levels>::restore(const SnapshotBook &header, const SnapshotOrder *orders)
+    {
+        BookLock lock(*this);
+        if (!lock)
+            return 0;
+
+        // Sized once, so the rebuild never rehashes
+        orders_.reserve(orders_.size() + header.order_count);
+        cl_ord_ids_.reserve(cl_ord_ids_.size() + header.order_count);
+        std::size_t rested = 0;
+
+        for (std::uint64_t i = 0; i < header.order_count; ++i)
+        {
+            const SnapshotOrder &record = orders[i];
+            auto order = std::allocate_shared<Order>(
+                order_allocator_, record.order_id,
+                ClOrdId(std::string_view(record.cl_ord_id, record.cl_ord_id_size)), record.side,
+                record.order_qty, record.order_type, to_price(record.price_ticks), record.timestamp);
+            order->price_ticks = record.price_ticks;
+            order->filled_qty = record.filled_qty;
+            order->status = record.status;
+            order->symbol_id = symbol_id_;
+            if (!orders_.try_emplace(order->order_id, order).second)
+                continue;
+            rest(order);
+            ++rested;
+        }
+        if (header.last_qty > 0)
+            record_trade(header.last_ticks, static_cast<int>(header.last_qty));
+        publish_top();
+        return rested;
+    }
+
+    template class BasicOrderBook<MapBookSide>;
+    template class BasicOrderBook<LadderBookSide>;
+
+    std::shared_ptr<OrderBook> make_order_book(const std::string &symbol, const BookConfig &config,
+                                               SymbolId symbol_id, std::shared_ptr<OrderIdSequence> order_ids)
+    {
+        if (config.book_type == BookType::Ladder)
+            return std::make_shared<LadderOrderBook>(symbol, symbol_id, config, std::move(order_ids));
+        return std::make_shared<MapOrderBook>(symbol, symbol_id, config, std::move(order_ids));
+    }
+
+    // MatchingEngine implementation
+    MatchingEngine::~MatchingEngine()
+    {
+        stop_shards();
+        if (snapshot_writer_.joinable())
+            snapshot_writer_.join(); // The snapshot still lands; its outcome is dropped
+    }
+
+    bool MatchingEngine::configure_symbol(const std::string &symbol, const BookConfig &config)
+    {
+        if (!is_valid_config(config))
+            return false;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (find_book(symbols_.find(symbol)))
+            return false; // Tick size and layout cannot change under resting orders
+        book_configs_[symbol] = config;
+        return true;
+    }
+
+    bool MatchingEngine::set_default_config(const BookConfig &config)
     {
+        if (!is_valid_config(config))
+            return false;
+
         std::lock_guard<std::mutex> lock(mutex_);
+        default_config_ = config;
+        return true;
+    }
+
+    std::shared_ptr<Order> MatchingEngine::create_order(const std::string &symbol, const ClOrdId &cl_ord_id,
+                                                        char side, int qty, char order_type, double price,
+                                                        double timestamp)
+    {
+        return get_or_create_book(symbol)->create_order(cl_ord_id, side, qty, order_type, price, timestamp);
+    }
+
+    bool MatchingEngine::add_order(const std::string &symbol, std::shared_ptr<Order> order)
+    {
+        auto book = get_or_create_book(symbol);
+        return book->add_order(order);
+    }
+
+    bool MatchingEngine::add_order(SymbolId symbol_id, std::shared_ptr<Order> order)
+    {
+        auto book = get_book(symbol_id);
+        if (!book)
+            return false;
+        return book->add_order(order);
+    }
+
+    std::vector<Match> MatchingEngine::match_orders(const std::string &symbol)
+    {
+        auto book = get_book(symbol);
+        if (!book)
+            return {};
+        return book->match_orders();
+    }
+
+    std::size_t MatchingEngine::match_orders(SymbolId symbol_id, std::vector<Match> &matches)
+    {
+        auto book = get_book(symbol_id);
+        if (!book)
+            return 0;
+        return book->match_orders(matches);
+    }
+
+    std::size_t MatchingEngine::match(const std::string &symbol)
+    {
+        auto book = get_book(symbol);
+        if (!book)
+            return 0;
+        return book->match();
+    }
+
+    std::size_t MatchingEngine::match(SymbolId symbol_id)
+    {
+        auto book = get_book(symbol_id);
+        if (!book)
+            return 0;
+        return book->match();
+    }
+
+    SubmitResult MatchingEngine::submit_order(const std::string &symbol, std::shared_ptr<Order> order,
+                                              std::vector<Match> &matches)
+    {
+        return get_or_create_book(symbol)->submit_order(std::move(order), matches);
+    }
+
+    SubmitResult MatchingEngine::submit_order(SymbolId symbol_id, std::shared_ptr<Order> order,
+                                              std::vector<Match> &matches)
+    {
+        auto book = get_book(symbol_id);
+        if (!book)
+            return SubmitResult();
+        return book->submit_order(std::move(order), matches);
+    }
+
+    std::size_t MatchingEngine::submit_batch(const BatchOrder *orders, std::size_t count,
+                                             std::vector<Match> &matches)
+    {
+        std::shared_ptr<OrderBook> book;
+        std::size_t accepted = 0;
 
-        double price = order->price;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const BatchOrder &record = orders[i];
+            if (!book || book->symbol_id() != record.symbol_id)
+            {
+                book = get_book(record.symbol_id);
+                if (!book)
+                    continue;
+            }
 
-        if (order->side == '1')
-        { // Buy order
-            if (buy_levels_.find(price) == buy_levels_.end())
+            ClOrdId cl_ord_id(std::string_view(record.cl_ord_id, strnlen(record.cl_ord_id, ClOrdId::capacity)));
+            auto order = book->create_order(cl_ord_id, record.side, record.qty, record.order_type,
+                                            record.price, record.timestamp);
+            if (record.order_id != 0)
+            {
+                order->order_id = record.order_id;
+            }
+            if (book->submit_order(std::move(order), matches).accepted)
             {
-                buy_levels_[price] = std::make_shared<PriceLevel>(price);
+                ++accepted;
             }
-            buy_levels_[price]->add_order(order);
         }
-        else
-        { // Sell order
-            if (sell_levels_.find(price) == sell_levels_.end())
+        return accepted;
+    }
+
+    std::size_t MatchingEngine::cancel_batch(const BatchCancel *cancels, std::size_t count)
+    {
+        std::shared_ptr<OrderBook> book;
+        std::size_t canceled = 0;
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (!book || book->symbol_id() != cancels[i].symbol_id)
+            {
+                book = get_book(cancels[i].symbol_id);
+                if (!book)
+                    continue;
+            }
+            if (book->cancel_order(cancels[i].order_id))
             {
-                sell_levels_[price] = std::make_shared<PriceLevel>(price);
+                ++canceled;
             }
-            sell_levels_[price]->add_order(order);
         }
+        return canceled;
     }
 
-    std::vector<Match> OrderBook::match_orders()
+    bool MatchingEngine::start_shards(std::size_t shard_count, bool pin_threads, std::size_t queue_capacity)
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        std::vector<Match> matches;
 
-        while (!buy_levels_.empty() && !sell_levels_.empty())
+        if (shard_count == 0 || shards_running_.load(std::memory_order_relaxed))
+            return false;
+
+        // Existing books change owner before any shard can reach them; each flip
+        // waits out a caller still inside the book
+        for (SymbolId id = 0; id < symbols_.size(); ++id)
+        {
+            if (OrderBook *book = find_book(id))
+                book->set_single_writer(true);
+        }
+
+        std::unique_lock<std::shared_mutex> shards_lock(shard_mutex_);
+        shards_.clear();
+        for (std::size_t i = 0; i < shard_count; ++i)
+        {
+            shards_.push_back(std::make_unique<Shard>(queue_capacity));
+        }
+        shards_running_.store(true, std::memory_order_release); // Before the threads, which exit once it drops
+
+        for (std::size_t i = 0; i < shard_count; ++i)
+        {
+            Shard &shard = *shards_[i];
+            shard.thread = std::thread([this, &shard]
+                                       { run_shard(shard); });
+            if (pin_threads)
+                pin_to_core(shard.thread, i);
+        }
+        return true;
+    }
+
+    void MatchingEngine::stop_shards()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        {
+            // Once the flag drops no post can succeed, so the shards see every accepted one
+            std::unique_lock<std::shared_mutex> shards_lock(shard_mutex_);
+            if (!shards_running_.load(std::memory_order_relaxed))
+                return;
+            shards_running_.store(false, std::memory_order_release);
+        }
+
+        for (auto &shard : shards_)
+        {
+            if (shard->thread.joinable())
+                shard->thread.join();
+        }
+
+        for (SymbolId id = 0; id < symbols_.size(); ++id)
         {
-            // Get best bid and ask
-            auto &best_buy_level = buy_levels_.begin()->second;
-            auto &best_sell_level = sell_levels_.begin()->second;
+            if (OrderBook *book = find_book(id))
+                book->set_single_writer(false);
+        }
+    }
 
-            // Clean up empty levels
-            if (best_buy_level->is_empty())
+    void MatchingEngine::run_shard(Shard &shard)
+    {
+        std::vector<Match> matches; // Reused; fills reach consumers as events
+        ShardCommand command;
+        unsigned idle = 0;
+        OrderBook::set_shard_thread(true);
+
+        while (true)
+        {
+            if (!shard.queue.try_pop(command))
             {
-                buy_levels_.erase(buy_levels_.begin());
+                if (shards_running_.load(std::memory_order_acquire))
+                {
+                    if (++idle > 64)
+                        std::this_thread::yield();
+                    continue;
+                }
+                // Stopping: finish whatever was posted before the flag dropped
+                if (!shard.queue.try_pop(command))
+                    break;
+            }
+            idle = 0;
+
+            OrderBook *book = find_book(command.symbol_id);
+            if (!book)
                 continue;
+
+            if (command.kind == ShardCommand::Kind::Submit)
+            {
+                matches.clear();
+                book->submit_order(std::move(command.order), matches);
             }
-            if (best_sell_level->is_empty())
+            else
             {
-                sell_levels_.erase(sell_levels_.begin());
-                continue;
+                book->cancel_order(command.order_id);
             }
+        }
+    }
+
+    bool MatchingEngine::post_order(SymbolId symbol_id, std::shared_ptr<Order> order)
+    {
+        std::shared_lock<std::shared_mutex> lock(shard_mutex_);
+        if (!shards_running_.load(std::memory_order_relaxed))
+            return false;
+
+        ShardCommand command;
+        command.kind = ShardCommand::Kind::Submit;
+        command.symbol_id = symbol_id;
+        command.order = std::move(order);
+        return shards_[symbol_id % shards_.size()]->queue.try_push(std::move(command));
+    }
+
+    bool MatchingEngine::post_cancel(SymbolId symbol_id, OrderId order_id)
+    {
+        std::shared_lock<std::shared_mutex> lock(shard_mutex_);
+        if (!shards_running_.load(std::memory_order_relaxed))
+            return false;
+
+        ShardCommand command;
+        command.kind = ShardCommand::Kind::Cancel;
+        command.symbol_id = symbol_id;
+        command.order_id = order_id;
+        return shards_[symbol_id % shards_.size()]->queue.try_push(std::move(command));
+    }
+
+    template <typename Record>
+    std::size_t MatchingEngine::drain_rings(std::shared_ptr<SpscRing<Record>> BookSlot::*ring_ptr,
+                                            std::vector<Record> &records, std::size_t max_records)
+    {
+        std::size_t first = records.size();
+
+        for (SymbolId id = 0; id < symbols_.size() && records.size() - first < max_records; ++id)
+        {
+            if (!find_book(id))
+                continue;
+            SpscRing<Record> *ring = (books_[id].*ring_ptr).get();
+            if (!ring)
+                continue;
+
+            std::size_t offset = records.size();
+            std::size_t want = std::min(ring->size(), max_records - (offset - first));
+            records.resize(offset + want);
+            records.resize(offset + ring->pop(records.data() + offset, want));
+        }
+        return records.size() - first;
+    }
+
+    template <typename Record>
+    std::uint64_t MatchingEngine::rings_dropped(std::shared_ptr<SpscRing<Record>> BookSlot::*ring_ptr) const
+    {
+        std::uint64_t dropped = 0;
+        for (SymbolId id = 0; id < symbols_.size(); ++id)
+        {
+            if (find_book(id) && books_[id].*ring_ptr)
+                dropped += (books_[id].*ring_ptr)->dropped();
+        }
+        return dropped;
+    }
 
-            auto buy_order = best_buy_level->get_next_order();
-            auto sell_order = best_sell_level->get_next_order();
+    std::size_t MatchingEngine::drain_events(std::vector<EngineEvent> &events, std::size_t max_events)
+    {
+        std::lock_guard<std::mutex> drain_lock(drain_mutex_);
+        return drain_rings(&BookSlot::events, events, max_events);
+    }
+
+    std::size_t MatchingEngine::drain_l3(std::vector<L3Event> &records, std::size_t max_records)
+    {
+        std::lock_guard<std::mutex> drain_lock(l3_drain_mutex_);
+        return drain_rings(&BookSlot::l3, records, max_records);
+    }
+
+    std::size_t MatchingEngine::export_l3(const std::string &path)
+    {
+        std::unique_ptr<std::FILE, int (*)(std::FILE *)> file(std::fopen(path.c_str(), "ab"), &std::fclose);
+        if (!file)
+            throw std::runtime_error("cannot open " + path + " for L3 export");
 
-            if (!buy_order || !sell_order)
+        // Drain in chunks so the staging buffer stays small however full the rings are
+        std::vector<L3Event> records;
+        std::size_t total = 0;
+        while (true)
+        {
+            records.clear();
+            std::size_t count = drain_l3(records, 65536);
+            if (count == 0)
                 break;
+            if (std::fwrite(records.data(), sizeof(L3Event), count, file.get()) != count)
+                throw std::runtime_error("short write exporting L3 records to " + path);
+            total += count;
+        }
+        if (std::fflush(file.get()) != 0)
+            throw std::runtime_error("cannot flush L3 records to " + path);
+        return total;
+    }
 
-            // Check if prices cross
-            bool can_match = false;
-            double match_price = 0.0;
+    bool MatchingEngine::open_journal(const std::string &path, unsigned commit_interval_us)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
 
-            if (buy_order->order_type == '1')
-            { // Market buy
-                can_match = true;
-                match_price = sell_order->price;
-            }
-            else if (sell_order->order_type == '1')
-            { // Market sell
-                can_match = true;
-                match_price = buy_order->price;
-            }
-            else if (buy_order->price >= sell_order->price)
+        if (journal_ || shards_running_.load(std::memory_order_relaxed))
+            return false;
+        for (SymbolId id = 0; id < symbols_.size(); ++id)
+        {
+            if (find_book(id) && symbols_.name(id).size() > ClOrdId::capacity)
+                throw std::length_error("symbol " + symbols_.name(id) + " is too long to journal");
+        }
+
+        journal_ = std::make_shared<Journal>(path, std::chrono::microseconds(commit_interval_us));
+        for (SymbolId id = 0; id < symbols_.size(); ++id)
+        {
+            if (OrderBook *book = find_book(id))
             {
-                can_match = true;
-                match_price = sell_order->price; // Price improvement for buyer
+                journal_->append(symbol_record(id, book->symbol()));
+                book->set_journal(journal_);
             }
+        }
+        return true;
+    }
 
-            if (!can_match)
-                break; // No more matches possible
-
-            // Execute match
-            int match_qty = std::min(buy_order->remaining_qty(), sell_order->remaining_qty());
+    bool MatchingEngine::close_journal()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
 
-            buy_order->filled_qty += match_qty;
-            sell_order->filled_qty += match_qty;
+        if (!journal_ || shards_running_.load(std::memory_order_relaxed))
+            return false;
+        for (SymbolId id = 0; id < symbols_.size(); ++id)
+        {
+            if (OrderBook *book = find_book(id))
+                book->set_journal(nullptr);
+        }
+        journal_.reset(); // The last reference commits and closes the file
+        return true;
+    }
 
-            buy_order->status = buy_order->is_complete() ? '2' : '1';
-            sell_order->status = sell_order->is_complete() ? '2' : '1';
+    std::uint64_t MatchingEngine::sync_journal()
+    {
+        std::shared_ptr<Journal> journal;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            journal = journal_;
+        }
+        return journal ? journal->sync() : 0;
+    }
 
-            // Record match
-            auto now = std::chrono::system_clock::now();
-            auto timestamp = std::chrono::duration<double>(now.time_since_epoch()).count();
+    std::size_t MatchingEngine::replay(const std::string &journal_path, std::uint64_t after_sequence)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (journal_ || shards_running_.load(std::memory_order_relaxed))
+                throw std::runtime_error("replay needs the journal closed and shards stopped");
+        }
 
-            matches.push_back({buy_order->order_id,
-                               sell_order->order_id,
-                               match_qty,
-                               match_price,
-                               timestamp});
+        JournalReader reader(journal_path);
+        std::vector<std::shared_ptr<OrderBook>> books; // By the journal's symbol ids
+        std::vector<Match> matches;
+        std::size_t applied = 0;
+        OrderId last_order_id = 0;
 
-            // Remove completed orders
-            if (buy_order->is_complete())
+        for (std::uint64_t sequence = 1; sequence <= reader.size(); ++sequence)
+        {
+            const JournalRecord &record = reader.record(sequence);
+            if (record.type == JournalType::Symbol)
             {
-                best_buy_level->remove_completed();
+                // Named even before after_sequence, so later inputs resolve
+                if (books.size() <= record.symbol_id)
+                    books.resize(record.symbol_id + 1);
+                books[record.symbol_id] = get_or_create_book(std::string(record.cl_ord_id, record.cl_ord_id_size));
+                continue;
             }
-            if (sell_order->is_complete())
+            if (sequence <= after_sequence)
+                continue;
+            OrderBook *book = record.symbol_id < books.size() ? books[record.symbol_id].get() : nullptr;
+            if (!book || sequence <= books_[book->symbol_id()].restored_sequence)
+                continue;
+
+            switch (record.type)
             {
-                best_sell_level->remove_completed();
+            case JournalType::Add:
+            case JournalType::Submit:
+            {
+                auto order = book->create_order(ClOrdId(std::string_view(record.cl_ord_id, record.cl_ord_id_size)),
+                                                record.side, record.qty, record.order_type,
+                                                book->to_price(record.price_ticks), record.timestamp);
+                order->order_id = record.order_id;
+                order->price_ticks = record.price_ticks;
+                order->filled_qty = record.filled_qty;
+                order->status = record.status;
+                last_order_id = std::max(last_order_id, record.order_id);
+                if (record.type == JournalType::Add)
+                    book->add_order(std::move(order));
+                else
+                {
+                    matches.clear();
+                    book->submit_order(std::move(order), matches);
+                }
+                break;
             }
+            case JournalType::Match:
+                book->match();
+                break;
+            case JournalType::Cancel:
+                book->cancel_order(record.order_id);
+                break;
+            case JournalType::Replace:
+                book->replace_order(record.order_id, record.qty, book->to_price(record.price_ticks));
+                break;
+            default:
+                continue;
+            }
+            ++applied;
         }
-
-        return matches;
+        // Ids assigned from here on must not collide with replayed orders
+        order_ids_->advance_past(last_order_id);
+        return applied;
     }
 
-    std::map<double, int> OrderBook::get_buy_depth() const
+    bool MatchingEngine::snapshot(const std::string &path)
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        std::map<double, int> depth;
 
-        for (const auto &[price, level] : buy_levels_)
+        if (shards_running_.load(std::memory_order_relaxed) || snapshot_writing_.load(std::memory_order_acquire))
+            return false;
+        if (snapshot_writer_.joinable())
+            snapshot_writer_.join(); // Finished; its outcome is replaced by this snapshot's
+
+        // Books are copied one at a time and only that book waits; the file is
+        // written from the copies while every book keeps trading
+        const double taken_at = wall_clock();
+        std::vector<BookImage> images;
+        for (SymbolId id = 0; id < symbols_.size(); ++id)
         {
-            depth[price] = level->size();
+            if (OrderBook *book = find_book(id))
+                book->capture(images.emplace_back());
         }
-        return depth;
+
+        snapshot_orders_ = 0;
+        snapshot_error_.clear();
+        snapshot_writing_.store(true, std::memory_order_release);
+        snapshot_writer_ = std::thread(
+            [this, path, taken_at, images = std::move(images), journal = journal_]
+            {
+                try
+                {
+                    // The images name journal sequences that may not be on disk yet. A
+                    // snapshot ahead of the durable journal would, after a crash, claim
+                    // sequences the reopened journal hands out again, so wait for them.
+                    if (journal)
+                        journal->sync();
+                    snapshot_orders_ = write_snapshot(path, images, taken_at);
+                }
+                catch (const std::exception &e)
+                {
+                    snapshot_error_ = e.what();
+                }
+                snapshot_writing_.store(false, std::memory_order_release);
+            });
+        return true;
     }
 
-    std::map<double, int> OrderBook::get_sell_depth() const
+    std::size_t MatchingEngine::wait_snapshot()
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        std::map<double, int> depth;
 
-        for (const auto &[price, level] : sell_levels_)
+        if (snapshot_writer_.joinable())
+            snapshot_writer_.join();
+        if (!snapshot_error_.empty())
+            throw std::runtime_error(std::exchange(snapshot_error_, std::string()));
+        return snapshot_orders_;
+    }
+
+    std::size_t MatchingEngine::restore(const std::string &path)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (journal_ || shards_running_.load(std::memory_order_relaxed))
+                throw std::runtime_error("restore needs the journal closed and shards stopped");
+        }
+
+        SnapshotReader reader(path);
+        // Every book is resolved and checked before any order is loaded
+        std::vector<std::shared_ptr<OrderBook>> books;
+        for (const SnapshotReader::Book &image : reader.books())
         {
-            depth[price] = level->size();
+            auto book = get_or_create_book(std::string(image.symbol));
+            if (book->tick_size() != image.header->tick_size)
+                throw std::runtime_error("snapshot " + path + " holds " + book->symbol() +
+                                         " with a different tick size");
+            books.push_back(std::move(book));
         }
-        return depth;
+
+        std::size_t restored = 0;
+        OrderId last_order_id = 0;
+        for (std::size_t i = 0; i < books.size(); ++i)
+        {
+            const SnapshotReader::Book &image = reader.books()[i];
+            restored += books[i]->restore(*image.header, image.orders);
+            books_[books[i]->symbol_id()].restored_sequence = image.header->journal_sequence;
+            for (std::uint64_t j = 0; j < image.header->order_count; ++j)
+                last_order_id = std::max(last_order_id, image.orders[j].order_id);
+        }
+        // Ids assigned from here on must not collide with restored orders
+        order_ids_->advance_past(last_order_id);
+        return restored;
     }
 
-    double OrderBook::get_best_bid() const
+    std::uint64_t MatchingEngine::events_dropped() const
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (buy_levels_.empty())
-            return 0.0;
-        return buy_levels_.begin()->first;
+        return rings_dropped(&BookSlot::events);
     }
 
-    double OrderBook::get_best_ask() const
+    std::uint64_t MatchingEngine::l3_dropped() const
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (sell_levels_.empty())
-            return 0.0;
-        return sell_levels_.begin()->first;
+        return rings_dropped(&BookSlot::l3);
     }
 
-    double OrderBook::get_spread() const
+    std::shared_ptr<Order> MatchingEngine::cancel_order(const std::string &symbol, OrderId order_id)
     {
-        double bid = get_best_bid();
-        double ask = get_best_ask();
-        if (bid == 0.0 || ask == 0.0)
-            return 0.0;
-        return ask - bid;
+        auto book = get_book(symbol);
+        if (!book)
+            return nullptr;
+        return book->cancel_order(order_id);
     }
 
-    // MatchingEngine implementation
-    void MatchingEngine::add_order(const std::string &symbol, std::shared_ptr<Order> order)
+    std::shared_ptr<Order> MatchingEngine::cancel_by_cl_ord_id(const std::string &symbol,
+                                                               const ClOrdId &cl_ord_id)
     {
-        auto book = get_or_create_book(symbol);
-        book->add_order(order);
+        auto book = get_book(symbol);
+        if (!book)
+            return nullptr;
+        return book->cancel_by_cl_ord_id(cl_ord_id);
     }
 
-    std::vector<Match> MatchingEngine::match_orders(const std::string &symbol)
+    std::shared_ptr<Order> MatchingEngine::replace_order(const std::string &symbol, OrderId order_id,
+                                                         int new_qty, double new_price)
     {
         auto book = get_book(symbol);
         if (!book)
-            return {};
-        return book->match_orders();
+            return nullptr;
+        return book->replace_order(order_id, new_qty, new_price);
+    }
+
+    std::shared_ptr<Order> MatchingEngine::find_by_cl_ord_id(const std::string &symbol,
+                                                             const ClOrdId &cl_ord_id) const
+    {
+        auto book = get_book(symbol);
+        if (!book)
+            return nullptr;
+        return book->find_by_cl_ord_id(cl_ord_id);
     }
 
     std::shared_ptr<OrderBook> MatchingEngine::get_or_create_book(const std::string &symbol)
     {
+        SymbolId id = symbols_.find(symbol);
+        if (find_book(id))
+            return books_[id].owner;
+
         std::lock_guard<std::mutex> lock(mutex_);
 
-        if (order_books_.find(symbol) == order_books_.end())
+        if (journal_ && symbol.size() > ClOrdId::capacity)
+            throw std::length_error("symbol " + symbol + " is too long to journal");
+        id = symbols_.intern(symbol);
+        if (id == kInvalidSymbol)
+            throw std::length_error("symbol table full, cannot add " + symbol);
+
+        BookSlot &slot = books_[id];
+        if (!slot.book.load(std::memory_order_relaxed))
         {
-            order_books_[symbol] = std::make_shared<OrderBook>(symbol);
+            auto found = book_configs_.find(symbol);
+            const BookConfig &config = found != book_configs_.end() ? found->second : default_config_;
+            slot.owner = make_order_book(symbol, config, id, order_ids_);
+            slot.owner->set_single_writer(shards_running_.load(std::memory_order_relaxed));
+            if (config.event_capacity > 0)
+            {
+                slot.events = std::make_shared<EventRing>(config.event_capacity);
+                slot.owner->set_event_ring(slot.events);
+            }
+            if (config.l3_capacity > 0)
+            {
+                slot.l3 = std::make_shared<L3Ring>(config.l3_capacity);
+                slot.owner->set_l3_ring(slot.l3);
+            }
+            if (journal_)
+            {
+                journal_->append(symbol_record(id, symbol));
+                slot.owner->set_journal(journal_);
+            }
+            slot.book.store(slot.owner.get(), std::memory_order_release);
         }
-        return order_books_[symbol];
+        return slot.owner;
     }
 
     std::shared_ptr<OrderBook> MatchingEngine::get_book(const std::string &symbol) const
     {
-        std::lock_guard<std::mutex> lock(mutex_);
+        return get_book(symbols_.find(symbol));
+    }
+
+    std::shared_ptr<OrderBook> MatchingEngine::get_book(SymbolId symbol_id) const
+    {
+        if (!find_book(symbol_id))
+            return nullptr;
+        return books_[symbol_id].owner;
+    }
 
-        auto it = order_books_.find(symbol);
-        if (it == order_books_.end())
+    OrderBook *MatchingEngine::find_book(SymbolId symbol_id) const
+    {
+        if (symbol_id >= symbols_.capacity())
             return nullptr;
-        return it->second;
+        return books_[symbol_id].book.load(std::memory_order_acquire);
     }
 
 } // namespace crucible
@@ -1,33 +1,77 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <map>
-#include <queue>
 #include <string>
 #include <memory>
 #include <vector>
 #include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include "identifiers.hpp"
+#include "journal.hpp"
+#include "mpsc_queue.hpp"
+#include "seqlock.hpp"
+#include "snapshot.hpp"
+#include "slab_pool.hpp"
+#include "spsc_ring.hpp"
 
 namespace crucible
 {
 
-    struct Order
+    // Prices inside the engine are integer multiples of the symbol's tick size
+    using Price = std::int64_t;
+
+    // Level storage used by a symbol's book
+    enum class BookType
     {
-        std::string order_id;
-        std::string cl_ord_id;
-        std::string symbol;
-        char side; // '1' = Buy, '2' = Sell
+        Map,    // Tree of active levels, suits sparse books
+        Ladder, // Tick-indexed array around the mid, suits liquid books
+    };
+
+    // Per-symbol book configuration
+    struct BookConfig
+    {
+        double tick_size = 0.01;
+        BookType book_type = BookType::Map;
+        std::size_t ladder_levels = 4096; // Ticks covered by the ladder window
+        std::size_t order_capacity = 4096; // Orders preallocated per book
+        std::size_t level_capacity = 1024; // Tree levels preallocated per side
+        std::size_t event_capacity = 0;    // Engine events buffered per book, 0 = no event ring
+        std::size_t l3_capacity = 0;       // Order-by-order records buffered per book, 0 = no L3 feed
+    };
+
+    class PriceLevel;
+
+    // Fields the matching loop touches come first and fill one cache line;
+    // the decimal price and client id are only read at the API edge
+    struct alignas(64) Order
+    {
+        // Intrusive queue links, only meaningful while the order rests in a book
+        Order *prev = nullptr;
+        Order *next = nullptr;
+        PriceLevel *level = nullptr;
+
+        OrderId order_id;
+        Price price_ticks; // Set by the book from price unless supplied by the caller
         int order_qty;
-        char order_type; // '1' = Market, '2' = Limit
-        double price;
         int filled_qty;
-        char status; // '0' = New, '1' = Partial, '2' = Filled
+        SymbolId symbol_id; // Stamped by the book the order is added to
+        char side;          // '1' = Buy, '2' = Sell
+        char order_type;    // '1' = Market, '2' = Limit
+        char status;        // '0' = New, '1' = Partial, '2' = Filled, '4' = Canceled
         double timestamp;
 
-        Order(const std::string &oid, const std::string &cloid, const std::string &sym,
-              char s, int qty, char type, double p, double ts)
-            : order_id(oid), cl_ord_id(cloid), symbol(sym), side(s),
-              order_qty(qty), order_type(type), price(p), filled_qty(0),
-              status('0'), timestamp(ts) {}
+        double price;
+        ClOrdId cl_ord_id;
+
+        Order(OrderId oid, const ClOrdId &cloid, char s, int qty, char type, double p, double ts)
+            : order_id(oid), price_ticks(0), order_qty(qty), filled_qty(0), symbol_id(kInvalidSymbol),
+              side(s), order_type(type), status('0'), timestamp(ts), price(p), cl_ord_id(cloid) {}
 
         int remaining_qty() const { return order_qty - filled_qty; }
         bool is_complete() const { return filled_qty >= order_qty; }
@@ -35,92 +79,745 @@ namespace crucible
 
     struct Match
     {
-        std::string buy_order_id;
-        std::string sell_order_id;
+        OrderId buy_order_id;
+        OrderId sell_order_id;
         int qty;
+        Price price_ticks;
+        double price;
+        double timestamp;
+    };
+
+    // Best bid/offer and last trade, republished by the book after every change.
+    // Prices of 0 mean the side is empty or nothing has traded yet.
+    struct TopOfBook
+    {
+        Price bid_ticks = 0;
+        Price ask_ticks = 0;
+        Price last_ticks = 0;
+        std::int64_t bid_qty = 0;
+        std::int64_t ask_qty = 0;
+        std::int64_t last_qty = 0;
+        std::uint64_t sequence = 0; // Number of publications, increases by one each time
+    };
+
+    // One aggregated price level, as returned by depth queries
+    struct DepthLevel
+    {
+        Price price_ticks;
         double price;
+        std::int64_t qty; // Open quantity resting at the level
+        int order_count;  // Live orders at the level
+    };
+
+    // Aggregated levels of both sides as of one point in the book's level
+    // sequence; BookUpdate events with a higher sequence apply on top of it
+    struct BookSnapshot
+    {
+        std::uint64_t sequence = 0;
+        std::vector<DepthLevel> bids; // Best first
+        std::vector<DepthLevel> asks; // Best first
+    };
+
+    // Outcome of submitting an order for continuous matching
+    struct SubmitResult
+    {
+        bool accepted = false;       // False if the order_id is resting or a shard owns the book
+        bool resting = false;        // Remainder now rests in the book
+        int filled_qty = 0;          // Quantity filled on entry
+        std::size_t match_count = 0; // Matches appended to the caller's buffer
+    };
+
+    // Flat order record for batch entry; plain data so a NumPy structured
+    // array of them can be handed over without per-order conversion
+    struct BatchOrder
+    {
+        OrderId order_id; // 0 = assigned by the book
+        double price;
+        double timestamp;
+        SymbolId symbol_id;
+        std::int32_t qty;
+        char side;
+        char order_type;
+        char cl_ord_id[ClOrdId::capacity]; // Zero-padded
+    };
+
+    struct BatchCancel
+    {
+        OrderId order_id;
+        SymbolId symbol_id;
+    };
+
+    enum class EventType : std::uint8_t
+    {
+        Ack,        // Order accepted and resting
+        Fill,       // One side of a match, reported per order
+        Cancel,     // Order removed from the book
+        Replace,    // Quantity or price amended
+        BookUpdate, // Quantity or order count at a price level changed
+    };
+
+    // Fixed-size record written to a book's event ring. Order events carry the
+    // order's state after the event. BookUpdate is an L2 delta: the level's new
+    // total quantity and order count, with qty 0 once the level is gone, stamped
+    // with the book's level sequence so it can be applied on top of a snapshot.
+    struct EngineEvent
+    {
+        EventType type;
+        char side;
+        char status;
+        SymbolId symbol_id;
+        OrderId order_id;        // 0 for BookUpdate
+        OrderId contra_order_id; // Fill only
+        int qty;                 // Fill quantity, order quantity or level quantity
+        int leaves_qty;          // Order leaves quantity or level order count
+        Price price_ticks;
         double timestamp;
+        std::uint64_t sequence; // BookUpdate only
     };
 
-    // Price level holds orders at same price (FIFO queue)
+    using EventRing = SpscRing<EngineEvent>;
+
+    enum class L3Type : std::uint8_t
+    {
+        Add,     // Order rests: qty is its open quantity
+        Modify,  // Open quantity reduced in place, priority kept: qty is the new open quantity
+        Execute, // Resting order traded: qty is the traded quantity, price the trade price
+        Delete,  // Order left the book other than by trading
+    };
+
+    // Order-by-order market data record. Every book numbers its records with
+    // its own sequence, so a consumer can rebuild the book and detect gaps.
+    // An Execute that leaves no open quantity removes the order without a
+    // Delete; a price change or quantity increase is a Delete and an Add.
+    struct L3Event
+    {
+        std::uint64_t sequence;
+        OrderId order_id;
+        Price price_ticks;
+        double timestamp;
+        SymbolId symbol_id;
+        std::int32_t qty;
+        L3Type type;
+        char side;
+    };
+
+    using L3Ring = SpscRing<L3Event>;
+
+    // Price level holds orders at same price as an intrusive FIFO list,
+    // so any order can be unlinked in O(1) and size() only counts live orders.
+    // quantity() is the resting quantity; fills and amends to a linked order
+    // must go through reduce() to keep it current.
     class PriceLevel
     {
+    private:
+        Order *head_ = nullptr;
+        Order *tail_ = nullptr;
+        int count_ = 0;
+        std::int64_t quantity_ = 0;
+
     public:
-        double price;
-        std::queue<std::shared_ptr<Order>> orders;
+        Price price;
 
-        explicit PriceLevel(double p) : price(p) {}
+        PriceLevel() : price(0) {}
+        explicit PriceLevel(Price p) : price(p) {}
+        PriceLevel(const PriceLevel &) = delete;
+        PriceLevel &operator=(const PriceLevel &) = delete;
+        PriceLevel(PriceLevel &&other) noexcept : price(other.price) { *this = std::move(other); }
 
-        void add_order(std::shared_ptr<Order> order)
+        // Takes over the other level's queue and re-points its orders here
+        PriceLevel &operator=(PriceLevel &&other) noexcept
         {
-            orders.push(order);
+            price = other.price;
+            head_ = std::exchange(other.head_, nullptr);
+            tail_ = std::exchange(other.tail_, nullptr);
+            count_ = std::exchange(other.count_, 0);
+            quantity_ = std::exchange(other.quantity_, 0);
+            for (Order *order = head_; order; order = order->next)
+                order->level = this;
+            return *this;
         }
 
-        std::shared_ptr<Order> get_next_order()
+        void add_order(Order *order)
+        {
+            order->prev = tail_;
+            order->next = nullptr;
+            order->level = this;
+            if (tail_)
+                tail_->next = order;
+            else
+                head_ = order;
+            tail_ = order;
+            ++count_;
+            quantity_ += order->remaining_qty();
+        }
+
+        void remove_order(Order *order)
+        {
+            if (order->prev)
+                order->prev->next = order->next;
+            else
+                head_ = order->next;
+            if (order->next)
+                order->next->prev = order->prev;
+            else
+                tail_ = order->prev;
+            order->prev = order->next = nullptr;
+            order->level = nullptr;
+            --count_;
+            quantity_ -= order->remaining_qty();
+        }
+
+        // A linked order's remaining quantity dropped by qty
+        void reduce(int qty) { quantity_ -= qty; }
+
+        Order *front() const { return head_; }
+        bool is_empty() const { return head_ == nullptr; }
+        int size() const { return count_; }
+        std::int64_t quantity() const { return quantity_; }
+    };
+
+    // Level trees draw their nodes from a per-side slab pool
+    using LevelMap = std::map<Price, PriceLevel, std::less<Price>,
+                              PoolAllocator<std::pair<const Price, PriceLevel>>>;
+
+    // One side of a book kept as a tree of active levels
+    class MapBookSide
+    {
+    private:
+        bool bids_;
+        LevelMap levels_; // Ascending; bids read from the back
+
+    public:
+        MapBookSide(bool bids, const BookConfig &config);
+
+        const PriceLevel *best() const;
+        PriceLevel *best() { return const_cast<PriceLevel *>(std::as_const(*this).best()); }
+        PriceLevel *find(Price price);
+        PriceLevel &get_or_create(Price price);
+        void erase(Price price);
+        bool empty() const { return levels_.empty(); }
+
+        // Visit levels from best to worst until fn returns false
+        template <typename Fn>
+        void for_each(Fn &&fn) const
         {
-            if (orders.empty())
-                return nullptr;
-            auto order = orders.front();
-            if (order->is_complete())
+            if (bids_)
             {
-                orders.pop();
-                return get_next_order(); // Skip completed, get next
+                for (auto it = levels_.rbegin(); it != levels_.rend(); ++it)
+                    if (!fn(it->second))
+                        return;
+            }
+            else
+            {
+                for (const auto &[price, level] : levels_)
+                    if (!fn(level))
+                        return;
             }
-            return order;
         }
+    };
 
-        void remove_completed()
+    // One side of a book kept as a contiguous tick-indexed window. A bitmap marks
+    // the occupied slots and the best slot is cached, so top-of-book is O(1).
+    // Prices outside the window (far quotes, market orders) fall back to a tree.
+    class LadderBookSide
+    {
+    private:
+        bool bids_;
+        Price base_;                         // Price of slot 0
+        std::vector<PriceLevel> slots_;      // slots_[i] holds price base_ + i
+        std::vector<std::uint64_t> occupied_;
+        std::size_t active_;                 // Occupied slot count
+        std::size_t best_slot_;              // Valid while active_ > 0
+        LevelMap overflow_;
+
+        bool in_window(Price price) const
+        {
+            return price >= base_ && price < base_ + static_cast<Price>(slots_.size());
+        }
+        bool is_occupied(std::size_t slot) const
         {
-            if (!orders.empty() && orders.front()->is_complete())
+            return (occupied_[slot >> 6] >> (slot & 63)) & 1;
+        }
+        bool better(Price a, Price b) const { return bids_ ? a > b : a < b; }
+        void recenter(Price price);
+        std::size_t next_occupied(std::size_t slot) const;
+
+    public:
+        LadderBookSide(bool bids, const BookConfig &config);
+
+        const PriceLevel *best() const;
+        PriceLevel *best() { return const_cast<PriceLevel *>(std::as_const(*this).best()); }
+        PriceLevel *find(Price price);
+        PriceLevel &get_or_create(Price price);
+        void erase(Price price);
+        bool empty() const { return active_ == 0 && overflow_.empty(); }
+
+        // Visit levels from best to worst until fn returns false, merging the
+        // window with the overflow tree. The window is walked through the bitmap
+        // from the best slot, so a top-N walk costs N levels, not the window size.
+        template <typename Fn>
+        void for_each(Fn &&fn) const
+        {
+            const Price top = base_ + static_cast<Price>(slots_.size());
+            if (bids_)
+            {
+                auto it = overflow_.rbegin();
+                for (; it != overflow_.rend() && it->first >= top; ++it)
+                    if (!fn(it->second))
+                        return;
+                std::size_t slot = best_slot_;
+                for (std::size_t seen = 0; seen < active_; ++seen, --slot)
+                {
+                    slot = next_occupied(slot);
+                    if (!fn(slots_[slot]))
+                        return;
+                }
+                for (; it != overflow_.rend(); ++it)
+                    if (!fn(it->second))
+                        return;
+            }
+            else
             {
-                orders.pop();
+                auto it = overflow_.begin();
+                for (; it != overflow_.end() && it->first < base_; ++it)
+                    if (!fn(it->second))
+                        return;
+                std::size_t slot = best_slot_;
+                for (std::size_t seen = 0; seen < active_; ++seen, ++slot)
+                {
+                    slot = next_occupied(slot);
+                    if (!fn(slots_[slot]))
+                        return;
+                }
+                for (; it != overflow_.end(); ++it)
+                    if (!fn(it->second))
+                        return;
             }
         }
-
-        bool is_empty() const { return orders.empty(); }
-        int size() const { return orders.size(); }
     };
 
-    // Order book for one symbol
+    // Order book for one symbol. While a matching shard owns the book, calls
+    // from any other thread are refused: inputs are not accepted and queries
+    // come back empty. Top-of-book reads stay available from every thread.
     class OrderBook
     {
-    private:
+    protected:
         std::string symbol_;
-        // Buy side: highest price first (descending)
-        std::map<double, std::shared_ptr<PriceLevel>, std::greater<double>> buy_levels_;
-        // Sell side: lowest price first (ascending)
-        std::map<double, std::shared_ptr<PriceLevel>> sell_levels_;
+        SymbolId symbol_id_;
+        double tick_size_;
+        std::shared_ptr<OrderIdSequence> order_ids_;
+        PoolAllocator<Order> order_allocator_;
+        std::shared_ptr<EventRing> events_; // Optional, written under mutex_
         mutable std::mutex mutex_;
+        std::atomic<bool> single_writer_{false};
+        static inline thread_local bool shard_thread_ = false; // Set on matching shard threads
+        SeqLock<TopOfBook> top_;
+        TopOfBook top_state_; // Writer's copy of what top_ holds, guarded like the book
+        std::uint64_t level_sequence_ = 0; // Last BookUpdate sequence, guarded like the book
+        std::shared_ptr<L3Ring> l3_;       // Optional, written under mutex_
+        std::uint64_t l3_sequence_ = 0;    // Last L3 sequence, guarded like the book
+        std::shared_ptr<Journal> journal_; // Optional, appended to under mutex_
+
+        // Takes mutex_ unless the book is owned by a single shard thread. While a
+        // shard owns the book other threads are refused and the lock tests false.
+        class BookLock
+        {
+        private:
+            std::mutex *mutex_ = nullptr;
+            bool held_ = true;
+
+        public:
+            explicit BookLock(const OrderBook &book)
+            {
+                if (book.single_writer_.load(std::memory_order_relaxed))
+                {
+                    held_ = shard_thread_;
+                    return;
+                }
+                book.mutex_.lock();
+                // The flag only flips under mutex_, so it cannot change while held
+                if (book.single_writer_.load(std::memory_order_relaxed))
+                {
+                    book.mutex_.unlock();
+                    held_ = false;
+                    return;
+                }
+                mutex_ = &book.mutex_;
+            }
+            ~BookLock()
+            {
+                if (mutex_)
+                    mutex_->unlock();
+            }
+            BookLock(const BookLock &) = delete;
+            BookLock &operator=(const BookLock &) = delete;
+
+            explicit operator bool() const { return held_; }
+        };
+
+        // Stamp book-owned fields and snap the order onto the tick grid once;
+        // the book only compares integers from here on
+        void prepare_order(Order &order) const;
+        void publish(EventType type, const Order &order, int qty, OrderId contra_order_id = 0);
+        void publish_level(char side, const PriceLevel &level);
+        void publish_l3(L3Type type, const Order &order, int qty, Price price_ticks);
+        // Records an accepted input; qty and price_ticks are the order's unless a replace changes them
+        void journal(JournalType type, const Order &order, int qty, Price price_ticks);
+        void journal_match();
+        // Republish top_ from the current best levels; call once per mutation, not per fill
+        void publish_top(const PriceLevel *best_bid, const PriceLevel *best_ask);
+        void record_trade(Price price_ticks, int qty);
 
     public:
-        explicit OrderBook(const std::string &symbol) : symbol_(symbol) {}
+        OrderBook(const std::string &symbol, SymbolId symbol_id, const BookConfig &config,
+                  std::shared_ptr<OrderIdSequence> order_ids)
+            : symbol_(symbol), symbol_id_(symbol_id), tick_size_(config.tick_size),
+              order_ids_(order_ids ? std::move(order_ids) : std::make_shared<OrderIdSequence>()),
+              order_allocator_(std::make_shared<SlabPool>(config.order_capacity)) {}
+        virtual ~OrderBook() = default;
+
+        // Allocates an order with a fresh order_id from this book's slab pool
+        std::shared_ptr<Order> create_order(const ClOrdId &cl_ord_id, char side, int qty, char order_type,
+                                            double price, double timestamp);
 
-        void add_order(std::shared_ptr<Order> order);
+        // Assigns an order_id if the order has none. Returns false if an order
+        // with the same order_id is already resting
+        virtual bool add_order(std::shared_ptr<Order> order) = 0;
         std::vector<Match> match_orders();
+        // Appends fills to a caller-owned buffer so a reused buffer never reallocates
+        virtual std::size_t match_orders(std::vector<Match> &matches) = 0;
+        // Matches without building Match records; fills only reach the event ring
+        virtual std::size_t match() = 0;
+        // Continuous matching: crosses the order against the opposite side at the
+        // resting orders' prices, then rests any limit remainder. A market order's
+        // unfilled remainder is canceled rather than rested, and a market order
+        // left resting by add_order is canceled when an incoming market order meets it.
+        virtual SubmitResult submit_order(std::shared_ptr<Order> order, std::vector<Match> &matches) = 0;
+
+        // Routes this book's events into ring; nullptr turns events off
+        void set_event_ring(std::shared_ptr<EventRing> ring);
+        // Routes this book's order-by-order feed into ring; nullptr turns it off
+        void set_l3_ring(std::shared_ptr<L3Ring> ring);
+        // Appends every accepted input to journal; nullptr turns journaling off
+        void set_journal(std::shared_ptr<Journal> journal);
+        // A single-writer book skips its mutex and only shard threads may use it.
+        // The flag flips under the mutex, so a caller already inside finishes first.
+        void set_single_writer(bool single_writer)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            single_writer_.store(single_writer, std::memory_order_relaxed);
+        }
+        // Marks the calling thread as a matching shard, which owns single-writer books
+        static void set_shard_thread(bool shard_thread) { shard_thread_ = shard_thread; }
+
+        // Cancel and cancel/replace return the affected order, or nullptr if it is not resting.
+        // A replace that only lowers the quantity keeps queue priority; a price change or a
+        // quantity increase requeues the order. new_price <= 0 keeps the current price.
+        // A requeued order that crosses the spread trades at once, as submit_order
+        // would, and its fills are appended to matches.
+        virtual std::shared_ptr<Order> cancel_order(OrderId order_id) = 0;
+        virtual std::shared_ptr<Order> cancel_by_cl_ord_id(const ClOrdId &cl_ord_id) = 0;
+        virtual std::shared_ptr<Order> replace_order(OrderId order_id, int new_qty, double new_price,
+                                                     std::vector<Match> &matches) = 0;
+        std::shared_ptr<Order> replace_order(OrderId order_id, int new_qty, double new_price);
+        virtual std::shared_ptr<Order> find_order(OrderId order_id) const = 0;
+        virtual std::shared_ptr<Order> find_by_cl_ord_id(const ClOrdId &cl_ord_id) const = 0;
+
+        // Tick conversion at the API edge
+        Price to_ticks(double price) const;
+        double to_price(Price ticks) const { return ticks * tick_size_; }
+        double tick_size() const { return tick_size_; }
+        const std::string &symbol() const { return symbol_; }
+        SymbolId symbol_id() const { return symbol_id_; }
+
+        // Getters for order book state; the maps hold the live order count per level
+        virtual std::map<double, int> get_buy_depth() const = 0;
+        virtual std::map<double, int> get_sell_depth() const = 0;
+        // Copies up to max_levels of one side ('1' = bids, '2' = asks), best first,
+        // into out and returns the count. Level totals are kept incrementally, so
+        // this costs the levels copied rather than a walk of the whole book.
+        virtual std::size_t get_depth(char side, DepthLevel *out, std::size_t max_levels) const = 0;
+        std::vector<DepthLevel> get_depth(char side, std::size_t max_levels) const;
+        // Both sides, up to max_levels each, with the level sequence they reflect
+        virtual BookSnapshot snapshot(std::size_t max_levels = SIZE_MAX) const = 0;
+        // Copies every resting order, in priority order, and the last trade into
+        // image under one hold of the book lock. The image records the last
+        // journal sequence, which covers every input this book applied; that
+        // sequence may not be durable yet, so a writer must sync the journal first.
+        virtual void capture(BookImage &image) const = 0;
+        // Rests a captured book's orders in array order under one hold of the
+        // lock, without journaling them, and restores its last trade. Orders
+        // whose order_id is already resting are skipped; returns the count rested.
+        virtual std::size_t restore(const SnapshotBook &header, const SnapshotOrder *orders) = 0;
 
-        // Getters for order book state
-        std::map<double, int> get_buy_depth() const;
-        std::map<double, int> get_sell_depth() const;
+        // Top-of-book reads go through the seqlock: they never take the book
+        // mutex and are safe from any thread, including while sharded
+        TopOfBook top_of_book() const { return top_.load(); }
+        Price get_best_bid_ticks() const { return top_.load().bid_ticks; }
+        Price get_best_ask_ticks() const { return top_.load().ask_ticks; }
         double get_best_bid() const;
         double get_best_ask() const;
         double get_spread() const;
     };
 
-    // Main matching engine
+    // Price-time priority book over a level container (MapBookSide or LadderBookSide)
+    template <typename Levels>
+    class BasicOrderBook final : public OrderBook
+    {
+    private:
+        Levels buy_levels_;  // Highest price first
+        Levels sell_levels_; // Lowest price first
+        template <typename Key, typename Value, typename Hash>
+        using Index = std::unordered_map<Key, Value, Hash, std::equal_to<Key>,
+                                         PoolAllocator<std::pair<const Key, Value>>>;
+
+        // Resting orders by order_id; the index owns them while the levels link them
+        Index<OrderId, std::shared_ptr<Order>, std::hash<OrderId>> orders_;
+        // Latest resting order per cl_ord_id
+        Index<ClOrdId, Order *, FixedStringHash<ClOrdId::capacity>> cl_ord_ids_;
+
+        Levels &levels_for(const Order &order) { return order.side == '1' ? buy_levels_ : sell_levels_; }
+        void unlink(Order &order);
+        void remove_resting(Order &order);
+        // Drops an unlinked order from the indexes
+        void forget(Order &order);
+        void rest(const std::shared_ptr<Order> &order);
+        void publish_top() { OrderBook::publish_top(buy_levels_.best(), sell_levels_.best()); }
+        std::shared_ptr<Order> cancel_locked(OrderId order_id);
+        // Trades order against the opposite side at the resting orders' prices
+        // until it fills or stops crossing; returns the matches appended
+        std::size_t cross(Order &order, std::vector<Match> &matches);
+        template <typename Out>
+        void depth_locked(const Levels &levels, std::size_t max_levels, Out &&out) const;
+        template <typename OnMatch>
+        std::size_t match_locked(OnMatch &&on_match);
+
+    public:
+        BasicOrderBook(const std::string &symbol, SymbolId symbol_id, const BookConfig &config,
+                       std::shared_ptr<OrderIdSequence> order_ids);
+
+        bool add_order(std::shared_ptr<Order> order) override;
+        using OrderBook::match_orders;
+        std::size_t match_orders(std::vector<Match> &matches) override;
+        std::size_t match() override;
+        SubmitResult submit_order(std::shared_ptr<Order> order, std::vector<Match> &matches) override;
+
+        std::shared_ptr<Order> cancel_order(OrderId order_id) override;
+        std::shared_ptr<Order> cancel_by_cl_ord_id(const ClOrdId &cl_ord_id) override;
+        using OrderBook::replace_order;
+        std::shared_ptr<Order> replace_order(OrderId order_id, int new_qty, double new_price,
+                                             std::vector<Match> &matches) override;
+        std::shared_ptr<Order> find_order(OrderId order_id) const override;
+        std::shared_ptr<Order> find_by_cl_ord_id(const ClOrdId &cl_ord_id) const override;
+
+        std::map<double, int> get_buy_depth() const override;
+        std::map<double, int> get_sell_depth() const override;
+        using OrderBook::get_depth;
+        std::size_t get_depth(char side, DepthLevel *out, std::size_t max_levels) const override;
+        BookSnapshot snapshot(std::size_t max_levels = SIZE_MAX) const override;
+        void capture(BookImage &image) const override;
+        std::size_t restore(const SnapshotBook &header, const SnapshotOrder *orders) override;
+    };
+
+    using MapOrderBook = BasicOrderBook<MapBookSide>;
+    using LadderOrderBook = BasicOrderBook<LadderBookSide>;
+
+    // Creates the book implementation selected by config.book_type. Books made
+    // outside an engine get symbol id 0 and their own order id sequence.
+    std::shared_ptr<OrderBook> make_order_book(const std::string &symbol,
+                                               const BookConfig &config = BookConfig(),
+                                               SymbolId symbol_id = 0,
+                                               std::shared_ptr<OrderIdSequence> order_ids = nullptr);
+
+    // Request handed to a matching shard
+    struct ShardCommand
+    {
+        enum class Kind : std::uint8_t
+        {
+            Submit,
+            Cancel,
+        };
+
+        Kind kind = Kind::Submit;
+        SymbolId symbol_id = kInvalidSymbol;
+        OrderId order_id = 0;         // Cancel
+        std::shared_ptr<Order> order; // Submit
+    };
+
+    // Main matching engine. Symbols are interned into dense ids when their book
+    // is created; the string overloads resolve the id once at the API edge.
+    // Books configured with an event_capacity write into a ring owned here,
+    // which one consumer thread drains with drain_events; an l3_capacity
+    // likewise gives the book an L3 ring drained by drain_l3 or export_l3.
+    //
+    // With a journal open, every book appends each input it accepts (adds,
+    // submits, cancels, replaces and matches that fill) to one shared journal,
+    // under the book's lock so the journal holds each book's inputs in the
+    // order they were applied. Replaying the journal into an empty engine with
+    // the same book configuration rebuilds every book, order ids included.
+    //
+    // snapshot writes every book's resting orders to a file from a background
+    // thread and restore loads them back, so a restart restores the latest
+    // snapshot and replays only the journal records written after it.
+    //
+    // In sharded mode every symbol belongs to one matching thread (symbol_id
+    // modulo the shard count). Orders are posted to that thread's MPSC queue and
+    // its books run without locks; results are only reported through the event
+    // rings. While sharded, the books refuse every other thread apart from
+    // top_of_book reads.
     class MatchingEngine
     {
     private:
-        std::map<std::string, std::shared_ptr<OrderBook>> order_books_;
-        mutable std::mutex mutex_;
+        struct Shard
+        {
+            MpscQueue<ShardCommand> queue;
+            std::thread thread;
+
+            explicit Shard(std::size_t capacity) : queue(capacity) {}
+        };
+
+        // Directory entry; owner and rings are set before book is published
+        // and never change afterwards, so readers need only the acquire load
+        struct BookSlot
+        {
+            std::atomic<OrderBook *> book{nullptr};
+            std::shared_ptr<OrderBook> owner;
+            std::shared_ptr<EventRing> events; // May be nullptr
+            std::shared_ptr<L3Ring> l3;        // May be nullptr
+            std::uint64_t restored_sequence = 0; // Journal records the restored snapshot already holds
+        };
+
+        SymbolTable symbols_;
+        std::unique_ptr<BookSlot[]> books_; // Indexed by SymbolId, one per symbol table entry
+        std::map<std::string, BookConfig> book_configs_;
+        BookConfig default_config_;
+        std::shared_ptr<OrderIdSequence> order_ids_ = std::make_shared<OrderIdSequence>();
+        mutable std::mutex mutex_; // Book creation, configuration and shard control
+        std::mutex drain_mutex_;    // Event rings allow a single consumer
+        std::mutex l3_drain_mutex_; // As do L3 rings
+        std::shared_mutex shard_mutex_; // Posters share it; starting and stopping take it alone
+        std::vector<std::unique_ptr<Shard>> shards_; // Guarded by shard_mutex_
+        std::atomic<bool> shards_running_{false};
+        std::shared_ptr<Journal> journal_; // Set while a journal is open, guarded by mutex_
+        std::thread snapshot_writer_;       // Started and joined under mutex_
+        std::atomic<bool> snapshot_writing_{false};
+        std::size_t snapshot_orders_ = 0;   // Outcome of the last write, read once it is joined
+        std::string snapshot_error_;
+
+        void run_shard(Shard &shard);
+        template <typename Record>
+        std::size_t drain_rings(std::shared_ptr<SpscRing<Record>> BookSlot::*ring,
+                                std::vector<Record> &records, std::size_t max_records);
+        template <typename Record>
+        std::uint64_t rings_dropped(std::shared_ptr<SpscRing<Record>> BookSlot::*ring) const;
 
     public:
-        MatchingEngine() = default;
+        // Symbols beyond max_symbols cannot be interned
+        explicit MatchingEngine(std::size_t max_symbols = 4096)
+            : symbols_(max_symbols), books_(new BookSlot[max_symbols]) {}
+        ~MatchingEngine();
+        MatchingEngine(const MatchingEngine &) = delete;
+        MatchingEngine &operator=(const MatchingEngine &) = delete;
 
-        void add_order(const std::string &symbol, std::shared_ptr<Order> order);
+        // Must be called before the symbol's book is created; returns false otherwise
+        bool configure_symbol(const std::string &symbol, const BookConfig &config);
+        bool set_default_config(const BookConfig &config);
+
+        // Symbol and order id resolution for the API edge
+        SymbolId symbol_id(const std::string &symbol) const { return symbols_.find(symbol); }
+        std::string symbol_name(SymbolId symbol_id) const { return symbols_.name(symbol_id); }
+        OrderId next_order_id() { return order_ids_->next(); }
+
+        std::shared_ptr<Order> create_order(const std::string &symbol, const ClOrdId &cl_ord_id, char side,
+                                            int qty, char order_type, double price, double timestamp);
+        bool add_order(const std::string &symbol, std::shared_ptr<Order> order);
+        bool add_order(SymbolId symbol_id, std::shared_ptr<Order> order);
         std::vector<Match> match_orders(const std::string &symbol);
+        std::size_t match_orders(SymbolId symbol_id, std::vector<Match> &matches);
+        std::size_t match(const std::string &symbol);
+        std::size_t match(SymbolId symbol_id);
+        SubmitResult submit_order(const std::string &symbol, std::shared_ptr<Order> order,
+                                  std::vector<Match> &matches);
+        SubmitResult submit_order(SymbolId symbol_id, std::shared_ptr<Order> order,
+                                  std::vector<Match> &matches);
+
+        // Batch entry points submit or cancel in array order and skip records whose
+        // symbol has no book. They return the number of orders accepted / canceled.
+        std::size_t submit_batch(const BatchOrder *orders, std::size_t count, std::vector<Match> &matches);
+        std::size_t cancel_batch(const BatchCancel *cancels, std::size_t count);
+
+        // Starts shard_count matching threads, optionally pinned to cores 0..n-1.
+        // Returns false if shards are already running or shard_count is 0.
+        bool start_shards(std::size_t shard_count, bool pin_threads = false,
+                          std::size_t queue_capacity = 65536);
+        // Processes everything already posted, then joins the threads and
+        // returns the books to locked mode
+        void stop_shards();
+        bool sharded() const { return shards_running_.load(std::memory_order_acquire); }
+        // Queue work for the symbol's shard; false if not sharded or the queue is full.
+        // Work queued before stop_shards returns is always processed.
+        bool post_order(SymbolId symbol_id, std::shared_ptr<Order> order);
+        bool post_cancel(SymbolId symbol_id, OrderId order_id);
+
+        // Appends up to max_events events from every book's ring, in symbol order
+        std::size_t drain_events(std::vector<EngineEvent> &events, std::size_t max_events);
+        // Events lost to full rings since the engine started
+        std::uint64_t events_dropped() const;
+        // Appends up to max_records L3 records from every book's ring, in symbol order
+        std::size_t drain_l3(std::vector<L3Event> &records, std::size_t max_records);
+        // Drains every L3 ring and appends the raw records to the file at path.
+        // Returns the record count; throws std::runtime_error if the file cannot be written.
+        std::size_t export_l3(const std::string &path);
+        // L3 records lost to full rings since the engine started
+        std::uint64_t l3_dropped() const;
+
+        // Starts journaling every book's inputs to path, appending after the records
+        // an existing journal holds. Returns false if a journal is open or shards
+        // are running; throws std::runtime_error if the file cannot be opened and
+        // std::length_error if a symbol is too long for a journal record.
+        bool open_journal(const std::string &path, unsigned commit_interval_us = 1000);
+        // Commits outstanding records and closes the file; false if none is open or shards are running
+        bool close_journal();
+        // Blocks until every input accepted so far is on disk and returns the last
+        // durable sequence, 0 without a journal. Throws std::runtime_error if writing failed.
+        std::uint64_t sync_journal();
+        // Applies the inputs a journal recorded after after_sequence, in order, and
+        // returns how many were applied. Books are created as their symbols appear.
+        // Throws std::runtime_error if the file is unreadable, a journal is open or
+        // shards are running.
+        // After restore, records a restored book's snapshot already holds are skipped.
+        std::size_t replay(const std::string &journal_path, std::uint64_t after_sequence = 0);
+
+        // Copies every book's resting orders, locking one book at a time, and
+        // writes them to path from a background thread. With a journal open the
+        // file is only written once the journal records it covers are durable.
+        // Returns false if shards are running or the previous snapshot is still
+        // being written.
+        bool snapshot(const std::string &path);
+        // Blocks until the last snapshot is on disk and returns its order count,
+        // 0 if none was taken. Throws std::runtime_error if it could not be written.
+        std::size_t wait_snapshot();
+        // Rebuilds the books a snapshot holds from one mapping of the file and
+        // returns the number of orders restored. Books are created as with
+        // replay. Throws std::runtime_error if the file is unreadable or damaged,
+        // a book's tick size differs from the snapshot's, a journal is open or
+        // shards are running.
+        std::size_t restore(const std::string &path);
+
+        std::shared_ptr<Order> cancel_order(const std::string &symbol, OrderId order_id);
+        std::shared_ptr<Order> cancel_by_cl_ord_id(const std::string &symbol, const ClOrdId &cl_ord_id);
+        std::shared_ptr<Order> replace_order(const std::string &symbol, OrderId order_id,
+                                             int new_qty, double new_price);
+        std::shared_ptr<Order> find_by_cl_ord_id(const std::string &symbol, const ClOrdId &cl_ord_id) const;
 
+        // Lookups never lock; only creating a book does. get_or_create_book
+        // throws std::length_error once max_symbols symbols exist, or while
+        // journaling, for a symbol longer than a journal record can name.
         std::shared_ptr<OrderBook> get_or_create_book(const std::string &symbol);
         std::shared_ptr<OrderBook> get_book(const std::string &symbol) const;
+        std::shared_ptr<OrderBook> get_book(SymbolId symbol_id) const;
+        // Borrowed pointer without a reference count; books live as long as the engine
+        OrderBook *find_book(SymbolId symbol_id) const;
     };
 
 } // namespace crucible
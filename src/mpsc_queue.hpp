@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace crucible
+{
+
+    // Bounded lock-free multi-producer single-consumer queue. Each cell carries a
+    // sequence number, so producers claim a slot with one CAS on tail_ and the
+    // consumer never writes a line the producers spin on. A full queue makes
+    // try_push fail rather than block.
+    template <typename T>
+    class MpscQueue
+    {
+    private:
+        struct Cell
+        {
+            std::atomic<std::size_t> sequence;
+            T value;
+        };
+
+        std::unique_ptr<Cell[]> cells_;
+        std::size_t mask_;
+
+        alignas(64) std::atomic<std::size_t> tail_{0}; // Next slot to claim, shared by producers
+        alignas(64) std::size_t head_ = 0;             // Next slot to read, consumer only
+
+        static std::size_t round_up(std::size_t capacity)
+        {
+            std::size_t size = 2;
+            while (size < capacity)
+                size <<= 1;
+            return size;
+        }
+
+    public:
+        // Capacity is rounded up to a power of two
+        explicit MpscQueue(std::size_t capacity)
+            : cells_(new Cell[round_up(capacity)]), mask_(round_up(capacity) - 1)
+        {
+            for (std::size_t i = 0; i <= mask_; ++i)
+                cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        MpscQueue(const MpscQueue &) = delete;
+        MpscQueue &operator=(const MpscQueue &) = delete;
+
+        // Any thread; returns false when the queue is full
+        bool try_push(T value)
+        {
+            std::size_t pos = tail_.load(std::memory_order_relaxed);
+            while (true)
+            {
+                Cell &cell = cells_[pos & mask_];
+                std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+                if (diff == 0)
+                {
+                    if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        cell.value = std::move(value);
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = tail_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Consumer thread only
+        bool try_pop(T &out)
+        {
+            Cell &cell = cells_[head_ & mask_];
+            std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            if (sequence != head_ + 1)
+                return false;
+            out = std::move(cell.value);
+            cell.sequence.store(head_ + mask_ + 1, std::memory_order_release);
+            ++head_;
+            return true;
+        }
+
+        std::size_t capacity() const { return mask_ + 1; }
+    };
+
+} // namespace crucible
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace crucible
+{
+
+    // Single-writer sequence lock over a small trivially copyable value. The
+    // writer bumps the sequence to odd, copies the value in and bumps it back to
+    // even; readers retry until they see the same even sequence on both sides of
+    // their copy. The payload is held in relaxed atomic words so a torn read is
+    // discarded rather than being a data race.
+    template <typename T>
+    class SeqLock
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "seqlock values are copied word by word");
+
+    private:
+        static constexpr std::size_t kWords = (sizeof(T) + 7) / 8;
+
+        alignas(64) std::atomic<std::uint64_t> sequence_{0};
+        std::atomic<std::uint64_t> words_[kWords] = {};
+
+    public:
+        SeqLock() = default;
+        SeqLock(const SeqLock &) = delete;
+        SeqLock &operator=(const SeqLock &) = delete;
+
+        // Writer side; callers serialize writes
+        void store(const T &value)
+        {
+            std::uint64_t buffer[kWords] = {};
+            std::memcpy(buffer, &value, sizeof(T));
+
+            std::uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+            sequence_.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (std::size_t i = 0; i < kWords; ++i)
+                words_[i].store(buffer[i], std::memory_order_relaxed);
+            sequence_.store(sequence + 2, std::memory_order_release);
+        }
+
+        // Any thread; never blocks the writer
+        T load() const
+        {
+            std::uint64_t buffer[kWords];
+            std::uint64_t before;
+            std::uint64_t after;
+            do
+            {
+                before = sequence_.load(std::memory_order_acquire);
+                for (std::size_t i = 0; i < kWords; ++i)
+                    buffer[i] = words_[i].load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                after = sequence_.load(std::memory_order_relaxed);
+            } while ((before & 1) || before != after);
+
+            T value;
+            std::memcpy(&value, buffer, sizeof(T));
+            return value;
+        }
+    };
+
+} // namespace crucible
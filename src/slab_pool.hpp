@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace crucible
+{
+
+    // Fixed-size block pool carved out of large slabs, recycled through an
+    // intrusive freelist. Block size and alignment are fixed by the first
+    // allocation and each slab holds slab_blocks blocks, so a pool sized from
+    // configuration stops calling malloc once the book is warm.
+    // Blocks may be returned from any thread (orders are released by Python),
+    // so the freelist is guarded by a spinlock that is uncontended in practice.
+    class SlabPool
+    {
+    private:
+        struct FreeBlock
+        {
+            FreeBlock *next;
+        };
+
+        std::size_t block_size_ = 0;
+        std::size_t block_align_ = alignof(std::max_align_t);
+        std::size_t slab_blocks_;
+        std::vector<void *> slabs_;
+        FreeBlock *free_ = nullptr;
+        std::atomic_flag lock_ = ATOMIC_FLAG_INIT;
+
+        void lock()
+        {
+            while (lock_.test_and_set(std::memory_order_acquire))
+            {
+            }
+        }
+        void unlock() { lock_.clear(std::memory_order_release); }
+
+        void grow()
+        {
+            char *slab = static_cast<char *>(
+                ::operator new(block_size_ * slab_blocks_, std::align_val_t(block_align_)));
+            slabs_.push_back(slab);
+            for (std::size_t i = slab_blocks_; i-- > 0;)
+            {
+                auto *block = reinterpret_cast<FreeBlock *>(slab + i * block_size_);
+                block->next = free_;
+                free_ = block;
+            }
+        }
+
+    public:
+        explicit SlabPool(std::size_t slab_blocks) : slab_blocks_(std::max<std::size_t>(slab_blocks, 64)) {}
+        ~SlabPool()
+        {
+            for (void *slab : slabs_)
+                ::operator delete(slab, std::align_val_t(block_align_));
+        }
+        SlabPool(const SlabPool &) = delete;
+        SlabPool &operator=(const SlabPool &) = delete;
+
+        // Returns nullptr when the request does not fit this pool's blocks
+        void *allocate(std::size_t size, std::size_t align)
+        {
+            lock();
+            if (block_size_ == 0)
+            {
+                block_align_ = std::max(align, block_align_);
+                block_size_ = (std::max(size, sizeof(FreeBlock)) + block_align_ - 1) / block_align_ * block_align_;
+            }
+            if (size > block_size_ || align > block_align_)
+            {
+                unlock();
+                return nullptr;
+            }
+            if (!free_)
+                grow();
+            FreeBlock *block = free_;
+            free_ = block->next;
+            unlock();
+            return block;
+        }
+
+        // Returns false when the block was not allocated from this pool
+        bool deallocate(void *block, std::size_t size, std::size_t align) noexcept
+        {
+            lock();
+            if (block_size_ == 0 || size > block_size_ || align > block_align_)
+            {
+                unlock();
+                return false;
+            }
+            auto *free_block = static_cast<FreeBlock *>(block);
+            free_block->next = free_;
+            free_ = free_block;
+            unlock();
+            return true;
+        }
+    };
+
+    // Standard allocator over a shared SlabPool. Single-object requests come
+    // from the pool, arrays (hash buckets) go to the global heap. The pool is
+    // shared so it outlives any object still referenced from Python.
+    template <typename T>
+    class PoolAllocator
+    {
+    private:
+        std::shared_ptr<SlabPool> pool_;
+
+        template <typename U>
+        friend class PoolAllocator;
+
+    public:
+        using value_type = T;
+
+        explicit PoolAllocator(std::shared_ptr<SlabPool> pool) noexcept : pool_(std::move(pool)) {}
+        template <typename U>
+        PoolAllocator(const PoolAllocator<U> &other) noexcept : pool_(other.pool_) {}
+
+        T *allocate(std::size_t n)
+        {
+            if (n == 1)
+            {
+                if (void *block = pool_->allocate(sizeof(T), alignof(T)))
+                    return static_cast<T *>(block);
+            }
+            return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+        }
+
+        void deallocate(T *p, std::size_t n) noexcept
+        {
+            if (n == 1 && pool_->deallocate(p, sizeof(T), alignof(T)))
+                return;
+            ::operator delete(p, std::align_val_t(alignof(T)));
+        }
+
+        template <typename U>
+        bool operator==(const PoolAllocator<U> &other) const noexcept { return pool_ == other.pool_; }
+        template <typename U>
+        bool operator!=(const PoolAllocator<U> &other) const noexcept { return pool_ != other.pool_; }
+    };
+
+} // namespace crucible
@@ -0,0 +1,193 @@
+#include "snapshot.hpp"
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace crucible
+{
+
+    namespace
+    {
+        constexpr char kSnapshotMagic[] = "CRUCIBLE-SNAP";
+        constexpr std::uint32_t kSnapshotVersion = 1;
+        constexpr std::uint64_t kChecksumSeed = 0xcbf29ce484222325ull;
+
+        // Every section is a multiple of eight bytes, so the checksum runs word by word
+        std::uint64_t checksum(std::uint64_t hash, const void *data, std::size_t size)
+        {
+            const char *bytes = static_cast<const char *>(data);
+            for (std::size_t i = 0; i < size; i += 8)
+            {
+                std::uint64_t word;
+                std::memcpy(&word, bytes + i, 8);
+                hash = (hash ^ word) * 0x100000001b3ull;
+            }
+            return hash;
+        }
+
+        std::size_t padded(std::size_t size)
+        {
+            return (size + 7) & ~std::size_t(7);
+        }
+    }
+
+#ifndef _WIN32
+    namespace
+    {
+        bool write_all(int fd, const void *data, std::size_t size)
+        {
+            const char *bytes = static_cast<const char *>(data);
+            while (size > 0)
+            {
+                ssize_t written = write(fd, bytes, size);
+                if (written < 0 && errno == EINTR)
+                    continue;
+                if (written <= 0)
+                    return false;
+                bytes += written;
+                size -= static_cast<std::size_t>(written);
+            }
+            return true;
+        }
+    }
+
+    std::size_t write_snapshot(const std::string &path, const std::vector<BookImage> &books, double taken_at)
+    {
+        const std::string temp = path + ".tmp";
+        int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            throw std::runtime_error("cannot open snapshot " + temp);
+
+        SnapshotHeader header{};
+        std::memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic) - 1);
+        header.version = kSnapshotVersion;
+        header.order_size = sizeof(SnapshotOrder);
+        header.book_count = books.size();
+        header.taken_at = taken_at;
+        header.checksum = kChecksumSeed;
+
+        // The header goes first as a placeholder and is rewritten once the checksum is known
+        bool ok = write_all(fd, &header, sizeof(header));
+        std::vector<char> name;
+        for (const BookImage &book : books)
+        {
+            if (!ok)
+                break;
+            name.assign(padded(book.symbol.size()), '\0');
+            std::memcpy(name.data(), book.symbol.data(), book.symbol.size());
+            const std::size_t order_bytes = book.orders.size() * sizeof(SnapshotOrder);
+            header.checksum = checksum(header.checksum, &book.header, sizeof(book.header));
+            header.checksum = checksum(header.checksum, name.data(), name.size());
+            header.checksum = checksum(header.checksum, book.orders.data(), order_bytes);
+            header.order_count += book.orders.size();
+            ok = write_all(fd, &book.header, sizeof(book.header)) && write_all(fd, name.data(), name.size()) &&
+                 write_all(fd, book.orders.data(), order_bytes);
+        }
+        ok = ok && pwrite(fd, &header, sizeof(header), 0) == sizeof(header) && fdatasync(fd) == 0;
+        ok = close(fd) == 0 && ok;
+        if (!ok || rename(temp.c_str(), path.c_str()) != 0)
+        {
+            unlink(temp.c_str());
+            throw std::runtime_error("cannot write snapshot " + path);
+        }
+
+        // The rename is durable once the directory is
+        std::string::size_type slash = path.rfind('/');
+        std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+        int dir = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir >= 0)
+        {
+            fsync(dir);
+            close(dir);
+        }
+        return static_cast<std::size_t>(header.order_count);
+    }
+
+    SnapshotReader::SnapshotReader(const std::string &path)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw std::runtime_error("cannot open snapshot " + path);
+        struct stat info;
+        if (fstat(fd, &info) != 0)
+        {
+            close(fd);
+            throw std::runtime_error("cannot read snapshot " + path);
+        }
+        mapped_ = static_cast<std::size_t>(info.st_size);
+        if (mapped_ < sizeof(SnapshotHeader))
+        {
+            close(fd);
+            throw std::runtime_error(path + " is not a snapshot");
+        }
+        data_ = mmap(nullptr, mapped_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        close(fd); // The mapping keeps the file
+        if (data_ == MAP_FAILED)
+        {
+            data_ = nullptr;
+            throw std::runtime_error("cannot map snapshot " + path);
+        }
+
+        const char *base = static_cast<const char *>(data_);
+        header_ = reinterpret_cast<const SnapshotHeader *>(base);
+        std::size_t offset = sizeof(SnapshotHeader);
+        bool valid = std::memcmp(header_->magic, kSnapshotMagic, sizeof(kSnapshotMagic) - 1) == 0 &&
+                     header_->version == kSnapshotVersion && header_->order_size == sizeof(SnapshotOrder) &&
+                     (mapped_ - offset) % 8 == 0 &&
+                     checksum(kChecksumSeed, base + offset, mapped_ - offset) == header_->checksum;
+
+        // Sizes are checked against what is left before anything is indexed
+        for (std::uint64_t i = 0; valid && i < header_->book_count; ++i)
+        {
+            if (mapped_ - offset < sizeof(SnapshotBook))
+            {
+                valid = false;
+                break;
+            }
+            const auto *book = reinterpret_cast<const SnapshotBook *>(base + offset);
+            offset += sizeof(SnapshotBook);
+            std::size_t name = padded(book->symbol_size);
+            if (mapped_ - offset < name || (mapped_ - offset - name) / sizeof(SnapshotOrder) < book->order_count)
+            {
+                valid = false;
+                break;
+            }
+            books_.push_back({book, std::string_view(base + offset, book->symbol_size),
+                              reinterpret_cast<const SnapshotOrder *>(base + offset + name)});
+            offset += name + book->order_count * sizeof(SnapshotOrder);
+        }
+        if (!valid || offset != mapped_)
+        {
+            munmap(data_, mapped_);
+            data_ = nullptr;
+            throw std::runtime_error(path + " is not a snapshot or is damaged");
+        }
+    }
+
+    SnapshotReader::~SnapshotReader()
+    {
+        if (data_)
+            munmap(data_, mapped_);
+    }
+#else
+    std::size_t write_snapshot(const std::string &path, const std::vector<BookImage> &, double)
+    {
+        throw std::runtime_error("cannot write snapshot " + path + ": snapshots need POSIX file I/O");
+    }
+
+    SnapshotReader::SnapshotReader(const std::string &path)
+    {
+        throw std::runtime_error("cannot map snapshot " + path + ": snapshots need POSIX memory mapping");
+    }
+
+    SnapshotReader::~SnapshotReader() {}
+#endif
+
+} // namespace crucible
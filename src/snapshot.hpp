@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "identifiers.hpp"
+
+namespace crucible
+{
+
+    // Snapshot file layout: a SnapshotHeader, then for every book a
+    // SnapshotBook, its symbol name zero-padded to a multiple of eight bytes
+    // and its resting orders. Orders are stored bids first, then asks, each
+    // side best level first and every level in queue order, so adding them back
+    // in file order rebuilds the same levels with the same priority.
+
+    struct SnapshotHeader
+    {
+        char magic[16];
+        std::uint32_t version;
+        std::uint32_t order_size; // sizeof(SnapshotOrder) of the writer
+        std::uint64_t book_count;
+        std::uint64_t order_count;
+        std::uint64_t checksum;   // Over everything after the header
+        double taken_at;          // Wall clock when the capture started
+        std::uint8_t reserved[8];
+    };
+
+    struct SnapshotBook
+    {
+        std::uint64_t order_count;
+        std::uint64_t journal_sequence; // Journal records up to here are reflected and durable, 0 without a journal
+        std::int64_t last_ticks;
+        std::int64_t last_qty;
+        double tick_size;
+        std::uint32_t symbol_size;
+        std::uint32_t reserved;
+    };
+
+    struct SnapshotOrder
+    {
+        OrderId order_id;
+        std::int64_t price_ticks;
+        double timestamp;
+        std::int32_t order_qty;
+        std::int32_t filled_qty;
+        char side;
+        char order_type;
+        char status;
+        std::uint8_t cl_ord_id_size;
+        char cl_ord_id[ClOrdId::capacity];
+        std::uint8_t reserved[5];
+    };
+
+    static_assert(sizeof(SnapshotHeader) == 64, "snapshot layout");
+    static_assert(sizeof(SnapshotBook) == 48, "snapshot layout");
+    static_assert(sizeof(SnapshotOrder) == 64, "snapshot layout");
+    static_assert(std::is_trivially_copyable<SnapshotOrder>::value, "snapshot orders are written with memcpy");
+
+    // One book as captured for a snapshot, copied out under the book's lock
+    struct BookImage
+    {
+        SnapshotBook header{};
+        std::string symbol;
+        std::vector<SnapshotOrder> orders;
+    };
+
+    // Writes the books to a temporary file beside path, syncs it and renames it
+    // over path, so a crash mid-write leaves the previous snapshot in place.
+    // Returns the order count; throws std::runtime_error if the file cannot be written.
+    std::size_t write_snapshot(const std::string &path, const std::vector<BookImage> &books, double taken_at);
+
+    // Maps a snapshot file read-only and checks its header and checksum.
+    // Books and orders are read in place from the mapping.
+    class SnapshotReader
+    {
+    public:
+        struct Book
+        {
+            const SnapshotBook *header;
+            std::string_view symbol;
+            const SnapshotOrder *orders;
+        };
+
+    private:
+        void *data_ = nullptr;
+        std::size_t mapped_ = 0;
+        const SnapshotHeader *header_ = nullptr;
+        std::vector<Book> books_;
+
+    public:
+        // Throws std::runtime_error if the file cannot be read, is not a snapshot or is damaged
+        explicit SnapshotReader(const std::string &path);
+        ~SnapshotReader();
+        SnapshotReader(const SnapshotReader &) = delete;
+        SnapshotReader &operator=(const SnapshotReader &) = delete;
+
+        const SnapshotHeader &header() const { return *header_; }
+        const std::vector<Book> &books() const { return books_; }
+    };
+
+} // namespace crucible
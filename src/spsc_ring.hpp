@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace crucible
+{
+
+    // Bounded single-producer single-consumer ring of trivially copyable records.
+    // The producer never blocks: a push into a full ring drops the record and
+    // bumps dropped(). Head and tail live on their own cache lines and each side
+    // caches the other's index, so the common case touches no shared line.
+    template <typename T>
+    class SpscRing
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "ring records are copied with memcpy semantics");
+
+    private:
+        std::vector<T> slots_;
+        std::size_t mask_;
+
+        alignas(64) std::atomic<std::size_t> tail_{0}; // Next write, advanced by the producer
+        std::size_t head_cache_ = 0;                   // Producer's view of head_
+        alignas(64) std::atomic<std::size_t> head_{0}; // Next read, advanced by the consumer
+        std::size_t tail_cache_ = 0;                   // Consumer's view of tail_
+        alignas(64) std::atomic<std::uint64_t> dropped_{0};
+
+        static std::size_t round_up(std::size_t capacity)
+        {
+            std::size_t size = 2;
+            while (size < capacity)
+                size <<= 1;
+            return size;
+        }
+
+    public:
+        // Capacity is rounded up to a power of two
+        explicit SpscRing(std::size_t capacity) : slots_(round_up(capacity)), mask_(slots_.size() - 1) {}
+        SpscRing(const SpscRing &) = delete;
+        SpscRing &operator=(const SpscRing &) = delete;
+
+        // Producer side; returns false and counts a drop when the ring is full
+        bool try_push(const T &record)
+        {
+            std::size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail - head_cache_ > mask_)
+            {
+                head_cache_ = head_.load(std::memory_order_acquire);
+                if (tail - head_cache_ > mask_)
+                {
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+            }
+            slots_[tail & mask_] = record;
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side; copies up to max records into out and returns the count
+        std::size_t pop(T *out, std::size_t max)
+        {
+            std::size_t head = head_.load(std::memory_order_relaxed);
+            if (tail_cache_ - head < max)
+                tail_cache_ = tail_.load(std::memory_order_acquire);
+
+            std::size_t count = tail_cache_ - head;
+            if (count > max)
+                count = max;
+            for (std::size_t i = 0; i < count; ++i)
+                out[i] = slots_[(head + i) & mask_];
+            head_.store(head + count, std::memory_order_release);
+            return count;
+        }
+
+        std::size_t size() const
+        {
+            return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+        }
+        std::size_t capacity() const { return slots_.size(); }
+        std::uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+    };
+
+} // namespace crucible
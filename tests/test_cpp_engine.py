@@ -0,0 +1,1372 @@
+"""
+Unit Tests for the native C++ Matching Engine
+Demonstrates: C++ integration testing through pybind11 bindings
+Skills: pytest, C++ engine semantics, price-time priority
+"""
+
+import pytest
+import re
+import socket
+import struct
+import sys
+import os
+import time
+
+# Add src to path
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), '../src')))
+
+# Try to import C++ engine
+try:
+    import crucible_engine
+    CPP_AVAILABLE = True
+except ImportError:
+    CPP_AVAILABLE = False
+
+
+def make_order(order_id, side, qty, price, order_type="2"):
+    """Build a native order with a derived client order ID."""
+    return crucible_engine.Order(
+        f"CL_{order_id}", side, qty, order_type, price, order_id=order_id
+    )
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE, reason="C++ engine not compiled")
+class TestTickPrices:
+    """Test integer tick price handling."""
+
+    def test_prices_snap_to_same_level(self):
+        """Test nearly-equal float prices land on one level."""
+        book = crucible_engine.OrderBook("AAPL")
+        book.add_order(make_order(1, "1", 100, 150.1))
+        book.add_order(make_order(2, "1", 100, 150.10000000001))
+
+        assert len(book.get_buy_depth()) == 1
+        assert book.get_best_bid_ticks() == 15010
+
+    def test_per_symbol_tick_size(self):
+        """Test books pick up their configured tick size."""
+        engine = crucible_engine.MatchingEngine()
+        config = crucible_engine.BookConfig()
+        config.tick_size = 0.05
+
+        assert engine.configure_symbol("MSFT", config)
+
+        order = make_order(101, "2", 10, 380.05)
+        engine.add_order("MSFT", order)
+
+        assert engine.get_book("MSFT").tick_size() == pytest.approx(0.05)
+        assert order.price_ticks == 7601
+
+    def test_configure_after_creation_rejected(self):
+        """Test tick size cannot change once the book exists."""
+        engine = crucible_engine.MatchingEngine()
+        engine.add_order("AAPL", make_order(1, "1", 100, 150.0))
+
+        config = crucible_engine.BookConfig()
+        config.tick_size = 0.05
+        assert not engine.configure_symbol("AAPL", config)
+
+    def test_match_reports_tick_price(self):
+        """Test fills carry both tick and decimal prices."""
+        engine = crucible_engine.MatchingEngine()
+        engine.add_order("AAPL", make_order(1, "1", 100, 150.10))
+        engine.add_order("AAPL", make_order(101, "2", 100, 150.05))
+
+        matches = engine.match_orders("AAPL")
+
+        assert len(matches) == 1
+        assert matches[0].price_ticks == 15005
+        assert matches[0].price == pytest.approx(150.05)
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE, reason="C++ engine not compiled")
+class TestLadderBook:
+    """Test the tick-indexed ladder book implementation."""
+
+    @pytest.fixture
+    def ladder_config(self):
+        config = crucible_engine.BookConfig()
+        config.book_type = crucible_engine.BookType.Ladder
+        config.ladder_levels = 128
+        return config
+
+    def test_engine_creates_ladder_book(self, ladder_config):
+        """Test the configured book type is used for the symbol."""
+        engine = crucible_engine.MatchingEngine()
+        assert engine.configure_symbol("AAPL", ladder_config)
+
+        engine.add_order("AAPL", make_order(1, "1", 100, 150.00))
+        engine.add_order("AAPL", make_order(2, "1", 100, 150.02))
+        engine.add_order("AAPL", make_order(101, "2", 150, 149.99))
+
+        matches = engine.match_orders("AAPL")
+
+        assert [m.buy_order_id for m in matches] == [2, 1]
+        assert [m.qty for m in matches] == [100, 50]
+        assert engine.get_book("AAPL").get_best_bid() == pytest.approx(150.00)
+
+    def test_prices_outside_window(self, ladder_config):
+        """Test far prices still sort correctly against the ladder window."""
+        book = crucible_engine.OrderBook("AAPL", ladder_config)
+        book.add_order(make_order(1, "1", 10, 150.00))
+        book.add_order(make_order(2, "1", 10, 160.00))
+        book.add_order(make_order(3, "1", 10, 140.00))
+
+        assert book.get_best_bid() == pytest.approx(160.00)
+        assert list(book.get_buy_depth().keys()) == pytest.approx([140.0, 150.0, 160.0])
+
+        book.add_order(make_order(101, "2", 30, 130.00))
+        matches = book.match_orders()
+
+        assert [m.buy_order_id for m in matches] == [2, 1, 3]
+        assert book.get_best_bid() == 0.0
+
+    def test_window_follows_market_past_resting_order(self, ladder_config):
+        """Test the best price can walk far past the window while a distant order rests."""
+        book = crucible_engine.OrderBook("AAPL", ladder_config)
+        book.add_order(make_order(1, "1", 10, 100.00))
+        prices = [150.00 + step * 0.50 for step in range(21)]  # 1000 ticks past the window
+        for order_id, price in enumerate(prices, start=2):
+            book.add_order(make_order(order_id, "1", 10, price))
+
+        assert book.get_best_bid() == pytest.approx(160.00)
+        assert list(book.get_buy_depth().keys()) == pytest.approx([100.0] + prices)
+
+        book.add_order(make_order(101, "2", 30, 159.00))
+        matches = book.match_orders()
+
+        assert [m.buy_order_id for m in matches] == [22, 21, 20]
+        assert book.get_best_bid() == pytest.approx(158.50)
+        book.add_order(make_order(102, "2", 190, 100.00))
+        matches = book.match_orders()
+        assert [m.buy_order_id for m in matches] == list(range(19, 0, -1))
+        assert book.get_best_bid() == 0.0
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE, reason="C++ engine not compiled")
+class TestPriceLevelQueue:
+    """Test the intrusive FIFO queue inside each price level."""
+
+    def test_filled_orders_leave_depth(self):
+        """Test depth counts only live orders after fills."""
+        book = crucible_engine.OrderBook("AAPL")
+        book.add_order(make_order(1, "1", 100, 150.0))
+        book.add_order(make_order(2, "1", 100, 150.0))
+        book.add_order(make_order(101, "2", 100, 150.0))
+
+        book.match_orders()
+
+        assert book.get_buy_depth() == {pytest.approx(150.0): 1}
+        assert book.get_sell_depth() == {}
+
+    def test_time_priority_within_level(self):
+        """Test orders at one price fill in arrival order."""
+        book = crucible_engine.OrderBook("AAPL")
+        for order_id in (1, 2, 3):
+            book.add_order(make_order(order_id, "1", 10, 150.0))
+        book.add_order(make_order(101, "2", 25, 150.0))
+
+        matches = book.match_orders()
+
+        assert [(m.buy_order_id, m.qty) for m in matches] == [(1, 10), (2, 10), (3, 5)]
+
+    def test_duplicate_order_id_rejected(self):
+        """Test an order ID can only rest once per book."""
+        book = crucible_engine.OrderBook("AAPL")
+
+        assert book.add_order(make_order(1, "1", 100, 150.0))
+        assert not book.add_order(make_order(1, "1", 100, 151.0))
+        assert book.get_best_bid() == pytest.approx(150.0)
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE, reason="C++ engine not compiled")
+class TestCancelReplace:
+    """Test native cancel and cancel/replace."""
+
+    @pytest.fixture
+    def engine(self):
+        engine = crucible_engine.MatchingEngine()
+        engine.add_order("AAPL", make_order(1, "1", 100, 150.0))
+        engine.add_order("AAPL", make_order(2, "1", 100, 150.0))
+        return engine
+
+    def test_cancel_by_order_id(self, engine):
+        """Test cancel removes the order from its level."""
+        order = engine.cancel_order("AAPL", 1)
+
+        assert order.status == "4"
+        assert engine.get_book("AAPL").get_buy_depth() == {pytest.approx(150.0): 1}
+        assert engine.cancel_order("AAPL", 1) is None
+
+    def test_cancel_by_cl_ord_id(self, engine):
+        """Test cancel through the client order ID index."""
+        assert engine.find_by_cl_ord_id("AAPL", "CL_2").order_id == 2
+
+        order = engine.cancel_by_cl_ord_id("AAPL", "CL_2")
+
+        assert order.order_id == 2
+        assert engine.find_by_cl_ord_id("AAPL", "CL_2") is None
+
+    def test_cancel_unknown_symbol(self, engine):
+        """Test cancel on a symbol without a book."""
+        assert engine.cancel_order("MSFT", 1) is None
+
+    def test_qty_down_keeps_priority(self, engine):
+        """Test reducing quantity keeps the order at the front."""
+        engine.replace_order("AAPL", 1, 50)
+        engine.add_order("AAPL", make_order(101, "2", 10, 150.0))
+
+        matches = engine.match_orders("AAPL")
+
+        assert matches[0].buy_order_id == 1
+
+    def test_qty_up_loses_priority(self, engine):
+        """Test increasing quantity requeues the order."""
+        engine.replace_order("AAPL", 1, 200)
+        engine.add_order("AAPL", make_order(101, "2", 10, 150.0))
+
+        matches = engine.match_orders("AAPL")
+
+        assert matches[0].buy_order_id == 2
+
+    def test_price_change_moves_level(self, engine):
+        """Test a price change moves the order to the new level."""
+        order = engine.replace_order("AAPL", 1, 100, 151.0)
+
+        assert order.price_ticks == 15100
+        assert engine.get_book("AAPL").get_best_bid() == pytest.approx(151.0)
+
+    def test_crossing_replace_trades(self, engine):
+        """Test a price change across the spread fills at once and rests the remainder."""
+        engine.add_order("AAPL", make_order(101, "2", 30, 151.0))
+
+        order = engine.replace_order("AAPL", 1, 100, 151.0)
+
+        assert (order.filled_qty, order.status) == (30, "1")
+        book = engine.get_book("AAPL")
+        assert book.get_best_bid() == pytest.approx(151.0)
+        assert book.get_best_ask() == 0.0
+        assert book.top_of_book().last_qty == 30
+        assert engine.match_orders("AAPL") == []
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE, reason="C++ engine not compiled")
+class TestPooledOrders:
+    """Test orders allocated from the book's slab pool."""
+
+    def test_create_order_from_engine(self):
+        """Test pooled orders behave like regular orders."""
+        engine = crucible_engine.MatchingEngine()
+        buy = engine.create_order("AAPL", "CL_B1", "1", 100, "2", 150.0)
+        sell = engine.create_order("AAPL", "CL_S1", "2", 100, "2", 150.0)
+
+        assert buy.symbol_id == engine.symbol_id("AAPL")
+        assert engine.add_order("AAPL", buy)
+        assert engine.add_order("AAPL", sell)
+
+        matches = engine.match_orders("AAPL")
+
+        assert len(matches) == 1
+        assert buy.is_complete() and sell.is_complete()
+
+    def test_pooled_order_outlives_book(self):
+        """Test an order stays valid after its book is released."""
+        book = crucible_engine.OrderBook("AAPL")
+        order = book.create_order("CL_B1", "1", 100, "2", 150.0)
+        del book
+
+        assert order.order_id > 0
+        assert order.remaining_qty() == 100
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE, reason="C++ engine not compiled")
+class TestIdentifiers:
+    """Test symbol interning and engine-assigned order IDs."""
+
+    def test_symbols_interned_on_book_creation(self):
+        """Test each symbol gets a stable dense ID."""
+        engine = crucible_engine.MatchingEngine()
+        engine.get_or_create_book("AAPL")
+        engine.get_or_create_book("MSFT")
+
+        assert engine.symbol_id("AAPL") == 0
+        assert engine.symbol_id("MSFT") == 1
+        assert engine.symbol_name(1) == "MSFT"
+        assert engine.get_book("MSFT").symbol_id() == 1
+
+    def test_engine_assigns_order_ids(self):
+        """Test orders without an ID get one from the engine."""
+        engine = crucible_engine.MatchingEngine()
+        buy = engine.create_order("AAPL", "CL_B1", "1", 100, "2", 150.0)
+        sell = engine.create_order("MSFT", "CL_S1", "2", 100, "2", 380.0)
+
+        assert sell.order_id == buy.order_id + 1
+        assert engine.next_order_id() == sell.order_id + 1
+
+    def test_add_order_stamps_id(self):
+        """Test an unnumbered order is numbered when it rests."""
+        engine = crucible_engine.MatchingEngine()
+        order = crucible_engine.Order("CL_B1", "1", 100, "2", 150.0)
+
+        assert order.order_id == 0
+        assert engine.add_order("AAPL", order)
+        assert order.order_id > 0
+        assert order.symbol_id == engine.symbol_id("AAPL")
+
+    def test_symbol_capacity(self):
+        """Test the fixed-size symbol directory refuses extra symbols."""
+        engine = crucible_engine.MatchingEngine(max_symbols=2)
+        engine.get_or_create_book("AAPL")
+        engine.get_or_create_book("MSFT")
+
+        with pytest.raises(ValueError):
+            engine.get_or_create_book("GOOGL")
+        assert engine.get_book("GOOGL") is None
+        assert engine.get_book("AAPL").symbol() == "AAPL"
+
+    def test_long_cl_ord_id_rejected(self):
+        """Test client order IDs longer than the inline capacity."""
+        with pytest.raises(ValueError):
+            crucible_engine.Order("X" * 24, "1", 100, "2", 150.0)
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE, reason="C++ engine not compiled")
+class TestEventRing:
+    """Test engine events drained from the per-book rings."""
+
+    @pytest.fixture
+    def engine(self):
+        engine = crucible_engine.MatchingEngine()
+        config = crucible_engine.BookConfig()
+        config.event_capacity = 64
+        assert engine.set_default_config(config)
+        return engine
+
+    def test_fill_events(self, engine):
+        """Test a match reports one fill per order."""
+        engine.add_order("AAPL", make_order(1, "1", 100, 150.0))
+        engine.add_order("AAPL", make_order(101, "2", 60, 150.0))
+
+        assert engine.match("AAPL") == 1
+
+        fills = [e for e in engine.drain_events() if e.type == crucible_engine.EventType.Fill]
+        assert [(e.order_id, e.contra_order_id, e.qty, e.leaves_qty) for e in fills] == [
+            (1, 101, 60, 40),
+            (101, 1, 60, 0),
+        ]
+
+    def test_ack_and_cancel_events(self, engine):
+        """Test order lifecycle events arrive in order."""
+        engine.add_order("AAPL", make_order(1, "1", 100, 150.0))
+        engine.cancel_order("AAPL", 1)
+
+        types = [e.type for e in engine.drain_events() if e.order_id == 1]
+
+        assert types == [crucible_engine.EventType.Ack, crucible_engine.EventType.Cancel]
+        assert engine.drain_events() == []
+
+    def test_full_ring_counts_drops(self):
+        """Test overflowing the ring drops events instead of blocking."""
+        engine = crucible_engine.MatchingEngine()
+        config = crucible_engine.BookConfig()
+        config.event_capacity = 4
+        engine.configure_symbol("AAPL", config)
+
+        for order_id in range(1, 5):
+            engine.add_order("AAPL", make_order(order_id, "1", 10, 150.0))
+
+        assert len(engine.drain_events()) == 4
+        assert engine.events_dropped() == 4
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE, reason="C++ engine not compiled")
+class TestContinuousMatching:
+    """Test matching an incoming order on entry."""
+
+    @pytest.fixture
+    def engine(self):
+        engine = crucible_engine.MatchingEngine()
+        engine.submit_order("AAPL", make_order(1, "1", 100, 150.0))
+        engine.submit_order("AAPL", make_order(2, "1", 50, 151.0))
+        return engine
+
+    def test_non_marketable_order_rests(self, engine):
+        """Test an order that cannot cross rests without fills."""
+        result, matches = engine.submit_order("AAPL", make_order(101, "2", 10, 152.0))
+
+        assert result.accepted and result.resting
+        assert matches == []
+        assert engine.get_book("AAPL").get_best_ask() == pytest.approx(152.0)
+
+    def test_aggressor_sweeps_levels(self, engine):
+        """Test fills walk the book at the resting prices."""
+        result, matches = engine.submit_order("AAPL", make_order(101, "2", 120, 149.0))
+
+        assert [(m.buy_order_id, m.qty, m.price) for m in matches] == [
+            (2, 50, pytest.approx(151.0)),
+            (1, 70, pytest.approx(150.0)),
+        ]
+        assert result.filled_qty == 120
+        assert not result.resting
+
+    def test_limit_remainder_rests(self, engine):
+        """Test the unfilled part of a limit order rests at its price."""
+        result, _ = engine.submit_order("AAPL", make_order(101, "2", 80, 151.0))
+
+        assert result.filled_qty == 50
+        assert result.resting
+        assert engine.get_book("AAPL").get_sell_depth() == {pytest.approx(151.0): 1}
+
+    def test_market_remainder_canceled(self, engine):
+        """Test a market order never rests."""
+        order = make_order(101, "2", 500, 0.0, order_type="1")
+        result, _ = engine.submit_order("AAPL", order)
+
+        assert result.filled_qty == 150
+        assert not result.resting
+        assert order.status == "4"
+        assert engine.get_book("AAPL").get_sell_depth() == {}
+
+    def test_stale_market_order_does_not_block(self, engine):
+        """Test a market order left resting by add_order is canceled, not traded behind."""
+        stale = make_order(101, "2", 10, 0.0, order_type="1")
+        engine.add_order("AAPL", stale)
+        engine.submit_order("AAPL", make_order(102, "2", 20, 152.0))
+
+        result, matches = engine.submit_order("AAPL", make_order(103, "1", 20, 0.0, order_type="1"))
+
+        assert stale.status == "4"
+        assert [(m.sell_order_id, m.qty) for m in matches] == [(102, 20)]
+        assert result.filled_qty == 20
+
+    def test_duplicate_order_id_rejected(self, engine):
+        """Test an order ID already resting is not accepted."""
+        result, matches = engine.submit_order("AAPL", make_order(1, "2", 10, 140.0))
+
+        assert not result.accepted
+        assert matches == []
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE, reason="C++ engine not compiled")
+class TestBatchEntry:
+    """Test batch submission and cancellation."""
+
+    def test_submit_list(self):
+        """Test a list of orders is matched in order."""
+        engine = crucible_engine.MatchingEngine()
+        orders = [
+            make_order(1, "1", 100, 150.0),
+            make_order(2, "1", 100, 150.0),
+            make_order(101, "2", 150, 150.0),
+        ]
+
+        matches = engine.submit_batch("AAPL", orders)
+
+        assert [(m.buy_order_id, m.qty) for m in matches] == [(1, 100), (2, 50)]
+
+    def test_cancel_list(self):
+        """Test batch cancel counts only resting orders."""
+        engine = crucible_engine.MatchingEngine()
+        engine.submit_batch("AAPL", [make_order(1, "1", 100, 150.0), make_order(2, "1", 100, 150.0)])
+
+        assert engine.cancel_batch("AAPL", [1, 2, 3]) == 2
+        assert engine.get_book("AAPL").get_buy_depth() == {}
+
+    def test_submit_structured_array(self):
+        """Test NumPy batches return fills as a structured array."""
+        np = pytest.importorskip("numpy")
+        engine = crucible_engine.MatchingEngine()
+        symbol_id = engine.get_or_create_book("AAPL").symbol_id()
+
+        orders = np.zeros(2, dtype=crucible_engine.batch_order_dtype())
+        orders["symbol_id"] = symbol_id
+        orders["order_id"] = [1, 101]
+        orders["side"] = [ord("1"), ord("2")]
+        orders["order_type"] = ord("2")
+        orders["qty"] = [100, 40]
+        orders["price"] = 150.0
+        orders["cl_ord_id"] = [b"CL_1", b"CL_101"]
+
+        fills = engine.submit_batch(orders)
+
+        assert fills.dtype == crucible_engine.match_dtype()
+        assert list(fills["qty"]) == [40]
+        assert fills["buy_order_id"][0] == 1
+
+        cancels = np.zeros(1, dtype=crucible_engine.batch_cancel_dtype())
+        cancels["order_id"] = 1
+        cancels["symbol_id"] = symbol_id
+        assert engine.cancel_batch(cancels) == 1
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE, reason="C++ engine not compiled")
+class TestExchangeOrderBook:
+    """Test the server's OrderBook running on the C++ engine."""
+
+    @pytest.fixture
+    def order_book(self):
+        from exchange_server import OrderBook
+        order_book = OrderBook()
+        assert order_book.cpp_engine is not None
+        yield order_book
+        order_book.stop()
+
+    @staticmethod
+    def server_order(order_id, side, qty, price):
+        from exchange_server import Order
+        return Order(order_id, f"CL_{order_id}", "AAPL", side, qty, "2", price)
+
+    def test_matches_update_python_orders(self, order_book):
+        """Test native fills are mirrored onto the server's orders."""
+        order_book.add_order(self.server_order("B1", "1", 100, 150.0))
+        order_book.add_order(self.server_order("B2", "1", 100, 151.0))
+        order_book.add_order(self.server_order("S1", "2", 150, 150.0))
+
+        matches = order_book.match_orders("AAPL")
+
+        assert [(b.order_id, s.order_id, qty) for b, s, qty, _ in matches] == [
+            ("B2", "S1", 100),
+            ("B1", "S1", 50),
+        ]
+        assert order_book.get_order("B1").status == "1"
+        assert order_book.get_order("S1").is_complete
+        assert len(order_book.executions) == 2
+
+    def test_cancel_and_snapshot(self, order_book):
+        """Test cancel removes the order from the native book and snapshot."""
+        order_book.add_order(self.server_order("B1", "1", 100, 150.0))
+        order_book.add_order(self.server_order("B2", "1", 100, 149.0))
+
+        assert order_book.cancel_order("B1")
+
+        snapshot = order_book.get_order_book_snapshot()
+        assert [o['order_id'] for o in snapshot['buy_orders']['AAPL']] == ["B2"]
+        assert order_book.cpp_engine.get_book("AAPL").get_best_bid() == pytest.approx(149.0)
+
+    def test_market_order_fills_past_resting_bids(self, order_book):
+        """Test a market buy matches on entry instead of resting behind the limit bids."""
+        from exchange_server import Order
+        order_book.add_order(self.server_order("B1", "1", 100, 149.0))
+        order_book.add_order(self.server_order("S1", "2", 50, 150.0))
+        market = Order("M1", "CL_M1", "AAPL", "1", 80, "1", None)
+
+        order_book.add_order(market)
+        matches = order_book.match_orders("AAPL")
+
+        assert [(b.order_id, s.order_id, qty) for b, s, qty, _ in matches] == [("M1", "S1", 50)]
+        assert (market.filled_qty, market.status) == (50, "4")
+        assert order_book.cpp_engine.get_book("AAPL").get_best_bid() == pytest.approx(149.0)
+
+    def test_cancel_by_cl_ord_id(self, order_book):
+        """Test cancel finds the order through the native client order ID index."""
+        order_book.add_order(self.server_order("B1", "1", 100, 150.0))
+
+        order = order_book.cancel_by_cl_ord_id("AAPL", "CL_B1")
+
+        assert order.order_id == "B1" and order.status == "4"
+        assert order_book.cancel_by_cl_ord_id("AAPL", "CL_B1") is None
+        assert order_book.cpp_engine.get_book("AAPL").get_best_bid() == 0.0
+
+    def test_long_cl_ord_id_rejected(self, order_book):
+        """Test a ClOrdID too long for the native book is refused rather than truncated."""
+        from exchange_server import Order
+        long_id = "X" * 30
+        with pytest.raises(ValueError):
+            order_book.add_order(Order("B1", long_id, "AAPL", "1", 100, "2", 150.0))
+
+        assert order_book.get_order("B1") is None
+        assert order_book.cpp_engine.get_book("AAPL") is None
+
+    def test_refused_native_order_not_recorded(self, order_book):
+        """Test an order the native book cannot take leaves no record behind."""
+        from exchange_server import Order
+        with pytest.raises(TypeError):
+            order_book.add_order(Order("B1", None, "AAPL", "1", 100, "2", 150.0))
+
+        assert order_book.get_order("B1") is None
+
+    def test_level_deltas_published(self, order_book, monkeypatch):
+        """Test book changes reach the publisher as level deltas that continue the level snapshot."""
+        sent = []
+        monkeypatch.setattr(order_book.market_data, "update_levels", sent.extend)
+        order_book.add_order(self.server_order("B1", "1", 100, 150.0))
+        order_book.publish_market_data()
+        seq = order_book.get_level_snapshot()["AAPL"]["seq"]
+
+        order_book.add_order(self.server_order("S1", "2", 40, 150.0))
+        order_book.match_orders("AAPL")
+        order_book.publish_market_data()
+
+        # S1 fills on entry and never rests, so only the bid level changes
+        assert [d["seq"] for d in sent] == list(range(1, seq + 2))
+        assert (sent[-1]["side"], sent[-1]["qty"]) == ("Buy", 60)
+        assert order_book.get_level_snapshot()["AAPL"]["bids"] == [[pytest.approx(150.0), 60, 1]]
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE, reason="C++ engine not compiled")
+class TestTopOfBook:
+    """Test the seqlock-published top of book."""
+
+    @pytest.fixture
+    def book(self):
+        book = crucible_engine.OrderBook("AAPL")
+        book.add_order(make_order(1, "1", 100, 150.0))
+        book.add_order(make_order(2, "1", 50, 150.0))
+        book.add_order(make_order(3, "2", 30, 151.0))
+        return book
+
+    def test_best_level_quantity(self, book):
+        """Test the snapshot carries total quantity at each best level."""
+        top = book.top_of_book()
+
+        assert (top.bid_ticks, top.bid_qty) == (15000, 150)
+        assert (top.ask_ticks, top.ask_qty) == (15100, 30)
+        assert book.get_spread() == pytest.approx(1.0)
+
+    def test_last_trade_and_sequence(self, book):
+        """Test fills update the last trade and every change bumps the sequence."""
+        before = book.top_of_book().sequence
+        book.submit_order(make_order(101, "2", 120, 150.0))
+        top = book.top_of_book()
+
+        assert top.sequence > before
+        assert (top.last_ticks, top.last_qty) == (15000, 20)
+        assert (top.bid_ticks, top.bid_qty) == (15000, 30)
+
+    def test_cancel_and_replace_update_quantity(self, book):
+        """Test cancels and quantity changes are reflected at the best level."""
+        book.cancel_order(1)
+        assert book.top_of_book().bid_qty == 50
+
+        book.replace_order(2, 20)
+        assert book.top_of_book().bid_qty == 20
+
+        book.cancel_order(2)
+        top = book.top_of_book()
+        assert (top.bid_ticks, top.bid_qty) == (0, 0)
+        assert book.get_spread() == 0.0
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE, reason="C++ engine not compiled")
+class TestDepthLevels:
+    """Test aggregated per-level quantity and top-N depth."""
+
+    @pytest.fixture
+    def book(self):
+        pytest.importorskip("numpy")
+        book = crucible_engine.OrderBook("AAPL")
+        book.add_order(make_order(1, "1", 100, 150.0))
+        book.add_order(make_order(2, "1", 40, 150.0))
+        book.add_order(make_order(3, "1", 25, 149.0))
+        book.add_order(make_order(4, "1", 10, 148.0))
+        book.add_order(make_order(101, "2", 30, 152.0))
+        return book
+
+    def test_levels_best_first(self, book):
+        """Test bids come back highest first with quantity and order count."""
+        depth = book.get_depth("1", 10)
+
+        assert depth["price_ticks"].tolist() == [15000, 14900, 14800]
+        assert depth["qty"].tolist() == [140, 25, 10]
+        assert depth["order_count"].tolist() == [2, 1, 1]
+
+    def test_levels_truncated(self, book):
+        """Test only the requested number of levels is returned."""
+        depth = book.get_depth("1", 2)
+
+        assert depth.dtype == crucible_engine.depth_level_dtype()
+        assert depth["price"].tolist() == pytest.approx([150.0, 149.0])
+
+    def test_quantity_follows_fills_and_cancels(self, book):
+        """Test partial fills and cancels update the level total."""
+        book.submit_order(make_order(102, "2", 60, 150.0))
+        book.cancel_order(3)
+
+        depth = book.get_depth("1", 10)
+        assert depth["qty"].tolist() == [80, 10]
+        assert depth["order_count"].tolist() == [2, 1]
+        assert book.get_depth("2", 10)["qty"].tolist() == [30]
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE, reason="C++ engine not compiled")
+class TestLevelFeed:
+    """Test L2 level deltas and snapshots from the native book."""
+
+    @pytest.fixture
+    def engine(self):
+        engine = crucible_engine.MatchingEngine()
+        config = crucible_engine.BookConfig()
+        config.event_capacity = 256
+        assert engine.set_default_config(config)
+        return engine
+
+    @staticmethod
+    def level_updates(engine):
+        return [e for e in engine.drain_events() if e.type == crucible_engine.EventType.BookUpdate]
+
+    def test_updates_carry_level_totals(self, engine):
+        """Test each level change reports the new quantity, order count and sequence."""
+        engine.add_order("AAPL", make_order(1, "1", 100, 150.0))
+        engine.add_order("AAPL", make_order(2, "1", 50, 150.0))
+        engine.submit_order("AAPL", make_order(101, "2", 120, 150.0))
+
+        updates = self.level_updates(engine)
+        assert [(e.side, e.qty, e.leaves_qty, e.sequence) for e in updates] == [
+            ("1", 100, 1, 1),
+            ("1", 150, 2, 2),
+            ("1", 50, 1, 3),
+            ("1", 30, 1, 4),
+        ]
+
+    def test_deltas_apply_on_snapshot(self, engine):
+        """Test deltas newer than a snapshot rebuild the current book."""
+        engine.add_order("AAPL", make_order(1, "1", 100, 150.0))
+        engine.add_order("AAPL", make_order(2, "2", 80, 152.0))
+        snapshot = engine.get_book("AAPL").snapshot()
+        levels = {("1", l.price_ticks): l.qty for l in snapshot.bids}
+        levels.update({("2", l.price_ticks): l.qty for l in snapshot.asks})
+
+        engine.add_order("AAPL", make_order(3, "2", 20, 151.0))
+        engine.cancel_order("AAPL", 2)
+        engine.replace_order("AAPL", 1, 60)
+
+        for e in self.level_updates(engine):
+            if e.sequence <= snapshot.sequence:
+                continue
+            if e.qty == 0:
+                del levels[(e.side, e.price_ticks)]
+            else:
+                levels[(e.side, e.price_ticks)] = e.qty
+        assert levels == {("1", 15000): 60, ("2", 15100): 20}
+
+        current = engine.get_book("AAPL").snapshot(1)
+        assert current.sequence == 5
+        assert [(l.price_ticks, l.qty, l.order_count) for l in current.asks] == [(15100, 20, 1)]
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE, reason="C++ engine not compiled")
+class TestL3Feed:
+    """Test the order-by-order market data feed."""
+
+    @pytest.fixture
+    def engine(self):
+        engine = crucible_engine.MatchingEngine()
+        config = crucible_engine.BookConfig()
+        config.l3_capacity = 256
+        assert engine.set_default_config(config)
+        return engine
+
+    def test_records_follow_order_lifecycle(self, engine):
+        """Test adds, executions, amends and cancels each emit one sequenced record."""
+        np = pytest.importorskip("numpy")
+        L3Type = crucible_engine.L3Type
+        engine.add_order("AAPL", make_order(1, "1", 100, 150.0))
+        engine.add_order("AAPL", make_order(2, "1", 50, 150.0))
+        engine.submit_order("AAPL", make_order(101, "2", 120, 150.0))
+        engine.replace_order("AAPL", 2, 40)
+        engine.replace_order("AAPL", 2, 40, 149.0)
+        engine.cancel_order("AAPL", 2)
+
+        records = engine.drain_l3()
+        assert records.dtype == crucible_engine.l3_event_dtype()
+        assert list(records["sequence"]) == list(range(1, 9))
+        assert [(L3Type(int(r["type"])), int(r["order_id"]), int(r["price_ticks"]), int(r["qty"]))
+                for r in records] == [
+            (L3Type.Add, 1, 15000, 100),
+            (L3Type.Add, 2, 15000, 50),
+            (L3Type.Execute, 1, 15000, 100),
+            (L3Type.Execute, 2, 15000, 20),
+            (L3Type.Modify, 2, 15000, 20),
+            (L3Type.Delete, 2, 15000, 20),
+            (L3Type.Add, 2, 14900, 20),
+            (L3Type.Delete, 2, 14900, 20),
+        ]
+        assert np.all(records["side"] == b"1")
+        assert len(engine.drain_l3()) == 0
+
+    def test_export_appends_raw_records(self, engine, tmp_path):
+        """Test exported files read back as l3_event_dtype arrays."""
+        np = pytest.importorskip("numpy")
+        engine.add_order("AAPL", make_order(1, "1", 100, 150.0))
+        engine.add_order("MSFT", make_order(2, "2", 10, 380.0))
+        path = tmp_path / "l3.bin"
+
+        assert engine.export_l3(str(path)) == 2
+        engine.cancel_order("AAPL", 1)
+        assert engine.export_l3(str(path)) == 1
+
+        records = np.fromfile(path, dtype=crucible_engine.l3_event_dtype())
+        assert [(int(r["symbol_id"]), int(r["sequence"]), int(r["order_id"])) for r in records] == [
+            (0, 1, 1), (1, 1, 2), (0, 2, 1),
+        ]
+        assert engine.l3_dropped() == 0
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE, reason="C++ engine not compiled")
+class TestJournal:
+    """Test journaling engine inputs and rebuilding books by replay."""
+
+    @staticmethod
+    def book_state(engine, symbol):
+        book = engine.get_book(symbol)
+        return ([(l.price_ticks, l.qty, l.order_count) for l in book.get_depth("1", 100)],
+                [(l.price_ticks, l.qty, l.order_count) for l in book.get_depth("2", 100)],
+                book.top_of_book().last_ticks)
+
+    def test_replay_rebuilds_books(self, tmp_path):
+        """Test adds, submits, replaces, matches and cancels replay to the same books."""
+        path = str(tmp_path / "engine.journal")
+        engine = crucible_engine.MatchingEngine()
+        assert engine.open_journal(path)
+        assert not engine.open_journal(path)
+        engine.add_order("AAPL", make_order(1, "1", 100, 150.0))
+        engine.add_order("AAPL", make_order(2, "2", 50, 151.0))
+        engine.add_order("MSFT", make_order(3, "1", 10, 300.0))
+        engine.submit_order("AAPL", make_order(4, "2", 30, 149.0))
+        engine.replace_order("AAPL", 2, 50, 150.0)
+        engine.match_orders("AAPL")
+        engine.cancel_order("MSFT", 3)
+        engine.add_order("MSFT", make_order(5, "2", 10, 301.0))
+        assert engine.sync_journal() == 9  # Two symbols and seven inputs; the replace crossed
+        assert engine.close_journal()
+
+        replayed = crucible_engine.MatchingEngine()
+        assert replayed.replay(path) == 7
+        for symbol in ("AAPL", "MSFT"):
+            assert self.book_state(replayed, symbol) == self.book_state(engine, symbol)
+        assert replayed.find_by_cl_ord_id("MSFT", "CL_5").order_id == 5
+        assert replayed.next_order_id() > 5
+
+    def test_reopen_appends_and_torn_tail_is_dropped(self, tmp_path):
+        """Test a reopened journal continues its sequence and a damaged last record is ignored."""
+        path = tmp_path / "engine.journal"
+        engine = crucible_engine.MatchingEngine()
+        engine.open_journal(str(path))
+        engine.add_order("AAPL", make_order(1, "1", 100, 150.0))
+        engine.close_journal()
+
+        engine.open_journal(str(path))
+        engine.add_order("AAPL", make_order(2, "1", 20, 149.0))
+        engine.add_order("AAPL", make_order(3, "1", 30, 148.0))
+        assert engine.sync_journal() == 5  # The reopen names AAPL again
+        engine.close_journal()
+
+        data = bytearray(path.read_bytes())
+        data[-8] ^= 0xff
+        path.write_bytes(bytes(data))
+        replayed = crucible_engine.MatchingEngine()
+        assert replayed.replay(str(path)) == 2
+        assert [l.price_ticks for l in replayed.get_book("AAPL").get_depth("1", 10)] == [15000, 14900]
+
+    def test_replay_refused_while_journaling(self, tmp_path):
+        """Test replay will not run into an engine whose journal is open."""
+        path = str(tmp_path / "engine.journal")
+        engine = crucible_engine.MatchingEngine()
+        engine.open_journal(path)
+        with pytest.raises(RuntimeError):
+            engine.replay(path)
+        engine.close_journal()
+        with pytest.raises(RuntimeError):
+            engine.replay(str(tmp_path / "missing.journal"))
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE, reason="C++ engine not compiled")
+class TestSnapshot:
+    """Test writing book snapshots and restoring them with the journal tail."""
+
+    def test_restore_rebuilds_books(self, tmp_path):
+        """Test a restored engine has the same levels, queue priority, last trade and ids."""
+        path = str(tmp_path / "books.snap")
+        engine = crucible_engine.MatchingEngine()
+        engine.add_order("AAPL", make_order(1, "1", 100, 150.0))
+        engine.add_order("AAPL", make_order(2, "1", 40, 150.0))
+        engine.add_order("AAPL", make_order(3, "2", 30, 149.0))
+        engine.match_orders("AAPL")
+        engine.add_order("MSFT", make_order(4, "2", 10, 301.0))
+        assert engine.snapshot(path)
+        assert engine.wait_snapshot() == 3
+
+        restored = crucible_engine.MatchingEngine()
+        assert restored.restore(path) == 3
+        for symbol in ("AAPL", "MSFT"):
+            assert TestJournal.book_state(restored, symbol) == TestJournal.book_state(engine, symbol)
+        first = restored.find_by_cl_ord_id("AAPL", "CL_1")
+        assert (first.filled_qty, first.status) == (30, "1")
+        assert restored.match_orders("AAPL") == []
+        restored.add_order("AAPL", make_order(5, "2", 80, 150.0))
+        assert [m.buy_order_id for m in restored.match_orders("AAPL")] == [1, 2]
+        assert restored.next_order_id() > 5
+
+    def test_restore_then_replay_applies_only_the_tail(self, tmp_path):
+        """Test journal records a snapshot already holds are not applied twice."""
+        journal, snap = str(tmp_path / "engine.journal"), str(tmp_path / "books.snap")
+        engine = crucible_engine.MatchingEngine()
+        engine.open_journal(journal)
+        engine.add_order("AAPL", make_order(1, "1", 100, 150.0))
+        engine.add_order("AAPL", make_order(2, "2", 50, 151.0))
+        assert engine.snapshot(snap)
+        engine.wait_snapshot()
+        engine.cancel_order("AAPL", 1)
+        engine.add_order("MSFT", make_order(3, "1", 10, 300.0))
+        engine.close_journal()
+
+        restored = crucible_engine.MatchingEngine()
+        assert restored.restore(snap) == 2
+        assert restored.replay(journal) == 2
+        for symbol in ("AAPL", "MSFT"):
+            assert TestJournal.book_state(restored, symbol) == TestJournal.book_state(engine, symbol)
+
+    def test_damaged_snapshot_is_refused(self, tmp_path):
+        """Test a snapshot with a changed byte does not restore."""
+        path = tmp_path / "books.snap"
+        engine = crucible_engine.MatchingEngine()
+        engine.add_order("AAPL", make_order(1, "1", 100, 150.0))
+        engine.snapshot(str(path))
+        engine.wait_snapshot()
+
+        data = bytearray(path.read_bytes())
+        data[-1] ^= 0xff
+        path.write_bytes(bytes(data))
+        with pytest.raises(RuntimeError):
+            crucible_engine.MatchingEngine().restore(str(path))
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE, reason="C++ engine not compiled")
+class TestFixParser:
+    """Test the native FIX tag=value parser."""
+
+    NEW_ORDER = ("8=FIX.4.2\x019=90\x0135=D\x0149=CLIENT\x0156=EXCHANGE\x01"
+                 "11=ORD1\x0155=AAPL\x0154=2\x0138=250\x0140=2\x0144=150.25\x0158=a=b\x0110=000\x01")
+
+    def test_fields_by_tag(self):
+        """Test tags are found by int or string, values may contain '='."""
+        message = crucible_engine.parse_fix(self.NEW_ORDER.encode())
+
+        assert message.get(35) == "D"
+        assert message["55"] == "AAPL"
+        assert message.get("58") == "a=b"
+        assert message.get_int(38) == 250
+        assert "112" not in message
+        assert message.get("112", "none") == "none"
+        assert message.fields()[:3] == [(8, "FIX.4.2"), (9, "90"), (35, "D")]
+
+    def test_decodes_new_order(self):
+        """Test a New Order Single decodes straight into a native order."""
+        symbol, order = crucible_engine.parse_fix(self.NEW_ORDER).new_order()
+
+        assert symbol == "AAPL"
+        assert (order.cl_ord_id, order.side, order.order_qty, order.order_type) == ("ORD1", "2", 250, "2")
+        assert order.price == pytest.approx(150.25)
+
+    def test_rejects_bad_input(self):
+        """Test malformed messages and bad order fields are reported."""
+        assert crucible_engine.parse_fix("35=D\x0155AAPL\x01") is None
+        assert crucible_engine.parse_fix("35=D") is None
+
+        message = crucible_engine.parse_fix(self.NEW_ORDER.replace("38=250", "38=x"))
+        with pytest.raises(ValueError, match="tag 38"):
+            message.new_order()
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE, reason="C++ engine not compiled")
+class TestFixEncoder:
+    """Test the native FIX message encoder."""
+
+    @staticmethod
+    def check_framing(raw):
+        """Assert BodyLength and CheckSum match the encoded bytes."""
+        data = raw.encode()
+        body_start = data.index(b"\x01", data.index(b"9=")) + 1
+        trailer = data.rindex(b"10=")
+        message = crucible_engine.parse_fix(data)
+        assert message.get_int(9) == trailer - body_start
+        assert message.get_int(10) == crucible_engine.fix_checksum(data[:trailer])
+        return message
+
+    def test_execution_report(self):
+        """Test execution reports carry the order fields and formatted prices."""
+        encoder = crucible_engine.FixEncoder("EXCHANGE", "CLIENT")
+        raw = encoder.execution_report("ORD000001", "CL_1", "EXEC000001", "1", "1", "AAPL", "2",
+                                       100, 40, 150.5, 40, 150.5)
+
+        message = self.check_framing(raw)
+        assert [message.get(tag) for tag in (35, 49, 56, 34)] == ["8", "EXCHANGE", "CLIENT", "1"]
+        assert [message.get(tag) for tag in (37, 11, 17, 150, 39, 55, 54)] == [
+            "ORD000001", "CL_1", "EXEC000001", "1", "1", "AAPL", "2"]
+        assert [message.get(tag) for tag in (38, 32, 31, 14, 6)] == ["100", "40", "150.50", "40", "150.50"]
+        assert 58 not in message
+
+    def test_sequence_and_text(self):
+        """Test each message takes the next MsgSeqNum and text is optional."""
+        encoder = crucible_engine.FixEncoder("EXCHANGE", "CLIENT")
+        encoder.seq_num = 7
+        reject = encoder.execution_report("ORD2", "CL_2", "EXEC2", "8", "8", "XYZ", "1", 10, 0, 0.0, 0, 0.0,
+                                          "Invalid symbol: XYZ")
+        heartbeat = encoder.message("0", "112=T1\x01")
+
+        assert self.check_framing(reject).get(58) == "Invalid symbol: XYZ"
+        assert self.check_framing(heartbeat).get(112) == "T1"
+        assert [crucible_engine.parse_fix(m).get(34) for m in (reject, heartbeat)] == ["7", "8"]
+        assert encoder.seq_num == 9
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE, reason="C++ engine not compiled")
+class TestFixValidation:
+    """Test the one-pass FIX framing check."""
+
+    @pytest.fixture
+    def message(self):
+        encoder = crucible_engine.FixEncoder("CLIENT", "EXCHANGE")
+        return encoder.message("D", "11=ORD1\x0155=AAPL\x0154=1\x0138=100\x0140=2\x0144=150.00\x01" + "58=" + "x" * 100 + "\x01")
+
+    def test_valid_message(self, message):
+        """Test an encoded message passes with the checksum and length it declares."""
+        result = crucible_engine.validate_fix(message.encode())
+        parsed = crucible_engine.parse_fix(message)
+
+        assert result.ok
+        assert result.checksum == parsed.get_int(10)
+        assert result.body_length == parsed.get_int(9)
+
+    def test_each_failure(self, message):
+        """Test checksum, body length, header and trailer errors are told apart."""
+        FixCheck = crucible_engine.FixCheck
+        checksum = message[message.rfind("10="):]
+        body_length = message.split("\x01")[1]
+
+        bad_checksum = message[:-len(checksum)] + "10=%03d\x01" % ((int(checksum[3:6]) + 1) % 256)
+        assert crucible_engine.validate_fix(bad_checksum).status == FixCheck.BadChecksum
+        bad_length = message.replace(body_length, body_length + "0", 1)
+        assert crucible_engine.validate_fix(bad_length).status == FixCheck.BadBodyLength
+        no_sender = message.replace("\x0149=", "\x0150=", 1)
+        result = crucible_engine.validate_fix(no_sender)
+        assert (result.status, result.tag) == (FixCheck.MissingTag, 49)
+        assert crucible_engine.validate_fix(message[:-1]).status == FixCheck.BadTrailer
+        assert crucible_engine.validate_fix("35=D\x01").status == FixCheck.BadBeginString
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE or not hasattr(crucible_engine, "FixGateway"),
+                    reason="C++ engine not compiled or no epoll gateway on this platform")
+class TestFixGateway:
+    """Test the native FIX gateway over loopback with each network backend."""
+
+    @pytest.fixture
+    def engine(self):
+        return crucible_engine.MatchingEngine()
+
+    @pytest.fixture(params=["Epoll", "IoUring"])
+    def gateway(self, engine, request):
+        backend = getattr(crucible_engine.GatewayBackend, request.param)
+        gateway = crucible_engine.FixGateway(engine, ["AAPL"], logon=lambda sender, target: sender != "BLOCKED",
+                                             backend=backend)
+        if not gateway.start("127.0.0.1", 0):
+            assert request.param == "IoUring"
+            pytest.skip("io_uring not available in this kernel")
+        yield gateway
+        gateway.stop()
+
+    @staticmethod
+    def receive(sock, count):
+        """Read until count complete messages have arrived and parse them."""
+        data = b""
+        while len(re.findall(rb"\x0110=\d{3}\x01", data)) < count:
+            chunk = sock.recv(65536)
+            if not chunk:
+                break
+            data += chunk
+        messages = re.findall(rb"8=FIX.*?\x0110=\d{3}\x01", data, re.S)
+        return [crucible_engine.parse_fix(m) for m in messages]
+
+    def connect(self, gateway, sender):
+        """Open a session and log on; returns the socket and the client's encoder."""
+        sock = socket.create_connection(("127.0.0.1", gateway.port()), timeout=5)
+        encoder = crucible_engine.FixEncoder(sender, "EXCHANGE")
+        sock.sendall(encoder.message("A", "108=30\x01").encode())
+        return sock, encoder
+
+    def test_logon_and_heartbeat(self, gateway):
+        """Test logon is acknowledged and a test request is answered with its id."""
+        sock, encoder = self.connect(gateway, "CLIENT1")
+        with sock:
+            logon, = self.receive(sock, 1)
+            assert [logon.get(tag) for tag in (35, 49, 56, 108)] == ["A", "EXCHANGE", "CLIENT1", "30"]
+
+            sock.sendall(encoder.message("1", "112=PING\x01").encode())
+            heartbeat, = self.receive(sock, 1)
+            assert heartbeat.get(35) == "0" and heartbeat.get(112) == "PING"
+            assert gateway.session_count() == 1
+
+    def test_refused_logon_closes_session(self, gateway):
+        """Test the logon policy can refuse a session."""
+        sock, _ = self.connect(gateway, "BLOCKED")
+        with sock:
+            logout, = self.receive(sock, 1)
+            assert logout.get(35) == "5" and logout.get(58) == "Logon refused"
+            assert sock.recv(1) == b""
+
+    def test_fill_reports_reach_both_sessions(self, gateway):
+        """Test a cross reports to the incoming order's session and the resting order's owner."""
+        seller, sell_encoder = self.connect(gateway, "SELLER")
+        buyer, buy_encoder = self.connect(gateway, "BUYER")
+        with seller, buyer:
+            self.receive(seller, 1)
+            self.receive(buyer, 1)
+
+            # Split mid-message to exercise framing across reads
+            order = sell_encoder.message("D", "11=S1\x0155=AAPL\x0154=2\x0138=100\x0140=2\x0144=150.00\x01").encode()
+            seller.sendall(order[:20])
+            time.sleep(0.01)
+            seller.sendall(order[20:])
+            ack, = self.receive(seller, 1)
+            assert [ack.get(tag) for tag in (150, 39, 11)] == ["0", "0", "S1"]
+
+            buyer.sendall(buy_encoder.message("D", "11=B1\x0155=AAPL\x0154=1\x0138=60\x0140=2\x0144=151\x01").encode())
+            ack, fill = self.receive(buyer, 2)
+            assert ack.get(150) == "0"
+            assert [fill.get(tag) for tag in (150, 32, 31, 14)] == ["2", "60", "150.00", "60"]
+
+            resting_fill, = self.receive(seller, 1)
+            assert [resting_fill.get(tag) for tag in (11, 150, 39, 32, 14)] == ["S1", "1", "1", "60", "60"]
+            assert gateway.stats().orders == 2
+
+    def test_cancel_and_reject(self, gateway):
+        """Test cancels reach only the owner's orders and bad orders are rejected."""
+        owner, owner_encoder = self.connect(gateway, "OWNER")
+        other, other_encoder = self.connect(gateway, "OTHER")
+        with owner, other:
+            self.receive(owner, 1)
+            self.receive(other, 1)
+            owner.sendall(owner_encoder.message("D", "11=O1\x0155=AAPL\x0154=1\x0138=10\x0140=2\x0144=99\x01").encode())
+            self.receive(owner, 1)
+
+            other.sendall(other_encoder.message("F", "11=X1\x0141=O1\x0155=AAPL\x01").encode())
+            other.sendall(other_encoder.message("D", "11=X2\x0155=MSFT\x0154=1\x0138=10\x0140=2\x0144=99\x01").encode())
+            cancel_reject, order_reject = self.receive(other, 2)
+            assert cancel_reject.get(39) == "8" and cancel_reject.get(58) == "Order not found"
+            assert order_reject.get(150) == "8" and order_reject.get(58) == "Invalid symbol: MSFT"
+
+            owner.sendall(owner_encoder.message("F", "11=O2\x0141=O1\x0155=AAPL\x01").encode())
+            canceled, = self.receive(owner, 1)
+            assert [canceled.get(tag) for tag in (150, 39, 11)] == ["4", "4", "O1"]
+
+    def test_same_cl_ord_id_in_two_sessions(self, gateway):
+        """Test ClOrdIDs are per session: each session cancels its own order with a shared id."""
+        first, first_encoder = self.connect(gateway, "FIRST")
+        second, second_encoder = self.connect(gateway, "SECOND")
+        with first, second:
+            self.receive(first, 1)
+            self.receive(second, 1)
+            first.sendall(first_encoder.message("D", "11=SAME\x0155=AAPL\x0154=1\x0138=10\x0140=2\x0144=99\x01").encode())
+            first_ack, = self.receive(first, 1)
+            second.sendall(second_encoder.message("D", "11=SAME\x0155=AAPL\x0154=1\x0138=20\x0140=2\x0144=98\x01").encode())
+            second_ack, = self.receive(second, 1)
+
+            second.sendall(second_encoder.message("F", "11=X1\x0141=SAME\x0155=AAPL\x01").encode())
+            canceled, = self.receive(second, 1)
+            assert [canceled.get(tag) for tag in (150, 37, 38)] == ["4", second_ack.get(37), "20"]
+
+            first.sendall(first_encoder.message("F", "11=X2\x0141=SAME\x0155=AAPL\x01").encode())
+            canceled, = self.receive(first, 1)
+            assert [canceled.get(tag) for tag in (150, 37, 38)] == ["4", first_ack.get(37), "10"]
+
+    def test_sharded_engine_refused(self, engine):
+        """Test the gateway will not start on a sharded engine, whose books are single-writer."""
+        gateway = crucible_engine.FixGateway(engine, ["AAPL"])
+        engine.start_shards(1)
+        try:
+            assert not gateway.start("127.0.0.1", 0)
+        finally:
+            engine.stop_shards()
+        assert gateway.start("127.0.0.1", 0)
+        gateway.stop()
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE or not hasattr(crucible_engine, "FixGateway"),
+                    reason="C++ engine not compiled or no epoll gateway on this platform")
+class TestBinaryGateway:
+    """Test the gateway's binary order entry port with each network backend."""
+
+    HEADER = struct.Struct("<HcB")
+    REPLIES = {b"l": struct.Struct("<HcBB3x"), b"A": struct.Struct("<HcBcc2xQQqII"),
+               b"F": struct.Struct("<HcBc3xIQQQqII"), b"J": struct.Struct("<HcBcB2xQ")}
+
+    @pytest.fixture(params=["Epoll", "IoUring"])
+    def gateway(self, request):
+        engine = crucible_engine.MatchingEngine()
+        backend = getattr(crucible_engine.GatewayBackend, request.param)
+        gateway = crucible_engine.FixGateway(engine, ["AAPL"], logon=lambda sender, target: sender != "BLOCKED",
+                                             backend=backend)
+        if not gateway.start("127.0.0.1", 0, binary_port=0):
+            assert request.param == "IoUring"
+            pytest.skip("io_uring not available in this kernel")
+        yield gateway
+        gateway.stop()
+
+    @staticmethod
+    def logon(comp_id):
+        return struct.pack("<HcB16s", 20, b"L", 1, comp_id.encode())
+
+    @staticmethod
+    def new_order(client_order_id, side, qty, price, symbol="AAPL"):
+        return struct.pack("<HcBQ8sqIcc2x", 36, b"N", 1, client_order_id, symbol.encode(), int(price * 10000), qty,
+                           side.encode(), b"2")
+
+    @staticmethod
+    def cancel(client_order_id, symbol="AAPL"):
+        return struct.pack("<HcBQ8s", 20, b"C", 1, client_order_id, symbol.encode())
+
+    @staticmethod
+    def replace(client_order_id, qty, price, symbol="AAPL"):
+        return struct.pack("<HcBQ8sqI4x", 36, b"R", 1, client_order_id, symbol.encode(), int(price * 10000), qty)
+
+    def receive(self, sock, count):
+        """Read count replies; each is a tuple of its fields, type third."""
+        replies, data = [], b""
+        while len(replies) < count:
+            chunk = sock.recv(65536)
+            if not chunk:
+                break
+            data += chunk
+            while len(data) >= self.HEADER.size and len(data) >= self.HEADER.unpack_from(data)[0]:
+                length, kind, _ = self.HEADER.unpack_from(data)
+                replies.append(self.REPLIES[kind].unpack_from(data))
+                data = data[length:]
+        return replies
+
+    def connect(self, gateway, comp_id):
+        sock = socket.create_connection(("127.0.0.1", gateway.binary_port()), timeout=5)
+        sock.sendall(self.logon(comp_id))
+        return sock
+
+    def test_logon(self, gateway):
+        """Test logons are decided by the same policy as FIX sessions."""
+        assert gateway.binary_port() not in (0, gateway.port())
+        with self.connect(gateway, "CLIENT1") as sock:
+            assert self.receive(sock, 1) == [(8, b"l", 1, 1)]
+        with self.connect(gateway, "BLOCKED") as sock:
+            assert self.receive(sock, 1) == [(8, b"l", 1, 0)]
+            assert sock.recv(1) == b""
+
+    def test_fill_replace_and_cancel(self, gateway):
+        """Test a replace that crosses fills both sides, and cancels reach only the owner's orders."""
+        seller, buyer = self.connect(gateway, "SELLER"), self.connect(gateway, "BUYER")
+        with seller, buyer:
+            self.receive(seller, 1)
+            self.receive(buyer, 1)
+
+            # Split mid-message to exercise framing across reads
+            order = self.new_order(7, "2", 100, 150.0)
+            seller.sendall(order[:10])
+            time.sleep(0.01)
+            seller.sendall(order[10:])
+            ack, = self.receive(seller, 1)
+            assert ack[3:5] == (b"N", b"2") and ack[5] == 7 and ack[7:] == (1500000, 100, 0)
+
+            buyer.sendall(self.new_order(9, "1", 40, 149.0))
+            self.receive(buyer, 1)
+            buyer.sendall(self.replace(9, 40, 151.0))
+            replaced, fill = self.receive(buyer, 2)
+            assert replaced[3] == b"R" and replaced[7] == 1510000
+            assert fill[1] == b"F" and fill[5] == 9 and fill[8:] == (1500000, 40, 40)
+
+            resting_fill, = self.receive(seller, 1)
+            assert resting_fill[4] == 60 and resting_fill[5] == 7 and resting_fill[8:] == (1500000, 40, 40)
+
+            buyer.sendall(self.cancel(7))
+            buyer.sendall(self.new_order(10, "1", 5, 150.0, symbol="MSFT"))
+            not_found, unknown = self.receive(buyer, 2)
+            assert not_found[1:] == (b"J", 1, b"C", 4, 7)
+            assert unknown[1:] == (b"J", 1, b"N", 1, 10)
+
+            seller.sendall(self.cancel(7))
+            canceled, = self.receive(seller, 1)
+            assert canceled[3] == b"C" and canceled[8:] == (100, 40)
+            assert gateway.stats().orders == 2
+
+    def test_client_order_ids_per_session(self, gateway):
+        """Test sessions reuse client ids independently and a partly crossing replace keeps resting."""
+        seller, buyer = self.connect(gateway, "SELLER"), self.connect(gateway, "BUYER")
+        with seller, buyer:
+            self.receive(seller, 1)
+            self.receive(buyer, 1)
+            seller.sendall(self.new_order(5, "2", 30, 150.0))
+            self.receive(seller, 1)
+            buyer.sendall(self.new_order(5, "1", 100, 149.0))
+            self.receive(buyer, 1)
+
+            buyer.sendall(self.replace(5, 100, 150.0))
+            replaced, fill = self.receive(buyer, 2)
+            assert replaced[3] == b"R" and replaced[8:] == (100, 0)
+            assert fill[1] == b"F" and fill[4] == 70 and fill[8:] == (1500000, 30, 30)
+            resting_fill, = self.receive(seller, 1)
+            assert resting_fill[4] == 0 and resting_fill[5] == 5
+
+            buyer.sendall(self.cancel(5))
+            canceled, = self.receive(buyer, 1)
+            assert canceled[3] == b"C" and canceled[8:] == (100, 30)
+
+    def test_malformed_message_closes_session(self, gateway):
+        """Test a length that does not match the message type ends the session."""
+        with self.connect(gateway, "CLIENT1") as sock:
+            self.receive(sock, 1)
+            sock.sendall(self.HEADER.pack(99, b"N", 1))
+            assert sock.recv(1) == b""
+
+
+@pytest.mark.skipif(not CPP_AVAILABLE, reason="C++ engine not compiled")
+class TestShardedEngine:
+    """Test single-writer matching shards."""
+
+    @pytest.fixture
+    def engine(self):
+        engine = crucible_engine.MatchingEngine()
+        config = crucible_engine.BookConfig()
+        config.event_capacity = 1024
+        engine.set_default_config(config)
+        yield engine
+        engine.stop_shards()
+
+    def test_posted_orders_match(self, engine):
+        """Test orders posted to a shard are matched before stop returns."""
+        assert engine.start_shards(2)
+        assert engine.post_order("AAPL", make_order(1, "1", 100, 150.0))
+        assert engine.post_order("MSFT", make_order(2, "1", 10, 380.0))
+        assert engine.post_order("AAPL", make_order(101, "2", 40, 150.0))
+        assert engine.post_cancel("MSFT", 2)
+
+        engine.stop_shards()
+
+        fills = [e for e in engine.drain_events() if e.type == crucible_engine.EventType.Fill]
+        assert [(e.order_id, e.qty) for e in fills] == [(101, 40), (1, 40)]
+        assert engine.get_book("AAPL").get_buy_depth() == {pytest.approx(150.0): 1}
+        assert engine.get_book("MSFT").get_buy_depth() == {}
+
+    def test_post_requires_shards(self, engine):
+        """Test posting is refused outside sharded mode."""
+        assert not engine.sharded()
+        assert not engine.post_order("AAPL", make_order(1, "1", 100, 150.0))
+
+        assert engine.start_shards(1)
+        assert not engine.start_shards(1)
+        assert engine.sharded()
+
+        engine.stop_shards()
+        assert not engine.post_order("AAPL", make_order(2, "1", 100, 150.0))
+
+    def test_books_refuse_other_threads_while_sharded(self, engine):
+        """Test a shard-owned book refuses direct calls but keeps top of book."""
+        book = engine.get_or_create_book("AAPL")
+        assert book.add_order(make_order(1, "1", 100, 150.0))
+        assert engine.start_shards(1)
+
+        assert not book.add_order(make_order(2, "1", 50, 149.0))
+        assert book.get_buy_depth() == {}
+        assert book.find_order(1) is None
+        assert book.get_best_bid() == pytest.approx(150.0)
+
+        engine.stop_shards()
+        assert book.get_buy_depth() == {pytest.approx(150.0): 1}
+
+
+if __name__ == "__main__":
+    pytest.main([__file__, "-v", "--tb=short"])
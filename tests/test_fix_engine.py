@@ -155,6 +155,29 @@ class TestFIXMessageValidation:
     def fix_engine(self):
         return FIXEngine(sender_comp_id="TEST", target_comp_id="EXCH")
     
+    def test_built_message_validates(self, fix_engine):
+        """Test a built message passes structure, body length and checksum checks."""
+        message = fix_engine.create_logon(30)
+        
+        assert fix_engine.validate_checksum(message)
+        assert fix_engine.validate_message_structure(message) == (True, None)
+    
+    def test_validation_reports_errors(self, fix_engine):
+        """Test tampered messages are rejected with the failing check."""
+        message = fix_engine.create_logon(30)
+        body_length = message.split("\x01")[1]
+        
+        tampered = message.replace(body_length, body_length + "0", 1)
+        tampered = tampered[:tampered.rfind("10=")]
+        tampered += f"10={fix_engine._calculate_checksum(tampered)}\x01"
+        assert fix_engine.validate_message_structure(tampered) == (False, "Invalid body length")
+        
+        corrupted = message.replace("108=30", "108=31")
+        assert fix_engine.validate_message_structure(corrupted) == (False, "Invalid checksum")
+        
+        assert fix_engine.validate_message_structure("35=A\x01") == (
+            False, "Message must start with BeginString (Tag 8)")
+    
     def test_required_tags_present(self, fix_engine):
         """Test all required tags are present in messages."""
         order = fix_engine.create_new_order_single(
@@ -0,0 +1,159 @@
+"""
+Unit Tests for the conflating market data publisher
+Demonstrates: asyncio testing with fake WebSocket clients
+Skills: pytest, conflation, throttling
+"""
+
+import asyncio
+import json
+import pytest
+import sys
+import os
+
+# Add src to path
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), '../src')))
+
+from market_data import MarketDataPublisher
+
+
+class FakeClient:
+    """Records what the publisher sends; a blocked client never finishes sending."""
+
+    def __init__(self, blocked=False):
+        self.messages = []
+        self.blocked = blocked
+        self.closed = False
+
+    async def send(self, message):
+        self.messages.append(json.loads(message))
+        if self.blocked:
+            await asyncio.Event().wait()
+
+    async def close(self):
+        self.closed = True
+
+
+def delta(price, qty, seq, side="Buy"):
+    return {'symbol': 'AAPL', 'side': side, 'price': price, 'qty': qty, 'orders': 1, 'seq': seq}
+
+
+class TestMarketDataPublisher:
+    """Test conflation, throttling and slow-client handling."""
+
+    @pytest.fixture
+    def loop(self):
+        loop = asyncio.new_event_loop()
+        yield loop
+        loop.close()
+
+    @pytest.fixture
+    def publisher(self):
+        return MarketDataPublisher(lambda: {'buy_orders': {}, 'sell_orders': {}},
+                                   tick_interval=0.01, default_throttle_ms=10)
+
+    @staticmethod
+    def run_tick(loop, publisher):
+        """Tick inside the loop and let the sends run."""
+        async def tick():
+            publisher.tick()
+            await asyncio.sleep(0)
+            await asyncio.sleep(0)
+        loop.run_until_complete(tick())
+
+    def test_levels_conflate_to_latest_state(self, loop, publisher):
+        """Test several deltas to one level become one entry in one batch."""
+        client = FakeClient()
+        publisher.subscribe(client)
+        publisher.update_levels([delta(150.0, 100, 1), delta(151.0, 50, 2)])
+        publisher.update_levels([delta(150.0, 60, 3)])
+        publisher.publish_event('execution', {'exec_id': 'EXEC000001'})
+
+        self.run_tick(loop, publisher)
+
+        assert len(client.messages) == 1
+        batch = client.messages[0]
+        assert batch['type'] == 'batch'
+        assert [item['type'] for item in batch['data']] == ['execution', 'orderbook_delta']
+        levels = batch['data'][1]['data']['levels']
+        assert [(d['price'], d['qty'], d['seq']) for d in levels] == [(151.0, 50, 2), (150.0, 60, 3)]
+
+        self.run_tick(loop, publisher)
+        assert len(client.messages) == 1  # Nothing new to send
+
+    def test_subscribers_share_serialization(self, loop, publisher, monkeypatch):
+        """Test subscribers on the same tick get one serialized message."""
+        clients = [FakeClient() for _ in range(3)]
+        for client in clients:
+            publisher.subscribe(client)
+        publisher.mark_book_dirty()
+
+        dumps = []
+        real_dumps = json.dumps
+        monkeypatch.setattr("market_data.json.dumps", lambda obj: dumps.append(obj) or real_dumps(obj))
+        self.run_tick(loop, publisher)
+
+        assert len(dumps) == 1
+        assert all(c.messages[0]['data'][0]['type'] == 'orderbook' for c in clients)
+
+    def test_throttle_per_subscriber(self, loop, publisher):
+        """Test a slower subscriber gets every change, merged into fewer batches."""
+        fast, slow = FakeClient(), FakeClient()
+        publisher.subscribe(fast)
+        publisher.subscribe(slow, throttle_ms=30)
+
+        for seq in range(1, 4):
+            publisher.update_levels([delta(150.0, seq * 10, seq)])
+            self.run_tick(loop, publisher)
+
+        assert len(fast.messages) == 3
+        assert len(slow.messages) == 1
+        levels = slow.messages[0]['data'][0]['data']['levels']
+        assert [(d['qty'], d['seq']) for d in levels] == [(30, 3)]
+
+    def test_slow_client_conflated_then_dropped(self, loop, publisher):
+        """Test a client stuck in send is skipped, then disconnected after max_lag."""
+        publisher.max_lag = 0.0
+        stuck, healthy = FakeClient(blocked=True), FakeClient()
+        publisher.subscribe(stuck)
+        publisher.subscribe(healthy)
+
+        publisher.update_levels([delta(150.0, 100, 1)])
+        self.run_tick(loop, publisher)
+        publisher.update_levels([delta(150.0, 90, 2)])
+        self.run_tick(loop, publisher)
+
+        assert len(stuck.messages) == 1
+        assert len(healthy.messages) == 2
+        assert stuck.closed
+        assert publisher.subscriber_count() == 1
+
+    def test_dropped_events_resync_full_depth(self, loop, publisher):
+        """Test lost engine events send every subscriber a level snapshot before newer deltas."""
+        publisher.level_snapshot = lambda: {'AAPL': {'seq': 5, 'bids': [[150.0, 80, 2]], 'asks': []}}
+        client = FakeClient()
+        publisher.subscribe(client)
+        publisher.update_levels([delta(150.0, 80, 6)])
+        publisher.resync_levels(3)
+
+        self.run_tick(loop, publisher)
+
+        items = client.messages[0]['data']
+        assert [item['type'] for item in items] == ['snapshot', 'orderbook_delta']
+        assert items[0]['data'] == {'levels': {'AAPL': {'seq': 5, 'bids': [[150.0, 80, 2]], 'asks': []}},
+                                    'events_dropped': 3}
+        assert publisher.events_dropped == 3
+
+        self.run_tick(loop, publisher)
+        assert len(client.messages) == 1  # One resync per loss
+
+    def test_no_subscribers_records_nothing(self, publisher):
+        """Test changes are not kept while nobody listens."""
+        publisher.update_levels([delta(150.0, 100, 1)])
+        publisher.publish_event('new_order', {})
+
+        assert publisher._levels == {}
+        assert len(publisher._events) == 0
+
+
+if __name__ == "__main__":
+    pytest.main([__file__, "-v", "--tb=short"])
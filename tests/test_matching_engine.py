@@ -95,7 +95,7 @@ class TestOrderBook:
     @pytest.fixture
     def order_book(self):
         """Create a fresh order book for each test."""
-        return OrderBook()
+        return OrderBook(use_cpp_engine=False)
     
     def test_add_buy_order(self, order_book):
         """Test adding a buy order."""